@@ -0,0 +1,319 @@
+#ifndef AGGREGATEAVL_H
+#define AGGREGATEAVL_H
+
+#include <limits>
+#include "avlbst.h"
+
+/*
+  -----------------------------------------------
+  Monoid policies for AggregateAVLTree.
+
+  A policy names the aggregate type and says how to build one:
+      typedef ... aggregate_type;
+      static aggregate_type identity();
+      static aggregate_type combine(const aggregate_type& a, const aggregate_type& b);
+      static aggregate_type lift(const Key& key, const Value& value);
+  combine must be associative and identity its neutral element. It need
+  not be commutative: the left operand always covers the smaller keys.
+  -----------------------------------------------
+*/
+
+/**
+* Sum of the values.
+*/
+template <typename T>
+struct SumMonoid
+{
+    typedef T aggregate_type;
+    static T identity() { return T(); }
+    static T combine(const T& a, const T& b) { return a + b; }
+    template <typename Key>
+    static T lift(const Key&, const T& value) { return value; }
+};
+
+/**
+* Smallest value; the identity is the largest T.
+*/
+template <typename T>
+struct MinMonoid
+{
+    typedef T aggregate_type;
+    static T identity() { return std::numeric_limits<T>::max(); }
+    static T combine(const T& a, const T& b) { return b < a ? b : a; }
+    template <typename Key>
+    static T lift(const Key&, const T& value) { return value; }
+};
+
+/**
+* Largest value; the identity is the lowest T.
+*/
+template <typename T>
+struct MaxMonoid
+{
+    typedef T aggregate_type;
+    static T identity() { return std::numeric_limits<T>::lowest(); }
+    static T combine(const T& a, const T& b) { return a < b ? b : a; }
+    template <typename Key>
+    static T lift(const Key&, const T& value) { return value; }
+};
+
+/**
+* An AVLNode that also stores the aggregate of its subtree.
+*/
+template <typename Key, typename Value, typename Monoid>
+class AggregateAVLNode : public AVLNode<Key, Value>
+{
+public:
+    typedef typename Monoid::aggregate_type Aggregate;
+
+    AggregateAVLNode(const Key& key, const Value& value, AggregateAVLNode* parent);
+
+    const Aggregate& getAggregate() const;
+    void setAggregate(const Aggregate& aggregate);
+
+    virtual AggregateAVLNode* getParent() const override;
+    virtual AggregateAVLNode* getLeft() const override;
+    virtual AggregateAVLNode* getRight() const override;
+
+protected:
+    Aggregate aggregate_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the AggregateAVLNode class.
+  -------------------------------------------------
+*/
+
+/**
+* A new node is a leaf, so its aggregate is just its own item.
+*/
+template<class Key, class Value, class Monoid>
+AggregateAVLNode<Key, Value, Monoid>::AggregateAVLNode(const Key& key, const Value& value, AggregateAVLNode* parent) :
+    AVLNode<Key, Value>(key, value, parent), aggregate_(Monoid::lift(key, value))
+{
+
+}
+
+template<class Key, class Value, class Monoid>
+const typename AggregateAVLNode<Key, Value, Monoid>::Aggregate& AggregateAVLNode<Key, Value, Monoid>::getAggregate() const
+{
+    return aggregate_;
+}
+
+template<class Key, class Value, class Monoid>
+void AggregateAVLNode<Key, Value, Monoid>::setAggregate(const Aggregate& aggregate)
+{
+    aggregate_ = aggregate;
+}
+
+/**
+* Overridden to return AggregateAVLNodes, like AVLNode's getters.
+*/
+template<class Key, class Value, class Monoid>
+AggregateAVLNode<Key, Value, Monoid>* AggregateAVLNode<Key, Value, Monoid>::getParent() const
+{
+    return static_cast<AggregateAVLNode*>(this->parent_);
+}
+
+template<class Key, class Value, class Monoid>
+AggregateAVLNode<Key, Value, Monoid>* AggregateAVLNode<Key, Value, Monoid>::getLeft() const
+{
+    return static_cast<AggregateAVLNode*>(this->left_);
+}
+
+template<class Key, class Value, class Monoid>
+AggregateAVLNode<Key, Value, Monoid>* AggregateAVLNode<Key, Value, Monoid>::getRight() const
+{
+    return static_cast<AggregateAVLNode*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AggregateAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVLTree whose nodes store the Monoid aggregate of their subtree, so
+* that the aggregate over any key range is answered in O(log n) instead of
+* by iterating the range.
+*
+* Inserts, removals and rotations keep the aggregates current. Changing a
+* value (insert() over an existing key, or setValue()) recomputes only the
+* node's ancestors. Writing a value through an iterator would bypass this,
+* so operator[] is read-only here.
+*/
+template <class Key, class Value, class Monoid>
+class AggregateAVLTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename AVLTree<Key, Value>::iterator iterator;
+    typedef typename Monoid::aggregate_type Aggregate;
+
+    void setValue(iterator it, const Value& value);
+    Value const & operator[](const Key& key) const;
+
+    Aggregate aggregate() const;
+    Aggregate aggregate(const Key& lo, const Key& hi) const;
+
+protected:
+    typedef AggregateAVLNode<Key, Value, Monoid> ANode;
+
+    virtual AVLNode<Key,Value>* createNode(const Key& key, const Value& value, AVLNode<Key,Value>* parent) override;
+    virtual void refreshNode(AVLNode<Key,Value>* node) override;
+    virtual void refreshPath(AVLNode<Key,Value>* node) override;
+
+    static Aggregate aggregateOf(const ANode* node);
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the AggregateAVLTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Sets the value of the item at it (which must not be end()) and updates
+* the aggregates of its ancestors.
+*/
+template<class Key, class Value, class Monoid>
+void AggregateAVLTree<Key, Value, Monoid>::setValue(iterator it, const Value& value)
+{
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(it));
+    if(node == NULL) {
+        throw std::out_of_range("Invalid iterator");
+    }
+    node->setValue(value);
+    refreshPath(node);
+}
+
+/**
+* Read-only lookup; throws std::out_of_range if the key is missing.
+*/
+template<class Key, class Value, class Monoid>
+Value const & AggregateAVLTree<Key, Value, Monoid>::operator[](const Key& key) const
+{
+    return BinarySearchTree<Key, Value>::operator[](key);
+}
+
+/**
+* Returns the aggregate of the whole tree (the identity if it is empty).
+*/
+template<class Key, class Value, class Monoid>
+typename AggregateAVLTree<Key, Value, Monoid>::Aggregate AggregateAVLTree<Key, Value, Monoid>::aggregate() const
+{
+    return aggregateOf(static_cast<ANode*>(this->root_));
+}
+
+/**
+* Returns the aggregate of the items with lo <= key <= hi, combined in key
+* order (the identity if there are none). Visits O(log n) nodes.
+*/
+template<class Key, class Value, class Monoid>
+typename AggregateAVLTree<Key, Value, Monoid>::Aggregate AggregateAVLTree<Key, Value, Monoid>::aggregate(const Key& lo, const Key& hi) const
+{
+    //find the topmost node inside the range; both ends hang below it
+    ANode* split = static_cast<ANode*>(this->root_);
+    while(split != NULL) {
+        BST_STAT(nodeVisits, 1);
+        if(split->getKey() < lo) {
+            split = split->getRight();
+        }
+        else if(hi < split->getKey()) {
+            split = split->getLeft();
+        }
+        else {
+            break;
+        }
+    }
+    if(split == NULL) {
+        return Monoid::identity();
+    }
+
+    //left of split: every node >= lo brings itself and its right subtree,
+    //and everything found later is smaller
+    Aggregate left = Monoid::identity();
+    ANode* temp = split->getLeft();
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        if(temp->getKey() < lo) {
+            temp = temp->getRight();
+        }
+        else {
+            left = Monoid::combine(Monoid::combine(Monoid::lift(temp->getKey(), temp->getValue()),
+                aggregateOf(temp->getRight())), left);
+            temp = temp->getLeft();
+        }
+    }
+
+    //mirror image on the right
+    Aggregate right = Monoid::identity();
+    temp = split->getRight();
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        if(hi < temp->getKey()) {
+            temp = temp->getLeft();
+        }
+        else {
+            right = Monoid::combine(right, Monoid::combine(aggregateOf(temp->getLeft()),
+                Monoid::lift(temp->getKey(), temp->getValue())));
+            temp = temp->getRight();
+        }
+    }
+
+    return Monoid::combine(Monoid::combine(left, Monoid::lift(split->getKey(), split->getValue())), right);
+}
+
+//HELPER: createNode
+/*
+    every node of this tree is an AggregateAVLNode
+*/
+template<class Key, class Value, class Monoid>
+AVLNode<Key,Value>* AggregateAVLTree<Key, Value, Monoid>::createNode(const Key& key, const Value& value, AVLNode<Key,Value>* parent)
+{
+    return new ANode(key, value, static_cast<ANode*>(parent));
+}
+
+//HELPER: refreshNode
+/*
+    recomputes node's aggregate from its children's, which must be current
+*/
+template<class Key, class Value, class Monoid>
+void AggregateAVLTree<Key, Value, Monoid>::refreshNode(AVLNode<Key,Value>* node)
+{
+    ANode* n = static_cast<ANode*>(node);
+    n->setAggregate(Monoid::combine(Monoid::combine(aggregateOf(n->getLeft()),
+        Monoid::lift(n->getKey(), n->getValue())), aggregateOf(n->getRight())));
+}
+
+//HELPER: refreshPath
+/*
+    refreshes node and then each of its ancestors up to the root
+*/
+template<class Key, class Value, class Monoid>
+void AggregateAVLTree<Key, Value, Monoid>::refreshPath(AVLNode<Key,Value>* node)
+{
+    while(node != NULL) {
+        refreshNode(node);
+        node = node->getParent();
+    }
+}
+
+//HELPER: aggregateOf
+/*
+    a missing subtree aggregates to the identity
+*/
+template<class Key, class Value, class Monoid>
+typename AggregateAVLTree<Key, Value, Monoid>::Aggregate AggregateAVLTree<Key, Value, Monoid>::aggregateOf(const ANode* node)
+{
+    return node == NULL ? Monoid::identity() : node->getAggregate();
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AggregateAVLTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -6,7 +6,12 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+#include <typeinfo>
 #include "bst.h"
+#include "snapshot.h"
 
 struct KeyError { };
 
@@ -131,10 +136,68 @@ template <class Key, class Value>
 class AVLTree : public BinarySearchTree<Key, Value>
 {
 public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    /**
+    * Owns a node taken out of a tree by extract(), like std::map's node
+    * handles. insert() links the same node into a tree of the same type
+    * without copying or reallocating it; a handle that still holds its
+    * node when destroyed frees it.
+    */
+    class node_type
+    {
+    public:
+        node_type();
+        node_type(node_type&& other);
+        node_type& operator=(node_type&& other);
+        ~node_type();
+
+        bool empty() const;
+        explicit operator bool() const;
+        const Key& key() const;
+        Value& mapped() const;
+
+    protected:
+        friend class AVLTree<Key, Value>;
+        node_type(AVLNode<Key,Value>* node, const std::type_info* owner);
+        node_type(const node_type&) = delete;
+        node_type& operator=(const node_type&) = delete;
+
+        AVLNode<Key,Value>* node_;
+        const std::type_info* owner_;   // dynamic type of the source tree
+    };
+
+    AVLTree();
     virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    iterator insert(iterator hint, const std::pair<const Key, Value> &new_item);
+    iterator insert(node_type&& node);
     virtual void remove(const Key& key);  // TODO
+    using BinarySearchTree<Key, Value>::erase;
+    virtual iterator erase(iterator pos) override;
+    virtual void erase(iterator first, iterator last) override;
+    std::pair<Key, Value> pop_min();
+    std::pair<Key, Value> pop_max();
+
+    node_type extract(const Key& key);
+    node_type extract(iterator pos);
+    void merge(AVLTree<Key, Value>& other);
+    void split(const Key& key, AVLTree<Key, Value>& greater);
+    void join(AVLTree<Key, Value>& other);
+
+    // Snapshot persistence. The serializers default to SnapshotSerializer
+    // (see snapshot.h); pass other types with the same interface for keys
+    // or values that are not trivially copyable.
+    template<typename KeySer = SnapshotSerializer<Key>, typename ValueSer = SnapshotSerializer<Value> >
+    void save(std::ostream& out) const;
+    template<typename KeySer = SnapshotSerializer<Key>, typename ValueSer = SnapshotSerializer<Value> >
+    void load(std::istream& in);
+    template<typename KeySer = SnapshotSerializer<Key>, typename ValueSer = SnapshotSerializer<Value> >
+    void save(const std::string& path) const;
+    template<typename KeySer = SnapshotSerializer<Key>, typename ValueSer = SnapshotSerializer<Value> >
+    void load(const std::string& path);
 protected:
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual Node<Key, Value>* getSmallestNode() const override;
 
     // Add helper functions here
 
@@ -150,9 +213,156 @@ protected:
     //4. removeFix(AVLNode<Key,Value>* node, int diff)
     void removeFix(AVLNode<Key,Value>* node, int diff);
 
+    //for insert/hinted insert/node handles; findSlot is virtual so that
+    //AVLMultiTree can place equal keys side by side instead
+    AVLNode<Key,Value>* internalInsert(const std::pair<const Key, Value> &new_item);
+    virtual AVLNode<Key,Value>* findSlot(const Key& key, AVLNode<Key,Value>*& parent, bool& left, uint64_t& keyPrefix);
+    AVLNode<Key,Value>* attachLeaf(AVLNode<Key,Value>* parent, bool left, const std::pair<const Key, Value> &new_item, uint64_t keyPrefix);
+    void linkLeaf(AVLNode<Key,Value>* parent, bool left, AVLNode<Key,Value>* node);
+
+    //for remove/extract/erase/pop
+    void detachNode(AVLNode<Key,Value>* node);
+    node_type extractNode(AVLNode<Key,Value>* node);
+    std::pair<Key, Value> popNode(AVLNode<Key,Value>* node);
+
+    //for subclasses that keep per-node data summarizing the node's subtree
+    //(see AggregateAVLTree): every node is made by createNode(), and
+    //refreshNode()/refreshPath() recompute that data after the children or
+    //value of a node (or of the nodes on its path to the root) changed
+    virtual AVLNode<Key,Value>* createNode(const Key& key, const Value& value, AVLNode<Key,Value>* parent);
+    virtual void refreshNode(AVLNode<Key,Value>* node);
+    virtual void refreshPath(AVLNode<Key,Value>* node);
+
+    //for erase (split/join on detached subtrees with known heights)
+    static int subtreeHeight(AVLNode<Key,Value>* node);
+    static void childHeights(AVLNode<Key,Value>* node, int height, int& leftHeight, int& rightHeight);
+    AVLNode<Key,Value>* linkNode(AVLNode<Key,Value>* node, AVLNode<Key,Value>* left, int leftHeight, AVLNode<Key,Value>* right, int rightHeight, int& height);
+    AVLNode<Key,Value>* joinTrees(AVLNode<Key,Value>* left, int leftHeight, AVLNode<Key,Value>* mid, AVLNode<Key,Value>* right, int rightHeight, int& height);
+    AVLNode<Key,Value>* joinRight(AVLNode<Key,Value>* left, int leftHeight, AVLNode<Key,Value>* mid, AVLNode<Key,Value>* right, int rightHeight, int& height);
+    AVLNode<Key,Value>* joinLeft(AVLNode<Key,Value>* left, int leftHeight, AVLNode<Key,Value>* mid, AVLNode<Key,Value>* right, int rightHeight, int& height);
+    void splitTree(AVLNode<Key,Value>* node, int height, const Key& key, AVLNode<Key,Value>*& less, int& lessHeight, AVLNode<Key,Value>*& rest, int& restHeight);
+    AVLNode<Key,Value>* splitLast(AVLNode<Key,Value>* node, int height, AVLNode<Key,Value>*& last, int& restHeight);
+    void resetRoot(AVLNode<Key,Value>* root);
+
+    //for save/load
+    template<typename KeySer, typename ValueSer>
+    void saveNode(SnapshotWriter& out, AVLNode<Key,Value>* node) const;
+    template<typename KeySer, typename ValueSer>
+    int loadNode(SnapshotReader& in, AVLNode<Key,Value>* parent, bool isLeft, const Key* low, const Key* high, int depth, AVLNode<Key,Value>*& root);
+
+    // Nodes with the smallest and largest keys, for begin(), pop_min(),
+    // pop_max() and the append fast path. Only meaningful while root_ is
+    // not NULL (clear() leaves them dangling and the next insert into the
+    // empty tree resets them).
+    AVLNode<Key,Value>* leftmost_;
+    AVLNode<Key,Value>* rightmost_;
 
 };
 
+/*
+  -----------------------------------------------
+  Begin implementations for the AVLTree::node_type class.
+  -----------------------------------------------
+*/
+
+/**
+* An empty handle.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::node_type() :
+    node_(NULL), owner_(NULL)
+{
+
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::node_type(AVLNode<Key,Value>* node, const std::type_info* owner) :
+    node_(node), owner_(owner)
+{
+
+}
+
+/**
+* Takes other's node, leaving other empty.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::node_type(node_type&& other) :
+    node_(other.node_), owner_(other.owner_)
+{
+    other.node_ = NULL;
+}
+
+/**
+* Frees the node held (if any) and takes other's, leaving other empty.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type& AVLTree<Key, Value>::node_type::operator=(node_type&& other)
+{
+    if(this != &other) {
+        delete node_;
+        node_ = other.node_;
+        owner_ = other.owner_;
+        other.node_ = NULL;
+    }
+    return *this;
+}
+
+/**
+* Frees the node if it was never inserted anywhere.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::~node_type()
+{
+    delete node_;
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::node_type::empty() const
+{
+    return node_ == NULL;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::operator bool() const
+{
+    return node_ != NULL;
+}
+
+/**
+* The key of the node held; the handle must not be empty.
+*/
+template<class Key, class Value>
+const Key& AVLTree<Key, Value>::node_type::key() const
+{
+    return node_->getKey();
+}
+
+/**
+* The value of the node held, which may be changed before the node is
+* inserted again; the handle must not be empty.
+*/
+template<class Key, class Value>
+Value& AVLTree<Key, Value>::node_type::mapped() const
+{
+    return node_->getValue();
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AVLTree::node_type class.
+  -----------------------------------------------
+*/
+
+/**
+* Default constructor; the base class sets up the empty tree.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree() :
+    leftmost_(NULL), rightmost_(NULL)
+{
+
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
@@ -160,105 +370,413 @@ protected:
 template<class Key, class Value>
 void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
 {
-    // TODO
+    BST_LATENCY_SCOPE(LAT_INSERT);
+    internalInsert(new_item);
+}
 
-    //set temp to root node (have to cast)
-    AVLNode<Key, Value>* temp = static_cast<AVLNode<Key, Value>*>(this->root_);
+/**
+* Inserts new_item using hint as a starting point, like std::map: if the key
+* belongs right before the hint, right after it, or (with the end()
+* iterator) past the current maximum, the node is linked there with O(1)
+* comparisons before rebalancing. Otherwise this is a normal insert.
+* Returns an iterator to the item with that key.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::iterator
+AVLTree<Key, Value>::insert(iterator hint, const std::pair<const Key, Value> &new_item)
+{
+    BST_LATENCY_SCOPE(LAT_INSERT);
+    AVLNode<Key,Value>* h = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(hint));
 
-    //get key & get value
-    Key insertKey = new_item.first;
-    Value insertVal = new_item.second;
+    //end() hint: the append fast path in internalInsert covers it
+    if(h == NULL){
+        return this->makeIterator(internalInsert(new_item));
+    }
 
-    //if root is null (manually insert)
-    if(temp == NULL){
-        AVLNode<Key, Value>* rootNode = new AVLNode<Key,Value>(insertKey, insertVal, NULL);
+    BST_STAT(comparisons, 1);
+    if(new_item.first < h->getKey()){
+        //belongs between the predecessor and the hint?
+        AVLNode<Key,Value>* pred = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::predecessor(h));
+        BST_STAT(comparisons, 1);
+        if(pred == NULL || pred->getKey() < new_item.first){
+            uint64_t keyPrefix = KeyPrefixCursor<Key>::packBetween(new_item.first,
+                pred != NULL ? &pred->getKey() : NULL, &h->getKey());
+            //the hint has no left child or the predecessor has no right one
+            if(h->getLeft() == NULL){
+                return this->makeIterator(attachLeaf(h, true, new_item, keyPrefix));
+            }
+            return this->makeIterator(attachLeaf(pred, false, new_item, keyPrefix));
+        }
+    }
+    else if(BST_STAT(comparisons, 1), h->getKey() < new_item.first){
+        //belongs between the hint and its successor?
+        AVLNode<Key,Value>* succ = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::successor(h));
+        BST_STAT(comparisons, 1);
+        if(succ == NULL || new_item.first < succ->getKey()){
+            uint64_t keyPrefix = KeyPrefixCursor<Key>::packBetween(new_item.first,
+                &h->getKey(), succ != NULL ? &succ->getKey() : NULL);
+            if(h->getRight() == NULL){
+                return this->makeIterator(attachLeaf(h, false, new_item, keyPrefix));
+            }
+            return this->makeIterator(attachLeaf(succ, true, new_item, keyPrefix));
+        }
+    }
+    else{
+        //the hint is the key: overwrite
+        h->setValue(new_item.second);
+        refreshPath(h);
+        return hint;
+    }
 
-        //set balance to 0
-        rootNode->setBalance(0);
+    //bad hint
+    return this->makeIterator(internalInsert(new_item));
+}
 
-        //set root
-        this->root_ = rootNode;
+/**
+* Links the node held by node into the tree unless its key is already
+* there. On success node is left empty and the returned iterator points
+* at the moved item; otherwise node keeps its node and the iterator points
+* at the item already in the tree. An empty handle gives end().
+* The handle must come from a tree of the same type; throws
+* std::invalid_argument otherwise.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::iterator
+AVLTree<Key, Value>::insert(node_type&& node)
+{
+    BST_LATENCY_SCOPE(LAT_INSERT);
+    if(node.empty()){
+        return this->end();
+    }
+    //another tree type may use another node type (AggregateAVLTree)
+    if(*node.owner_ != typeid(*this)){
+        throw std::invalid_argument("Node handle from a different kind of tree");
+    }
+
+    AVLNode<Key,Value>* parent;
+    bool left;
+    uint64_t keyPrefix;
+    AVLNode<Key,Value>* existing = findSlot(node.node_->getKey(), parent, left, keyPrefix);
+    if(existing != NULL){
+        return this->makeIterator(existing);
+    }
+    AVLNode<Key,Value>* moved = node.node_;
+    node.node_ = NULL;
+    linkLeaf(parent, left, moved);
+    this->nodeLinked(moved, keyPrefix);
+    return this->makeIterator(moved);
+}
+
+/**
+* Unlinks the item with the given key and returns its node in a handle
+* (an empty one if the key is missing). Nothing is freed or copied.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type AVLTree<Key, Value>::extract(const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    AVLNode<Key,Value>* node = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+    if(node == NULL){
+        return node_type();
+    }
+    return extractNode(node);
+}
 
+/**
+* Unlinks the item at pos and returns its node in a handle (an empty one
+* for end()). Other iterators stay valid.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type AVLTree<Key, Value>::extract(iterator pos)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    AVLNode<Key,Value>* node = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(pos));
+    if(node == NULL){
+        return node_type();
+    }
+    return extractNode(node);
+}
 
+/**
+* Moves every item of other whose key is not in this tree over, relinking
+* its node; items with keys both trees have stay in other. Nothing is
+* allocated or copied. other must be a tree of the same type; throws
+* std::invalid_argument otherwise.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::merge(AVLTree<Key, Value>& other)
+{
+    if(&other == this){
         return;
     }
+    if(typeid(other) != typeid(*this)){
+        throw std::invalid_argument("Cannot merge a different kind of tree");
+    }
 
-    //while temp is not null --> continue to traverse
-    while(temp != NULL){
-        //check if tempKey = insertKey
-        if(insertKey == temp->getKey()){
-            //overwrite current value
-            temp->setValue(insertVal);
-            return;
+    AVLNode<Key,Value>* node = static_cast<AVLNode<Key, Value>*>(other.getSmallestNode());
+    while(node != NULL){
+        //nodes keep their identity when other rebalances, so the successor
+        //found now is still the next one to look at
+        AVLNode<Key,Value>* next = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::successor(node));
+        AVLNode<Key,Value>* parent;
+        bool left;
+        uint64_t keyPrefix;
+        if(findSlot(node->getKey(), parent, left, keyPrefix) == NULL){
+            node_type moved = other.extractNode(node);
+            moved.node_ = NULL;
+            linkLeaf(parent, left, node);
+            this->nodeLinked(node, keyPrefix);
         }
-        //if insertKey is less than
-        else if (insertKey < temp->getKey()){
-            //if left empty location
-            if(temp->getLeft() == NULL){
-                //insert
-                AVLNode<Key, Value>* Left = new AVLNode<Key,Value>(insertKey, insertVal, temp);
+        node = next;
+    }
+}
 
-                //update left
-                temp->setLeft(Left);
+/**
+* Moves every item with a key not less than key into greater, which must
+* be empty and a tree of the same type (std::invalid_argument otherwise).
+* The tree is cut along the search path for key, so this is O(log n); with
+* a Bloom filter enabled, rebuilding the two filters adds O(n).
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::split(const Key& key, AVLTree<Key, Value>& greater)
+{
+    if(&greater == this || !greater.empty()){
+        throw std::invalid_argument("Split needs an empty tree to move into");
+    }
+    if(typeid(greater) != typeid(*this)){
+        throw std::invalid_argument("Cannot split into a different kind of tree");
+    }
+    AVLNode<Key,Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+    if(root == NULL){
+        return;
+    }
 
-                //set balance to 0
-                Left->setBalance(0);
+    AVLNode<Key,Value>* less;
+    AVLNode<Key,Value>* rest;
+    int lessHeight, restHeight;
+    splitTree(root, subtreeHeight(root), key, less, lessHeight, rest, restHeight);
+    resetRoot(less);
+    greater.resetRoot(rest);
+
+    //cached nodes may have moved over; greater's cache and filter hold
+    //nothing yet
+    this->clearLookupCache();
+    this->rebuildBloomFilter();
+    greater.rebuildBloomFilter();
+}
 
-                //check and set balance of parent (only equal to 0 or 1 --> have a right child)
-                if(temp->getBalance() == 1){
-                    //set to 0 and done!
-                    temp->setBalance(0);
-                }
-                //if balance of parent was 0
-                else{
+/**
+* Moves every item of other into this tree, leaving other empty. All of
+* other's keys must be greater than all of this tree's, or all less, and
+* other must be a tree of the same type (std::invalid_argument otherwise).
+* The two trees are joined around one of their end nodes in O(log n);
+* with a Bloom filter enabled, rebuilding it adds O(n).
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::join(AVLTree<Key, Value>& other)
+{
+    if(&other == this || other.empty()){
+        return;
+    }
+    if(typeid(other) != typeid(*this)){
+        throw std::invalid_argument("Cannot join a different kind of tree");
+    }
 
-                    //update balance of parent to -1 (only left child)
-                    temp->setBalance(-1);
+    AVLNode<Key,Value>* lower = static_cast<AVLNode<Key, Value>*>(this->root_);
+    AVLNode<Key,Value>* upper = static_cast<AVLNode<Key, Value>*>(other.root_);
+    if(lower != NULL){
+        BST_STAT(comparisons, 1);
+        if(other.rightmost_->getKey() < leftmost_->getKey()){
+            std::swap(lower, upper);
+        }
+        else if(BST_STAT(comparisons, 1), !(rightmost_->getKey() < other.leftmost_->getKey())){
+            throw std::invalid_argument("Joined trees overlap");
+        }
+    }
 
-                    //insertfix
-                    insertFix(temp, Left);
-                }
+    AVLNode<Key,Value>* root = upper;
+    if(lower != NULL){
+        AVLNode<Key,Value>* pivot;
+        int lowerHeight, height;
+        lower = splitLast(lower, subtreeHeight(lower), pivot, lowerHeight);
+        root = joinTrees(lower, lowerHeight, pivot, upper, subtreeHeight(upper), height);
+    }
+    resetRoot(root);
+    other.root_ = NULL;
 
-                return;
-            }
-            else{
-                //otherwise traverse to left
-                temp = temp->getLeft();
+    other.clearLookupCache();
+    other.rebuildBloomFilter();
+    this->rebuildBloomFilter();
+}
+
+//HELPER: internalInsert
+/*
+    inserts (or overwrites) new_item and returns the node holding it
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLTree<Key, Value>::internalInsert(const std::pair<const Key, Value> &new_item)
+{
+    AVLNode<Key,Value>* parent;
+    bool left;
+    uint64_t keyPrefix;
+    AVLNode<Key,Value>* temp = findSlot(new_item.first, parent, left, keyPrefix);
+
+    //key already there --> overwrite current value
+    if(temp != NULL){
+        temp->setValue(new_item.second);
+        refreshPath(temp);
+        return temp;
+    }
+    return attachLeaf(parent, left, new_item, keyPrefix);
+}
+
+//HELPER: findSlot
+/*
+    returns the node holding key, or NULL after setting parent and left to
+    the free slot where key belongs (parent NULL for an empty tree) and
+    keyPrefix to the packed prefix for a node there. Keys past the current
+    maximum are placed after a single comparison
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLTree<Key, Value>::findSlot(const Key& key, AVLNode<Key,Value>*& parent, bool& left, uint64_t& keyPrefix)
+{
+    //set temp to root node (have to cast)
+    AVLNode<Key, Value>* temp = static_cast<AVLNode<Key, Value>*>(this->root_);
+    parent = NULL;
+    left = false;
+
+    //if root is null (the new node becomes the root)
+    if(temp == NULL){
+        keyPrefix = KeyPrefixCursor<Key>::packBetween(key, NULL, NULL);
+        return NULL;
+    }
+
+    KeyPrefixCursor<Key> cursor(key);
+
+    //append fast path (monotonic keys)
+    BST_STAT(comparisons, 1);
+    int order = cursor.order(rightmost_);
+    if(order > 0 || (order == 0 && rightmost_->getKey() < key)){
+        parent = rightmost_;
+        keyPrefix = cursor.pack();
+        return NULL;
+    }
+
+    //while temp is not null --> continue to traverse
+    while(true){
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        //packed prefixes decide without touching the key when they differ
+        order = cursor.order(temp);
+        //check if tempKey = insertKey
+        if(order == 0 && key == temp->getKey()){
+            return temp;
+        }
+        //if insertKey is less than
+        else if (order < 0 || (order == 0 && (BST_STAT(comparisons, 1), key < temp->getKey()))){
+            //if left empty location --> slot found
+            if(temp->getLeft() == NULL){
+                parent = temp;
+                left = true;
+                keyPrefix = cursor.pack();
+                return NULL;
             }
-            
+            //otherwise traverse to left
+            temp = temp->getLeft();
         }
         //else if insertKey is greater than
         else{
-            //if right location empty
+            //if right location empty --> slot found
             if(temp->getRight() == NULL){
-                //insert
-                AVLNode<Key, Value>* Right = new AVLNode<Key,Value>(insertKey, insertVal, temp);
+                parent = temp;
+                keyPrefix = cursor.pack();
+                return NULL;
+            }
+            //otherwise traverse to right
+            temp = temp->getRight();
+        }
+    }
+}
 
-                //update right
-                temp->setRight(Right);
+//HELPER: attachLeaf
+/*
+    makes a new node for new_item and links it as the left (or right)
+    child of parent, which must have that slot free (or as the root if
+    parent is NULL). keyPrefix is the new node's inline key prefix (see
+    KeyPrefixCursor). Returns the new node
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLTree<Key, Value>::attachLeaf(AVLNode<Key,Value>* parent, bool left, const std::pair<const Key, Value> &new_item, uint64_t keyPrefix)
+{
+    AVLNode<Key, Value>* node = createNode(new_item.first, new_item.second, parent);
+    linkLeaf(parent, left, node);
+    this->nodeAdded(node, keyPrefix);
+    return node;
+}
 
-                //set balance to 0
-                Right->setBalance(0);
+//HELPER: linkLeaf
+/*
+    links node, which must have no children, into the free slot given by
+    parent and left and rebalances
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::linkLeaf(AVLNode<Key,Value>* parent, bool left, AVLNode<Key,Value>* node)
+{
+    //set balance to 0
+    node->setBalance(0);
+    node->setParent(parent);
+
+    //empty tree --> node is the root
+    if(parent == NULL){
+        this->root_ = node;
+        leftmost_ = node;
+        rightmost_ = node;
+        refreshPath(node);
+        return;
+    }
 
-                //check and set balance of parent (only or 0 or -1 --> have a left child)
-                if(temp->getBalance() == -1){
-                    //set to 0 and done
-                    temp->setBalance(0);
-                }
-                //if balance is 0
-                else{
-                    //update balance of parent to 1 (only right child)
-                    temp->setBalance(1);
+    if(left){
+        //update left
+        parent->setLeft(node);
+        refreshPath(node);
+        if(parent == leftmost_){
+            leftmost_ = node;
+        }
 
-                    //insert-fix
-                    insertFix(temp,Right);
-                }
-                return;
-            }
-            //otherwise traverse to right
-            else{
-                temp = temp->getRight();
-            }
+        //check and set balance of parent (only equal to 0 or 1 --> have a right child)
+        if(parent->getBalance() == 1){
+            //set to 0 and done!
+            parent->setBalance(0);
+        }
+        //if balance of parent was 0
+        else{
+            //update balance of parent to -1 (only left child)
+            parent->setBalance(-1);
+
+            //insertfix
+            insertFix(parent, node);
+        }
+    }
+    else{
+        //update right
+        parent->setRight(node);
+        refreshPath(node);
+        if(parent == rightmost_){
+            rightmost_ = node;
+        }
+
+        //check and set balance of parent (only or 0 or -1 --> have a left child)
+        if(parent->getBalance() == -1){
+            //set to 0 and done
+            parent->setBalance(0);
+        }
+        //if balance is 0
+        else{
+            //update balance of parent to 1 (only right child)
+            parent->setBalance(1);
+
+            //insert-fix
+            insertFix(parent, node);
         }
     }
 }
@@ -276,6 +794,7 @@ void AVLTree<Key,Value>::insertFix(AVLNode<Key,Value>* parent, AVLNode<Key,Value
 
     //2. get grandparent
     AVLNode<Key,Value>* grand = parent->getParent();
+    BST_STAT(rebalanceSteps, 1);
 
     //3a if parent is left child of grand
     if(parent == grand->getLeft()){
@@ -296,6 +815,7 @@ void AVLTree<Key,Value>::insertFix(AVLNode<Key,Value>* parent, AVLNode<Key,Value
             if(node == parent->getLeft()){
                 //rotate right around grand
                 rotateRight(grand);
+                BST_STAT(singleRotations, 1);
 
                 //update parent and grandparent balances to be 0
                 parent->setBalance(0);
@@ -310,6 +830,7 @@ void AVLTree<Key,Value>::insertFix(AVLNode<Key,Value>* parent, AVLNode<Key,Value
                 rotateLeft(parent);
                 //rotate right around grand
                 rotateRight(grand);
+                BST_STAT(doubleRotations, 1);
 
                 //Case 3a: balance of node was -1
                 if(node->getBalance() == -1){
@@ -353,6 +874,7 @@ void AVLTree<Key,Value>::insertFix(AVLNode<Key,Value>* parent, AVLNode<Key,Value
             if(node == parent->getRight()){
                 //rotate left around grand
                 rotateLeft(grand);
+                BST_STAT(singleRotations, 1);
 
                 //update parent and grandparent balances to be 0
                 parent->setBalance(0);
@@ -367,6 +889,7 @@ void AVLTree<Key,Value>::insertFix(AVLNode<Key,Value>* parent, AVLNode<Key,Value
                 rotateRight(parent);
                 //rotate left around grand
                 rotateLeft(grand);
+                BST_STAT(doubleRotations, 1);
 
                 //Case 3a: balance of node was 1
                 if(node->getBalance() == 1){
@@ -403,6 +926,7 @@ void AVLTree<Key,Value>::insertFix(AVLNode<Key,Value>* parent, AVLNode<Key,Value
 template<class Key, class Value>
 void AVLTree<Key, Value>::remove(const Key& key)
 {
+    BST_LATENCY_SCOPE(LAT_REMOVE);
     // TODO
      //1. find node (have to cast)
     AVLNode<Key,Value>* temp = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::internalFind(key));
@@ -412,6 +936,107 @@ void AVLTree<Key, Value>::remove(const Key& key)
         return;
     }
 
+    detachNode(temp);
+    this->freeNode(temp);
+}
+
+/**
+* Removes the item at pos (which must not be end()) and returns an
+* iterator to the item after it. The node is unlinked where it is, with
+* no search by key.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::iterator AVLTree<Key, Value>::erase(iterator pos)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    AVLNode<Key,Value>* node = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(pos));
+    if(node == NULL){
+        throw std::out_of_range("Invalid iterator");
+    }
+    //nodes keep their identity through the swap and rotations below
+    AVLNode<Key,Value>* next = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::successor(node));
+    detachNode(node);
+    this->freeNode(node);
+    return this->makeIterator(next);
+}
+
+/**
+* Removes the item with the smallest key and returns it; throws
+* std::out_of_range if the tree is empty. The node is cached, so apart
+* from rebalancing this is O(1) amortized.
+*/
+template<class Key, class Value>
+std::pair<Key, Value> AVLTree<Key, Value>::pop_min()
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    if(this->root_ == NULL){
+        throw std::out_of_range("Empty tree");
+    }
+    return popNode(leftmost_);
+}
+
+/**
+* Removes the item with the largest key and returns it; throws
+* std::out_of_range if the tree is empty. Like pop_min(), O(1) amortized
+* plus rebalancing.
+*/
+template<class Key, class Value>
+std::pair<Key, Value> AVLTree<Key, Value>::pop_max()
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    if(this->root_ == NULL){
+        throw std::out_of_range("Empty tree");
+    }
+    return popNode(rightmost_);
+}
+
+//HELPER: popNode
+/*
+    removes node and returns its item, moving the value out once the
+    node is off the tree and before it is freed
+*/
+template<class Key, class Value>
+std::pair<Key, Value> AVLTree<Key, Value>::popNode(AVLNode<Key,Value>* node)
+{
+    detachNode(node);
+    std::pair<Key, Value> item(node->getKey(), std::move(node->getValue()));
+    this->freeNode(node);
+    return item;
+}
+
+//HELPER: extractNode
+/*
+    unlinks node and hands it over, reset to a lone leaf
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type AVLTree<Key, Value>::extractNode(AVLNode<Key,Value>* node)
+{
+    detachNode(node);
+    this->nodeUnlinked(node);
+    node->setParent(NULL);
+    node->setLeft(NULL);
+    node->setRight(NULL);
+    node->setBalance(0);
+    return node_type(node, &typeid(*this));
+}
+
+//HELPER: detachNode
+/*
+    unlinks temp from the tree and rebalances, leaving the node itself
+    (and its key and value) untouched for the caller to free or reuse
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::detachNode(AVLNode<Key,Value>* temp)
+{
+    //the smallest or largest key is going away (neither ever has two
+    //children, so it is not swapped below)
+    if(temp == leftmost_){
+        leftmost_ = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::successor(temp));
+    }
+    if(temp == rightmost_){
+        rightmost_ = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::predecessor(temp));
+    }
+
     //if two children swap
     if(temp->getLeft() != NULL && temp->getRight() != NULL){
         //A. get predecessor
@@ -441,7 +1066,6 @@ void AVLTree<Key, Value>::remove(const Key& key)
         //if temp is root
         if(temp == this->root_){
             this->root_ = NULL;
-            delete temp;
         }
         else{
             //update parent
@@ -454,10 +1078,8 @@ void AVLTree<Key, Value>::remove(const Key& key)
                 temp->getParent()->setRight(NULL);
             }
 
-            //delete node
-            delete temp;
-
             //patch tree
+            refreshPath(parent);
             removeFix(parent, diff);
         }
     }
@@ -474,7 +1096,6 @@ void AVLTree<Key, Value>::remove(const Key& key)
                 temp->getRight()->setParent(NULL);
                 this->root_ = temp->getRight();
             }
-            delete temp;
         }
         //left child of parent
         else if(temp == temp->getParent()->getLeft()){
@@ -496,9 +1117,9 @@ void AVLTree<Key, Value>::remove(const Key& key)
                 //set LChild's parent to parent
                 RChild->setParent(Parent);
             }
-            delete temp;
 
             //patch tree
+            refreshPath(parent);
             removeFix(parent, diff);
         }
         //right child of parent
@@ -521,15 +1142,72 @@ void AVLTree<Key, Value>::remove(const Key& key)
                 //set LChild's parent to parent
                 RChild->setParent(Parent);
             }
-            delete temp;
 
             //patch tree
+            refreshPath(parent);
             removeFix(parent, diff);
         }
     }
     
     return;
 }
+
+/**
+* Removes the items from first up to, but not including, last (first must
+* not come after last) in O(log n + k) for k removed items. The range is
+* cut out structurally: two splits, one join of what is left, and a single
+* pass freeing the cut-out nodes, with no per-key lookups or fix-ups.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::erase(iterator first, iterator last)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    AVLNode<Key,Value>* lo = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(first));
+    AVLNode<Key,Value>* hi = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(last));
+    if(lo == NULL || lo == hi){
+        return;
+    }
+
+    //cut the tree into [.., lo), [lo, hi) and [hi, ..); lo and hi stay
+    //linked until the end, so their keys can serve as the split points
+    AVLNode<Key,Value>* less;
+    AVLNode<Key,Value>* rest;
+    AVLNode<Key,Value>* middle;
+    AVLNode<Key,Value>* more;
+    int lessHeight, restHeight, middleHeight, moreHeight;
+    AVLNode<Key,Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+    splitTree(root, subtreeHeight(root), lo->getKey(), less, lessHeight, rest, restHeight);
+    if(hi != NULL){
+        splitTree(rest, restHeight, hi->getKey(), middle, middleHeight, more, moreHeight);
+    }
+    else{
+        middle = rest;
+        more = NULL;
+        moreHeight = 0;
+    }
+
+    if(middle != NULL){
+        middle->setParent(NULL);
+        this->trickleDownDelete(middle);
+    }
+
+    //glue the outer pieces back together around the largest remaining key
+    //below the range
+    if(less == NULL){
+        root = more;
+    }
+    else if(more == NULL){
+        root = less;
+    }
+    else{
+        AVLNode<Key,Value>* pivot;
+        int height;
+        less = splitLast(less, lessHeight, pivot, lessHeight);
+        root = joinTrees(less, lessHeight, pivot, more, moreHeight, height);
+    }
+    resetRoot(root);
+}
+
 //HELPER: removeFix
 /*
     patches tree by recursing up ancestor path and fixing any imbalances
@@ -541,6 +1219,7 @@ void AVLTree<Key,Value>::removeFix(AVLNode<Key,Value>* node, int diff){
     if(node == NULL){
         return;
     }
+    BST_STAT(rebalanceSteps, 1);
 
     //2. compute next recursive calls arguments
     AVLNode<Key,Value>* parent = node->getParent();
@@ -569,6 +1248,7 @@ void AVLTree<Key,Value>::removeFix(AVLNode<Key,Value>* node, int diff){
             if(child->getBalance() == -1){
                 //rotate right around node
                 rotateRight(node);
+                BST_STAT(singleRotations, 1);
 
                 //balance of node & child is 0
                 node->setBalance(0);
@@ -581,6 +1261,7 @@ void AVLTree<Key,Value>::removeFix(AVLNode<Key,Value>* node, int diff){
             else if(child->getBalance() == 0){
                 //rotate right around node
                 rotateRight(node);
+                BST_STAT(singleRotations, 1);
 
                 //balance of node is -1 (left-weighted)
                 node->setBalance(-1);
@@ -601,6 +1282,7 @@ void AVLTree<Key,Value>::removeFix(AVLNode<Key,Value>* node, int diff){
 
                 //rotateRight around node
                 rotateRight(node);
+                BST_STAT(doubleRotations, 1);
 
                 //1cA: balance of grandchild was 1
                 if(grandC->getBalance() == 1){
@@ -653,6 +1335,7 @@ void AVLTree<Key,Value>::removeFix(AVLNode<Key,Value>* node, int diff){
             if(child->getBalance() == 1){
                 //rotate left around node
                 rotateLeft(node);
+                BST_STAT(singleRotations, 1);
 
                 //balance of node & child is 0
                 node->setBalance(0);
@@ -665,6 +1348,7 @@ void AVLTree<Key,Value>::removeFix(AVLNode<Key,Value>* node, int diff){
             else if(child->getBalance() == 0){
                 //rotate left around node
                 rotateLeft(node);
+                BST_STAT(singleRotations, 1);
 
                 //balance of node is 1 (right-weighted)
                 node->setBalance(1);
@@ -685,6 +1369,7 @@ void AVLTree<Key,Value>::removeFix(AVLNode<Key,Value>* node, int diff){
 
                 //rotateLeft around node
                 rotateLeft(node);
+                BST_STAT(doubleRotations, 1);
 
                 //1cA: balance of grandchild was -1
                 if(grandC->getBalance() == -1){
@@ -791,6 +1476,10 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key,Value>* node){
         rightChild->setParent(node);
     }
 
+    // node is now the left child's child, so refresh it first
+    refreshNode(node);
+    refreshNode(leftChild);
+
 
     
 //----------------------------------------------
@@ -917,6 +1606,10 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* node){
         leftChild->setParent(node);
     }
 
+    // node is now the right child's child, so refresh it first
+    refreshNode(node);
+    refreshNode(rightChild);
+
 
  //--------------------------------------------------   
     // AVLNode<Key, Value>* parent = node->getParent();
@@ -1007,6 +1700,16 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* node){
     // return;
 }
 
+//HELPER: getSmallestNode
+/*
+    the cached leftmost node, so begin() does not walk the left spine
+*/
+template<class Key, class Value>
+Node<Key, Value>* AVLTree<Key, Value>::getSmallestNode() const
+{
+    return this->root_ == NULL ? NULL : leftmost_;
+}
+
 template<class Key, class Value>
 void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
@@ -1016,5 +1719,486 @@ void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>*
     n2->setBalance(tempB);
 }
 
+//HELPER: subtreeHeight
+/*
+    height of node's subtree (0 for NULL), found by always stepping into
+    the taller child
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::subtreeHeight(AVLNode<Key,Value>* node)
+{
+    int height = 0;
+    while(node != NULL){
+        height++;
+        node = node->getBalance() < 0 ? node->getLeft() : node->getRight();
+    }
+    return height;
+}
+
+//HELPER: childHeights
+/*
+    heights of node's children, given node's own height and its balance
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::childHeights(AVLNode<Key,Value>* node, int height, int& leftHeight, int& rightHeight)
+{
+    leftHeight = height - 1 - (node->getBalance() > 0 ? 1 : 0);
+    rightHeight = height - 1 - (node->getBalance() < 0 ? 1 : 0);
+}
+
+//HELPER: linkNode
+/*
+    makes left and right (whose heights differ by at most one) the
+    children of node, sets its balance and returns it with its height
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLTree<Key, Value>::linkNode(AVLNode<Key,Value>* node, AVLNode<Key,Value>* left, int leftHeight, AVLNode<Key,Value>* right, int rightHeight, int& height)
+{
+    node->setLeft(left);
+    node->setRight(right);
+    if(left != NULL){
+        left->setParent(node);
+    }
+    if(right != NULL){
+        right->setParent(node);
+    }
+    node->setBalance(static_cast<int8_t>(rightHeight - leftHeight));
+    refreshNode(node);
+    height = std::max(leftHeight, rightHeight) + 1;
+    return node;
+}
+
+//HELPER: joinTrees
+/*
+    joins two detached subtrees and a detached node whose key lies between
+    them into one AVL subtree, in O(difference in heights + 1); the new
+    root's parent pointer is left for the caller to set
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLTree<Key, Value>::joinTrees(AVLNode<Key,Value>* left, int leftHeight, AVLNode<Key,Value>* mid, AVLNode<Key,Value>* right, int rightHeight, int& height)
+{
+    if(leftHeight > rightHeight + 1){
+        return joinRight(left, leftHeight, mid, right, rightHeight, height);
+    }
+    if(rightHeight > leftHeight + 1){
+        return joinLeft(left, leftHeight, mid, right, rightHeight, height);
+    }
+    return linkNode(mid, left, leftHeight, right, rightHeight, height);
+}
+
+//HELPER: joinRight
+/*
+    left is the taller tree: walk down its right spine to a subtree about
+    as tall as right, hang mid there and rotate on the way back up
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLTree<Key, Value>::joinRight(AVLNode<Key,Value>* left, int leftHeight, AVLNode<Key,Value>* mid, AVLNode<Key,Value>* right, int rightHeight, int& height)
+{
+    BST_STAT(rebalanceSteps, 1);
+    AVLNode<Key,Value>* outer = left->getLeft();
+    AVLNode<Key,Value>* inner = left->getRight();
+    int outerHeight, innerHeight;
+    childHeights(left, leftHeight, outerHeight, innerHeight);
+
+    if(innerHeight <= rightHeight + 1){
+        //mid takes inner and right
+        if(std::max(innerHeight, rightHeight) + 1 <= outerHeight + 1){
+            int midHeight;
+            linkNode(mid, inner, innerHeight, right, rightHeight, midHeight);
+            return linkNode(left, outer, outerHeight, mid, midHeight, height);
+        }
+        //mid would lean left and left too far right: inner rises above both
+        BST_STAT(doubleRotations, 1);
+        AVLNode<Key,Value>* innerLeft = inner->getLeft();
+        AVLNode<Key,Value>* innerRight = inner->getRight();
+        int innerLeftHeight, innerRightHeight, newLeftHeight, midHeight;
+        childHeights(inner, innerHeight, innerLeftHeight, innerRightHeight);
+        linkNode(left, outer, outerHeight, innerLeft, innerLeftHeight, newLeftHeight);
+        linkNode(mid, innerRight, innerRightHeight, right, rightHeight, midHeight);
+        return linkNode(inner, left, newLeftHeight, mid, midHeight, height);
+    }
+
+    int joinedHeight;
+    AVLNode<Key,Value>* joined = joinRight(inner, innerHeight, mid, right, rightHeight, joinedHeight);
+    if(joinedHeight <= outerHeight + 1){
+        return linkNode(left, outer, outerHeight, joined, joinedHeight, height);
+    }
+    //joined grew too tall: rotate it above left
+    BST_STAT(singleRotations, 1);
+    AVLNode<Key,Value>* joinedLeft = joined->getLeft();
+    AVLNode<Key,Value>* joinedRight = joined->getRight();
+    int joinedLeftHeight, joinedRightHeight, newLeftHeight;
+    childHeights(joined, joinedHeight, joinedLeftHeight, joinedRightHeight);
+    linkNode(left, outer, outerHeight, joinedLeft, joinedLeftHeight, newLeftHeight);
+    return linkNode(joined, left, newLeftHeight, joinedRight, joinedRightHeight, height);
+}
+
+//HELPER: joinLeft
+/*
+    mirror image of joinRight: right is the taller tree
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLTree<Key, Value>::joinLeft(AVLNode<Key,Value>* left, int leftHeight, AVLNode<Key,Value>* mid, AVLNode<Key,Value>* right, int rightHeight, int& height)
+{
+    BST_STAT(rebalanceSteps, 1);
+    AVLNode<Key,Value>* inner = right->getLeft();
+    AVLNode<Key,Value>* outer = right->getRight();
+    int innerHeight, outerHeight;
+    childHeights(right, rightHeight, innerHeight, outerHeight);
+
+    if(innerHeight <= leftHeight + 1){
+        //mid takes left and inner
+        if(std::max(leftHeight, innerHeight) + 1 <= outerHeight + 1){
+            int midHeight;
+            linkNode(mid, left, leftHeight, inner, innerHeight, midHeight);
+            return linkNode(right, mid, midHeight, outer, outerHeight, height);
+        }
+        //mid would lean right and right too far left: inner rises above both
+        BST_STAT(doubleRotations, 1);
+        AVLNode<Key,Value>* innerLeft = inner->getLeft();
+        AVLNode<Key,Value>* innerRight = inner->getRight();
+        int innerLeftHeight, innerRightHeight, newRightHeight, midHeight;
+        childHeights(inner, innerHeight, innerLeftHeight, innerRightHeight);
+        linkNode(mid, left, leftHeight, innerLeft, innerLeftHeight, midHeight);
+        linkNode(right, innerRight, innerRightHeight, outer, outerHeight, newRightHeight);
+        return linkNode(inner, mid, midHeight, right, newRightHeight, height);
+    }
+
+    int joinedHeight;
+    AVLNode<Key,Value>* joined = joinLeft(left, leftHeight, mid, inner, innerHeight, joinedHeight);
+    if(joinedHeight <= outerHeight + 1){
+        return linkNode(right, joined, joinedHeight, outer, outerHeight, height);
+    }
+    //joined grew too tall: rotate it above right
+    BST_STAT(singleRotations, 1);
+    AVLNode<Key,Value>* joinedLeft = joined->getLeft();
+    AVLNode<Key,Value>* joinedRight = joined->getRight();
+    int joinedLeftHeight, joinedRightHeight, newRightHeight;
+    childHeights(joined, joinedHeight, joinedLeftHeight, joinedRightHeight);
+    linkNode(right, joinedRight, joinedRightHeight, outer, outerHeight, newRightHeight);
+    return linkNode(joined, joinedLeft, joinedLeftHeight, right, newRightHeight, height);
+}
+
+//HELPER: splitTree
+/*
+    splits node's subtree (of the given height) into the keys below key
+    (less) and the rest, each a valid AVL subtree; the nodes on the search
+    path become the join points, so the whole split is O(height)
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::splitTree(AVLNode<Key,Value>* node, int height, const Key& key, AVLNode<Key,Value>*& less, int& lessHeight, AVLNode<Key,Value>*& rest, int& restHeight)
+{
+    if(node == NULL){
+        less = NULL;
+        rest = NULL;
+        lessHeight = 0;
+        restHeight = 0;
+        return;
+    }
+    BST_STAT(nodeVisits, 1);
+    AVLNode<Key,Value>* left = node->getLeft();
+    AVLNode<Key,Value>* right = node->getRight();
+    int leftHeight, rightHeight;
+    childHeights(node, height, leftHeight, rightHeight);
+
+    BST_STAT(comparisons, 1);
+    if(node->getKey() < key){
+        AVLNode<Key,Value>* rightLess;
+        int rightLessHeight;
+        splitTree(right, rightHeight, key, rightLess, rightLessHeight, rest, restHeight);
+        less = joinTrees(left, leftHeight, node, rightLess, rightLessHeight, lessHeight);
+    }
+    else{
+        AVLNode<Key,Value>* leftRest;
+        int leftRestHeight;
+        splitTree(left, leftHeight, key, less, lessHeight, leftRest, leftRestHeight);
+        rest = joinTrees(leftRest, leftRestHeight, node, right, rightHeight, restHeight);
+    }
+}
+
+//HELPER: resetRoot
+/*
+    makes root (possibly NULL) the root of this tree and finds the end
+    nodes again, after the tree was rebuilt from detached pieces
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::resetRoot(AVLNode<Key,Value>* root)
+{
+    this->root_ = root;
+    if(root == NULL){
+        return;
+    }
+    root->setParent(NULL);
+    leftmost_ = root;
+    while(leftmost_->getLeft() != NULL){
+        leftmost_ = leftmost_->getLeft();
+    }
+    rightmost_ = root;
+    while(rightmost_->getRight() != NULL){
+        rightmost_ = rightmost_->getRight();
+    }
+}
+
+//HELPER: splitLast
+/*
+    detaches the largest node of node's subtree into last and returns the
+    remaining subtree, rejoined on the way back up
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLTree<Key, Value>::splitLast(AVLNode<Key,Value>* node, int height, AVLNode<Key,Value>*& last, int& restHeight)
+{
+    if(node->getRight() == NULL){
+        last = node;
+        restHeight = height - 1;
+        return node->getLeft();
+    }
+    AVLNode<Key,Value>* left = node->getLeft();
+    int leftHeight, rightHeight, rightRestHeight;
+    childHeights(node, height, leftHeight, rightHeight);
+    AVLNode<Key,Value>* rightRest = splitLast(node->getRight(), rightHeight, last, rightRestHeight);
+    return joinTrees(left, leftHeight, node, rightRest, rightRestHeight, restHeight);
+}
+
+//HELPER: createNode
+/*
+    allocates the node for a new item; the plain tree keeps no subtree data
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLTree<Key, Value>::createNode(const Key& key, const Value& value, AVLNode<Key,Value>* parent)
+{
+    return new AVLNode<Key,Value>(key, value, parent);
+}
+
+//HELPER: refreshNode
+/*
+    no subtree data to recompute in the plain tree
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::refreshNode(AVLNode<Key,Value>*)
+{
+
+}
+
+//HELPER: refreshPath
+/*
+    no subtree data to recompute in the plain tree
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::refreshPath(AVLNode<Key,Value>*)
+{
+
+}
+
+/*
+  -----------------------------------------------
+  Snapshot persistence.
+
+  Layout: an 8 byte magic, the format version, sizeof(Key) and sizeof(Value)
+  as 32-bit words and a byte saying whether the tree is empty. The nodes
+  follow in pre-order, each as one tag byte (bit 0: has left child, bit 1:
+  has right child, bits 2-3: balance + 1) and then its key and value as
+  written by the serializers. Loading relinks the nodes in the order they
+  are read, so the exact tree shape and balances come back in O(n) without
+  any key comparisons or rotations. (Keys with inline prefixes, see
+  KeyPrefixCursor, are packed against the two bounds their ancestors give
+  them, once per node.)
+  -----------------------------------------------
+*/
+
+static const char AVL_SNAPSHOT_MAGIC[8] = { 'A', 'V', 'L', 'S', 'N', 'A', 'P', '\0' };
+static const uint32_t AVL_SNAPSHOT_VERSION = 1;
+//deeper than any AVL tree that fits in memory; bounds loadNode's recursion
+static const int AVL_SNAPSHOT_MAX_HEIGHT = 96;
+
+/**
+* Writes the whole tree to out.
+*/
+template<class Key, class Value>
+template<typename KeySer, typename ValueSer>
+void AVLTree<Key, Value>::save(std::ostream& out) const
+{
+    SnapshotWriter writer(out);
+
+    uint32_t header[3] = { AVL_SNAPSHOT_VERSION, sizeof(Key), sizeof(Value) };
+    uint8_t hasRoot = (this->root_ != NULL) ? 1 : 0;
+    writer.put(AVL_SNAPSHOT_MAGIC, sizeof(AVL_SNAPSHOT_MAGIC));
+    writer.put(header, sizeof(header));
+    writer.put(&hasRoot, sizeof(hasRoot));
+
+    if(hasRoot) {
+        saveNode<KeySer, ValueSer>(writer, static_cast<AVLNode<Key, Value>*>(this->root_));
+    }
+    writer.flush();
+}
+
+/**
+* Replaces the contents of the tree with a snapshot read from in.
+* Throws std::runtime_error if the snapshot is malformed or truncated, in
+* which case the tree is left unchanged. The reader buffers ahead, so the
+* stream should not be used for anything else after the snapshot.
+*/
+template<class Key, class Value>
+template<typename KeySer, typename ValueSer>
+void AVLTree<Key, Value>::load(std::istream& in)
+{
+    SnapshotReader reader(in);
+
+    char magic[sizeof(AVL_SNAPSHOT_MAGIC)];
+    uint32_t header[3];
+    uint8_t hasRoot;
+    reader.get(magic, sizeof(magic));
+    reader.get(header, sizeof(header));
+    reader.get(&hasRoot, sizeof(hasRoot));
+
+    if(std::memcmp(magic, AVL_SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+        throw std::runtime_error("Not an AVL snapshot");
+    }
+    if(header[0] != AVL_SNAPSHOT_VERSION) {
+        throw std::runtime_error("Unsupported AVL snapshot version");
+    }
+    if(header[1] != sizeof(Key) || header[2] != sizeof(Value)) {
+        throw std::runtime_error("AVL snapshot key/value size mismatch");
+    }
+
+    //build into a detached tree so a bad snapshot leaves this one alone
+    AVLNode<Key, Value>* root = NULL;
+    if(hasRoot) {
+        try {
+            loadNode<KeySer, ValueSer>(reader, NULL, false, NULL, NULL, 1, root);
+        }
+        catch(...) {
+            if(root != NULL) {
+                this->trickleDownDelete(root, false);
+            }
+            throw;
+        }
+    }
+
+    this->clear();
+    resetRoot(root);
+    //the loaded nodes bypassed nodeLinked, so the filter only learns of
+    //them now that they are in place
+    this->rebuildBloomFilter();
+}
+
+/**
+* Writes the tree to the file at path through a large stream buffer.
+*/
+template<class Key, class Value>
+template<typename KeySer, typename ValueSer>
+void AVLTree<Key, Value>::save(const std::string& path) const
+{
+    std::vector<char> buf(SNAPSHOT_BUFFER_SIZE);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(&buf[0], buf.size());
+    out.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    save<KeySer, ValueSer>(out);
+    out.close();
+    if(!out) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+/**
+* Loads the tree from the file at path.
+*/
+template<class Key, class Value>
+template<typename KeySer, typename ValueSer>
+void AVLTree<Key, Value>::load(const std::string& path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if(!in) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    load<KeySer, ValueSer>(in);
+}
+
+//HELPER: saveNode
+/*
+    writes node and its subtree in pre-order
+*/
+template<class Key, class Value>
+template<typename KeySer, typename ValueSer>
+void AVLTree<Key, Value>::saveNode(SnapshotWriter& out, AVLNode<Key,Value>* node) const
+{
+    uint8_t tag = static_cast<uint8_t>((node->getBalance() + 1) << 2);
+    if(node->getLeft() != NULL) {
+        tag |= 1;
+    }
+    if(node->getRight() != NULL) {
+        tag |= 2;
+    }
+    out.put(&tag, sizeof(tag));
+    KeySer::write(out, node->getKey());
+    ValueSer::write(out, node->getValue());
+
+    if(node->getLeft() != NULL) {
+        saveNode<KeySer, ValueSer>(out, node->getLeft());
+    }
+    if(node->getRight() != NULL) {
+        saveNode<KeySer, ValueSer>(out, node->getRight());
+    }
+}
+
+//HELPER: loadNode
+/*
+    reads one pre-order subtree and links it as the isLeft child of parent;
+    low and high are the keys of the nearest ancestors on either side
+    (NULL if there is none) and depth is the node's level. Every node is
+    linked as soon as it exists (root is set for the first one) so that a
+    failed load can free whatever was built. The nodes stay out of the
+    lookup cache and Bloom filter until load() swaps them in. Returns the
+    height of the subtree after checking it against the stored balances
+*/
+template<class Key, class Value>
+template<typename KeySer, typename ValueSer>
+int AVLTree<Key, Value>::loadNode(SnapshotReader& in, AVLNode<Key,Value>* parent, bool isLeft, const Key* low, const Key* high, int depth, AVLNode<Key,Value>*& root)
+{
+    if(depth > AVL_SNAPSHOT_MAX_HEIGHT) {
+        throw std::runtime_error("AVL snapshot tree too deep");
+    }
+    uint8_t tag;
+    in.get(&tag, sizeof(tag));
+    if((tag >> 2) > 2 || (tag >> 4) != 0) {
+        throw std::runtime_error("Corrupt AVL snapshot");
+    }
+
+    Key key;
+    Value value;
+    KeySer::read(in, key);
+    ValueSer::read(in, value);
+
+    AVLNode<Key,Value>* node = createNode(key, value, parent);
+    node->setBalance(static_cast<int8_t>((tag >> 2) - 1));
+    if(parent == NULL) {
+        root = node;
+    }
+    else if(isLeft) {
+        parent->setLeft(node);
+    }
+    else {
+        parent->setRight(node);
+    }
+    BST_STAT(allocations, 1);
+    node->setKeyPrefix(KeyPrefixCursor<Key>::packBetween(node->getKey(), low, high));
+
+    int leftHeight = 0;
+    int rightHeight = 0;
+    if(tag & 1) {
+        leftHeight = loadNode<KeySer, ValueSer>(in, node, true, low, &node->getKey(), depth + 1, root);
+    }
+    if(tag & 2) {
+        rightHeight = loadNode<KeySer, ValueSer>(in, node, false, &node->getKey(), high, depth + 1, root);
+    }
+    //the tag only encodes -1..1, so this also rejects |hR - hL| > 1
+    if(node->getBalance() != rightHeight - leftHeight) {
+        throw std::runtime_error("Unbalanced AVL snapshot");
+    }
+    refreshNode(node);
+    return 1 + std::max(leftHeight, rightHeight);
+}
 
 #endif
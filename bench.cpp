@@ -0,0 +1,872 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include "bst.h"
+#include "avlbst.h"
+#include "compactavl.h"
+#include "splay.h"
+#include "rbbst.h"
+#include "scapegoat.h"
+#include "treap.h"
+#include "radixmap.h"
+#include "shardedavl.h"
+
+using namespace std;
+
+// Throughput benchmarks for the search trees, with std::map as the
+// baseline. Every structure runs the same operations (insert, find hit,
+// find miss, iteration, remove, clear) over every workload, size and key
+// type. Results are written as JSON (--json) and as a summary table.
+//
+// Usage: bench [--max-size N] [--json FILE] [--filter TEXT]
+//   --max-size  largest tree size to run, powers of ten from 1e3 (default 1e6)
+//   --json      where to write the JSON results (default bench.json)
+//   --filter    only run cases whose "structure/key/workload" contains TEXT
+//
+// A second set of runs ("mixed" workload) measures a queue-like mix of
+// lookups and writes at several read ratios; see runMixed().
+//
+// A third set ("threads" workload, int keys, largest size only) measures
+// write scaling from 1 to 64 threads: one AVLTree behind a single mutex
+// against a ShardedAVLTree; see runThreads(). Its "threads-seq" variant
+// inserts increasing keys, which all land in the last shard until the
+// sharded table moves its boundaries, so it also reports the rebalances.
+
+// Plain BST runs on sorted/adversarial input degenerate to O(n^2); larger
+// sizes are reported as skipped.
+#define BENCH_DEGENERATE_LIMIT 10000
+
+// Keys per find_many() call in the "avl-many" runs.
+#define BENCH_FIND_BATCH 256
+
+struct BenchResult
+{
+    string structure;
+    string keyType;
+    string workload;
+    string op;
+    size_t n;
+    double seconds;
+    bool skipped;
+};
+
+static vector<BenchResult> results;
+
+struct MixedResult
+{
+    string structure;
+    string keyType;
+    int readPercent;
+    size_t n;
+    double seconds;
+};
+
+static vector<MixedResult> mixedResults;
+
+struct ThreadResult
+{
+    string structure;
+    string workload;
+    int threads;
+    size_t n;
+    double seconds;
+    size_t rebalances;
+};
+
+static vector<ThreadResult> threadResults;
+
+// Thread counts for the threads runs.
+static const int THREAD_COUNTS[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+// Shards in the "sharded" threads runs.
+#define BENCH_SHARDS 64
+
+// Read percentages for the mixed runs.
+static const int MIXED_READ_PERCENTS[] = { 95, 50, 5 };
+static volatile uint64_t sink;
+
+typedef chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/*
+  ---------------------------------------------
+  Keys. Present keys are made from even ids and
+  missing keys from odd ids, so every key type
+  has the same order and the same miss set.
+  ---------------------------------------------
+*/
+
+struct IntKeys
+{
+    typedef int Key;
+    static Key make(uint64_t id) { return static_cast<int>(id); }
+};
+
+struct Uint64Keys
+{
+    typedef uint64_t Key;
+    static Key make(uint64_t id) { return id; }
+};
+
+//uint64 keys spread over the whole range: the id in the top 32 bits (so
+//they sort in id order) and a hash of it below
+struct SparseKeys
+{
+    typedef uint64_t Key;
+    static Key make(uint64_t id)
+    {
+        uint64_t h = id + 0x9E3779B97F4A7C15ULL;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+        h ^= h >> 31;
+        return (id << 32) | (h & 0xFFFFFFFFULL);
+    }
+};
+
+struct StringKeys
+{
+    typedef string Key;
+    static Key make(uint64_t id)
+    {
+        //zero padded so lexicographic order matches numeric order
+        char buf[32];
+        snprintf(buf, sizeof(buf), "key:%016llu", static_cast<unsigned long long>(id));
+        return string(buf);
+    }
+};
+
+// Hosts, sections, users and projects are sorted and none is a prefix of
+// another, so the URL and path keys below sort in id order.
+static const char* const URL_HOSTS[] = {
+    "api.example.com", "cdn.example.net", "docs.example.org", "img.static-cache.io",
+    "news.example.com", "shop.example.co.uk", "www.example.com", "www.example.org"
+};
+static const char* const URL_SECTIONS[] = {
+    "account", "blog", "catalog", "downloads", "help", "products", "search", "video"
+};
+static const char* const PATH_USERS[] = {
+    "alice", "bob", "carol", "dave", "erin", "frank", "grace", "heidi"
+};
+static const char* const PATH_PROJECTS[] = {
+    "compiler", "database", "editor", "kernel", "network", "parser", "renderer", "shell"
+};
+
+//long keys whose first differing byte sits far in: a shared scheme and
+//host, then a section, then the item number (in id order below 2^23)
+struct UrlKeys
+{
+    typedef string Key;
+    static Key make(uint64_t id)
+    {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "https://%s/%s/item/%08llu",
+                 URL_HOSTS[(id >> 20) & 7], URL_SECTIONS[(id >> 17) & 7],
+                 static_cast<unsigned long long>(id));
+        return string(buf);
+    }
+};
+
+struct PathKeys
+{
+    typedef string Key;
+    static Key make(uint64_t id)
+    {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "/home/%s/projects/%s/src/file_%08llu.cpp",
+                 PATH_USERS[(id >> 20) & 7], PATH_PROJECTS[(id >> 17) & 7],
+                 static_cast<unsigned long long>(id));
+        return string(buf);
+    }
+};
+
+/*
+  ---------------------------------------------
+  Workloads: the order keys are inserted in and
+  the order present keys are looked up in.
+  ---------------------------------------------
+*/
+
+struct Workload
+{
+    string name;
+    vector<uint64_t> insertOrder;
+    vector<uint64_t> lookupOrder;
+    // Inserting in this order makes a plain BST degenerate.
+    bool degenerate;
+};
+
+//ranks drawn from a Zipf distribution (s = 0.99) over [0, n)
+static vector<uint64_t> zipfRanks(size_t n, size_t count, mt19937_64& rng)
+{
+    vector<double> cdf(n);
+    double total = 0;
+    for(size_t i = 0; i < n; i++) {
+        total += 1.0 / pow(static_cast<double>(i + 1), 0.99);
+        cdf[i] = total;
+    }
+    uniform_real_distribution<double> uniform(0.0, total);
+    vector<uint64_t> ranks(count);
+    for(size_t i = 0; i < count; i++) {
+        ranks[i] = lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+    }
+    return ranks;
+}
+
+static vector<Workload> makeWorkloads(size_t n)
+{
+    mt19937_64 rng(12345);
+    vector<uint64_t> sorted(n);
+    for(size_t i = 0; i < n; i++) {
+        sorted[i] = 2 * i;
+    }
+    vector<uint64_t> shuffled = sorted;
+    shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    vector<Workload> workloads;
+
+    Workload seq;
+    seq.name = "sequential";
+    seq.insertOrder = sorted;
+    seq.lookupOrder = sorted;
+    seq.degenerate = true;
+    workloads.push_back(seq);
+
+    Workload rnd;
+    rnd.name = "random";
+    rnd.insertOrder = shuffled;
+    rnd.lookupOrder = shuffled;
+    rnd.degenerate = false;
+    workloads.push_back(rnd);
+
+    //random inserts, lookups skewed towards a few hot keys
+    Workload zipf;
+    zipf.name = "zipf";
+    zipf.insertOrder = shuffled;
+    zipf.lookupOrder = zipfRanks(n, n, rng);
+    for(size_t i = 0; i < n; i++) {
+        zipf.lookupOrder[i] = shuffled[zipf.lookupOrder[i]];
+    }
+    zipf.degenerate = false;
+    workloads.push_back(zipf);
+
+    //alternating smallest/largest remaining key: a zig-zag path for a
+    //plain BST and a rotation on almost every AVL insert
+    Workload adv;
+    adv.name = "adversarial";
+    adv.insertOrder.reserve(n);
+    for(size_t lo = 0, hi = n; lo < hi; ) {
+        adv.insertOrder.push_back(sorted[lo++]);
+        if(lo < hi) {
+            adv.insertOrder.push_back(sorted[--hi]);
+        }
+    }
+    adv.lookupOrder = adv.insertOrder;
+    adv.degenerate = true;
+    workloads.push_back(adv);
+
+    return workloads;
+}
+
+/*
+  ---------------------------------------------
+  Adapters giving every structure the same
+  interface.
+  ---------------------------------------------
+*/
+
+template<typename Tree>
+struct TreeOps
+{
+    template<typename Key>
+    static void insert(Tree& t, const Key& k, uint64_t v) { t.insert(make_pair(k, v)); }
+    //non-const so self-adjusting trees (SplayTree) restructure on lookups
+    template<typename Key>
+    static bool find(Tree& t, const Key& k) { return t.find(k) != t.end(); }
+    template<typename Key>
+    static uint64_t findAll(Tree& t, const vector<Key>& keys)
+    {
+        uint64_t found = 0;
+        for(size_t i = 0; i < keys.size(); i++) {
+            found += find(t, keys[i]);
+        }
+        return found;
+    }
+    template<typename Key>
+    static void remove(Tree& t, const Key& k) { t.remove(k); }
+    static void clear(Tree& t) { t.clear(); }
+    static uint64_t iterate(const Tree& t)
+    {
+        uint64_t sum = 0;
+        for(typename Tree::iterator it = t.begin(); it != t.end(); ++it) {
+            sum += it->second;
+        }
+        return sum;
+    }
+};
+
+template<typename Key, typename Value>
+struct TreeOps<map<Key, Value> >
+{
+    typedef map<Key, Value> Tree;
+    static void insert(Tree& t, const Key& k, uint64_t v) { t[k] = v; }
+    static bool find(const Tree& t, const Key& k) { return t.find(k) != t.end(); }
+    static uint64_t findAll(const Tree& t, const vector<Key>& keys)
+    {
+        uint64_t found = 0;
+        for(size_t i = 0; i < keys.size(); i++) {
+            found += find(t, keys[i]);
+        }
+        return found;
+    }
+    static void remove(Tree& t, const Key& k) { t.erase(k); }
+    static void clear(Tree& t) { t.clear(); }
+    static uint64_t iterate(const Tree& t)
+    {
+        uint64_t sum = 0;
+        for(typename Tree::const_iterator it = t.begin(); it != t.end(); ++it) {
+            sum += it->second;
+        }
+        return sum;
+    }
+};
+
+//splay tree that only splays every 8th access
+template<typename Key, typename Value>
+class PeriodicSplayTree : public SplayTree<Key, Value>
+{
+public:
+    PeriodicSplayTree() : SplayTree<Key, Value>(8) {}
+};
+
+//AVL tree whose lookups go through find_many() in batches
+template<typename Key, typename Value>
+class BatchedAVLTree : public AVLTree<Key, Value>
+{
+};
+
+template<typename Key, typename Value>
+struct TreeOps<BatchedAVLTree<Key, Value> > : TreeOps<AVLTree<Key, Value> >
+{
+    typedef BatchedAVLTree<Key, Value> Tree;
+    static uint64_t findAll(const Tree& t, const vector<Key>& keys)
+    {
+        uint64_t found = 0;
+        vector<Key> batch;
+        vector<typename Tree::iterator> out;
+        for(size_t i = 0; i < keys.size(); i += BENCH_FIND_BATCH) {
+            size_t end = min(keys.size(), i + BENCH_FIND_BATCH);
+            batch.assign(keys.begin() + i, keys.begin() + end);
+            t.find_many(batch, out);
+            for(size_t j = 0; j < out.size(); j++) {
+                found += out[j] != t.end();
+            }
+        }
+        return found;
+    }
+};
+
+/*
+  ---------------------------------------------
+  Driver
+  ---------------------------------------------
+*/
+
+static void record(const string& structure, const string& keyType, const string& workload,
+                   const string& op, size_t n, double seconds, bool skipped)
+{
+    BenchResult r;
+    r.structure = structure;
+    r.keyType = keyType;
+    r.workload = workload;
+    r.op = op;
+    r.n = n;
+    r.seconds = seconds;
+    r.skipped = skipped;
+    results.push_back(r);
+}
+
+template<typename Tree, typename Keys>
+void runCase(const string& structure, const string& keyType, const Workload& w)
+{
+    typedef TreeOps<Tree> Ops;
+    typedef typename Keys::Key Key;
+    size_t n = w.insertOrder.size();
+    static const char* ops[] = { "insert", "find_hit", "find_miss", "iterate", "remove", "clear" };
+
+    if(w.degenerate && n > BENCH_DEGENERATE_LIMIT && structure == "bst") {
+        for(size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+            record(structure, keyType, w.name, ops[i], n, 0, true);
+        }
+        return;
+    }
+
+    //convert keys up front so only tree work is timed
+    vector<Key> inserts, lookups, misses;
+    inserts.reserve(n);
+    lookups.reserve(n);
+    misses.reserve(n);
+    for(size_t i = 0; i < n; i++) {
+        inserts.push_back(Keys::make(w.insertOrder[i]));
+        lookups.push_back(Keys::make(w.lookupOrder[i]));
+        misses.push_back(Keys::make(w.lookupOrder[i] + 1));
+    }
+
+    Tree* tree = new Tree;
+    uint64_t found = 0;
+
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; i++) {
+        Ops::insert(*tree, inserts[i], i);
+    }
+    record(structure, keyType, w.name, "insert", n, secondsSince(start), false);
+
+    start = Clock::now();
+    found += Ops::findAll(*tree, lookups);
+    record(structure, keyType, w.name, "find_hit", n, secondsSince(start), false);
+
+    start = Clock::now();
+    found += Ops::findAll(*tree, misses);
+    record(structure, keyType, w.name, "find_miss", n, secondsSince(start), false);
+
+    start = Clock::now();
+    found += Ops::iterate(*tree);
+    record(structure, keyType, w.name, "iterate", n, secondsSince(start), false);
+
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) {
+        Ops::remove(*tree, inserts[i]);
+    }
+    record(structure, keyType, w.name, "remove", n, secondsSince(start), false);
+
+    for(size_t i = 0; i < n; i++) {
+        Ops::insert(*tree, inserts[i], i);
+    }
+    start = Clock::now();
+    Ops::clear(*tree);
+    record(structure, keyType, w.name, "clear", n, secondsSince(start), false);
+
+    delete tree;
+    sink = sink + found;
+}
+
+//queue-like mix over a tree holding n keys: a write removes the oldest key
+//and inserts a new largest one, a read looks up a random live key
+template<typename Tree, typename Keys>
+void runMixed(const string& structure, const string& keyType, size_t n, int readPercent)
+{
+    typedef TreeOps<Tree> Ops;
+    typedef typename Keys::Key Key;
+
+    //draw the op sequence first so every structure gets the same one
+    mt19937_64 rng(777 + readPercent);
+    vector<bool> isRead(n);
+    vector<uint64_t> offsets(n);
+    size_t writes = 0;
+    for(size_t i = 0; i < n; i++) {
+        isRead[i] = static_cast<int>(rng() % 100) < readPercent;
+        offsets[i] = rng() % n;
+        writes += !isRead[i];
+    }
+    vector<Key> keys;
+    keys.reserve(n + writes);
+    for(size_t i = 0; i < n + writes; i++) {
+        keys.push_back(Keys::make(2 * i));
+    }
+
+    Tree* tree = new Tree;
+    for(size_t i = 0; i < n; i++) {
+        Ops::insert(*tree, keys[i], i);
+    }
+
+    uint64_t found = 0;
+    size_t oldest = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; i++) {
+        if(isRead[i]) {
+            found += Ops::find(*tree, keys[oldest + offsets[i]]);
+        }
+        else {
+            Ops::remove(*tree, keys[oldest]);
+            Ops::insert(*tree, keys[oldest + n], i);
+            oldest++;
+        }
+    }
+    MixedResult r;
+    r.structure = structure;
+    r.keyType = keyType;
+    r.readPercent = readPercent;
+    r.n = n;
+    r.seconds = secondsSince(start);
+    mixedResults.push_back(r);
+
+    delete tree;
+    sink = sink + found;
+}
+
+//the threads runs' single-lock baseline, with ShardedAVLTree's interface
+template<typename Key, typename Value>
+class LockedAVLTree
+{
+public:
+    void insert(const pair<const Key, Value>& keyValuePair)
+    {
+        lock_guard<mutex> lock(mutex_);
+        tree_.insert(keyValuePair);
+    }
+
+    bool lookup(const Key& key, Value& value) const
+    {
+        lock_guard<mutex> lock(mutex_);
+        typename AVLTree<Key, Value>::iterator it = tree_.find(key);
+        if(it == tree_.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    size_t rebalances() const
+    {
+        return 0;
+    }
+
+private:
+    mutable mutex mutex_;
+    AVLTree<Key, Value> tree_;
+};
+
+//n ops shared out over the threads on a table prefilled with n / 2 keys
+//uniform over [0, 2n): half insert a key, half look one up. The keys are
+//uniform over [0, 2n) too, or with sequential set, increasing from 2n
+//(each lookup asks for the key inserted just before)
+template<typename Table>
+void runThreads(const string& structure, Table& table, size_t n, int threads, bool sequential)
+{
+    mt19937_64 rng(99);
+    for(size_t i = 0; i < n / 2; i++) {
+        table.insert(make_pair(IntKeys::make(rng() % (2 * n)), static_cast<uint64_t>(i)));
+    }
+    vector<vector<int> > keys(threads);
+    for(size_t i = 0; i < n; i++) {
+        uint64_t id = sequential ? 2 * n + i / 2 : rng() % (2 * n);
+        keys[i % threads].push_back(IntKeys::make(id));
+    }
+
+    vector<uint64_t> found(threads, 0);
+    vector<thread> workers;
+    Clock::time_point start = Clock::now();
+    for(int t = 0; t < threads; t++) {
+        workers.push_back(thread([&table, &keys, &found, t]() {
+            const vector<int>& mine = keys[t];
+            uint64_t value;
+            for(size_t i = 0; i < mine.size(); i++) {
+                if(i % 2 == 0) {
+                    table.insert(make_pair(mine[i], static_cast<uint64_t>(i)));
+                }
+                else {
+                    found[t] += table.lookup(mine[i], value);
+                }
+            }
+        }));
+    }
+    for(size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    ThreadResult r;
+    r.structure = structure;
+    r.workload = sequential ? "threads-seq" : "threads";
+    r.threads = threads;
+    r.n = n;
+    r.seconds = secondsSince(start);
+    r.rebalances = table.rebalances();
+    threadResults.push_back(r);
+
+    for(int t = 0; t < threads; t++) {
+        sink = sink + found[t];
+    }
+}
+
+static string filterText;
+
+static bool selected(const string& structure, const string& keyType, const string& workload)
+{
+    string name = structure + "/" + keyType + "/" + workload;
+    return filterText.empty() || name.find(filterText) != string::npos;
+}
+
+//OrderedRadixMap only takes integer keys
+template<typename Keys, bool Integral = is_integral<typename Keys::Key>::value>
+struct RadixRuns
+{
+    static void run(const string&, const Workload&) {}
+    static void mixed(const string&, size_t, int) {}
+};
+
+template<typename Keys>
+struct RadixRuns<Keys, true>
+{
+    typedef OrderedRadixMap<typename Keys::Key, uint64_t> Tree;
+    static void run(const string& keyType, const Workload& w) { runCase<Tree, Keys>("radix", keyType, w); }
+    static void mixed(const string& keyType, size_t n, int pct) { runMixed<Tree, Keys>("radix", keyType, n, pct); }
+};
+
+template<typename Keys>
+void runKeyType(const string& keyType, const vector<Workload>& workloads)
+{
+    typedef typename Keys::Key Key;
+    for(size_t i = 0; i < workloads.size(); i++) {
+        const Workload& w = workloads[i];
+        if(selected("map", keyType, w.name)) {
+            runCase<map<Key, uint64_t>, Keys>("map", keyType, w);
+        }
+        if(selected("bst", keyType, w.name)) {
+            runCase<BinarySearchTree<Key, uint64_t>, Keys>("bst", keyType, w);
+        }
+        if(selected("avl", keyType, w.name)) {
+            runCase<AVLTree<Key, uint64_t>, Keys>("avl", keyType, w);
+        }
+        if(selected("avl-many", keyType, w.name)) {
+            runCase<BatchedAVLTree<Key, uint64_t>, Keys>("avl-many", keyType, w);
+        }
+        if(selected("cavl", keyType, w.name)) {
+            runCase<CompactAVLTree<Key, uint64_t>, Keys>("cavl", keyType, w);
+        }
+        if(selected("splay", keyType, w.name)) {
+            runCase<SplayTree<Key, uint64_t>, Keys>("splay", keyType, w);
+        }
+        if(selected("splay8", keyType, w.name)) {
+            runCase<PeriodicSplayTree<Key, uint64_t>, Keys>("splay8", keyType, w);
+        }
+        if(selected("rb", keyType, w.name)) {
+            runCase<RBTree<Key, uint64_t>, Keys>("rb", keyType, w);
+        }
+        if(selected("scapegoat", keyType, w.name)) {
+            runCase<ScapegoatTree<Key, uint64_t>, Keys>("scapegoat", keyType, w);
+        }
+        //default seed, so every run builds the same shapes
+        if(selected("treap", keyType, w.name)) {
+            runCase<Treap<Key, uint64_t>, Keys>("treap", keyType, w);
+        }
+        if(selected("radix", keyType, w.name)) {
+            RadixRuns<Keys>::run(keyType, w);
+        }
+    }
+}
+
+template<typename Keys>
+void runMixedKeyType(const string& keyType, size_t n)
+{
+    typedef typename Keys::Key Key;
+    for(size_t i = 0; i < sizeof(MIXED_READ_PERCENTS) / sizeof(MIXED_READ_PERCENTS[0]); i++) {
+        int pct = MIXED_READ_PERCENTS[i];
+        if(selected("map", keyType, "mixed")) {
+            runMixed<map<Key, uint64_t>, Keys>("map", keyType, n, pct);
+        }
+        if(selected("avl", keyType, "mixed")) {
+            runMixed<AVLTree<Key, uint64_t>, Keys>("avl", keyType, n, pct);
+        }
+        if(selected("cavl", keyType, "mixed")) {
+            runMixed<CompactAVLTree<Key, uint64_t>, Keys>("cavl", keyType, n, pct);
+        }
+        if(selected("rb", keyType, "mixed")) {
+            runMixed<RBTree<Key, uint64_t>, Keys>("rb", keyType, n, pct);
+        }
+        if(selected("radix", keyType, "mixed")) {
+            RadixRuns<Keys>::mixed(keyType, n, pct);
+        }
+    }
+}
+
+//the sharded table starts with even split points; it rebalances itself
+static void runThreadCounts(size_t n)
+{
+    vector<int> splitPoints;
+    for(size_t i = 1; i < BENCH_SHARDS; i++) {
+        splitPoints.push_back(IntKeys::make(2 * n * i / BENCH_SHARDS));
+    }
+    for(int sequential = 0; sequential < 2; sequential++) {
+        const char* workload = sequential ? "threads-seq" : "threads";
+        for(size_t i = 0; i < sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]); i++) {
+            if(selected("avl-lock", "int", workload)) {
+                LockedAVLTree<int, uint64_t> table;
+                runThreads("avl-lock", table, n, THREAD_COUNTS[i], sequential != 0);
+            }
+            if(selected("sharded", "int", workload)) {
+                ShardedAVLTree<int, uint64_t> table(splitPoints);
+                runThreads("sharded", table, n, THREAD_COUNTS[i], sequential != 0);
+            }
+        }
+    }
+}
+
+/*
+  ---------------------------------------------
+  Output
+  ---------------------------------------------
+*/
+
+static void writeJson(ostream& out)
+{
+    out << "[\n";
+    for(size_t i = 0; i < mixedResults.size(); i++) {
+        const MixedResult& r = mixedResults[i];
+        out << "  {\"structure\": \"" << r.structure << "\", \"key\": \"" << r.keyType
+            << "\", \"workload\": \"mixed\", \"op\": \"mixed\", \"read_percent\": " << r.readPercent
+            << ", \"n\": " << r.n
+            << ", \"seconds\": " << setprecision(9) << r.seconds
+            << ", \"ops_per_sec\": " << setprecision(6) << (r.n / r.seconds)
+            << ", \"ns_per_op\": " << setprecision(6) << (r.seconds * 1e9 / r.n) << "}"
+            << (i + 1 < mixedResults.size() || !threadResults.empty() || !results.empty() ? ",\n" : "\n");
+    }
+    for(size_t i = 0; i < threadResults.size(); i++) {
+        const ThreadResult& r = threadResults[i];
+        out << "  {\"structure\": \"" << r.structure << "\", \"key\": \"int\""
+            << ", \"workload\": \"" << r.workload << "\", \"op\": \"mixed\", \"threads\": " << r.threads
+            << ", \"n\": " << r.n << ", \"rebalances\": " << r.rebalances
+            << ", \"seconds\": " << setprecision(9) << r.seconds
+            << ", \"ops_per_sec\": " << setprecision(6) << (r.n / r.seconds)
+            << ", \"ns_per_op\": " << setprecision(6) << (r.seconds * 1e9 / r.n) << "}"
+            << (i + 1 < threadResults.size() || !results.empty() ? ",\n" : "\n");
+    }
+    for(size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << "  {\"structure\": \"" << r.structure << "\", \"key\": \"" << r.keyType
+            << "\", \"workload\": \"" << r.workload << "\", \"op\": \"" << r.op
+            << "\", \"n\": " << r.n;
+        if(r.skipped) {
+            out << ", \"skipped\": true}";
+        }
+        else {
+            out << ", \"seconds\": " << setprecision(9) << r.seconds
+                << ", \"ops_per_sec\": " << setprecision(6) << (r.n / r.seconds)
+                << ", \"ns_per_op\": " << setprecision(6) << (r.seconds * 1e9 / r.n) << "}";
+        }
+        out << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+//one row per structure/key/workload/size, Mops/s per operation
+static void printTable(ostream& out)
+{
+    static const char* ops[] = { "insert", "find_hit", "find_miss", "iterate", "remove", "clear" };
+    const size_t numOps = sizeof(ops) / sizeof(ops[0]);
+
+    out << left << setw(10) << "structure" << setw(10) << "key" << setw(13) << "workload"
+        << right << setw(10) << "n";
+    for(size_t i = 0; i < numOps; i++) {
+        out << setw(11) << ops[i];
+    }
+    out << "\n" << "(Mops/s)\n";
+
+    for(size_t i = 0; i < results.size(); i += numOps) {
+        const BenchResult& r = results[i];
+        out << left << setw(10) << r.structure << setw(10) << r.keyType << setw(13) << r.workload
+            << right << setw(10) << r.n;
+        for(size_t j = 0; j < numOps && i + j < results.size(); j++) {
+            const BenchResult& c = results[i + j];
+            if(c.skipped) {
+                out << setw(11) << "-";
+            }
+            else {
+                out << setw(11) << fixed << setprecision(2) << (c.n / c.seconds / 1e6);
+            }
+        }
+        out << "\n";
+    }
+
+    if(!mixedResults.empty()) {
+        out << "\n" << left << setw(10) << "structure" << setw(10) << "key"
+            << right << setw(10) << "n" << setw(10) << "read%" << setw(11) << "mixed" << "\n"
+            << "(Mops/s)\n";
+        for(size_t i = 0; i < mixedResults.size(); i++) {
+            const MixedResult& r = mixedResults[i];
+            out << left << setw(10) << r.structure << setw(10) << r.keyType
+                << right << setw(10) << r.n << setw(10) << r.readPercent
+                << setw(11) << fixed << setprecision(2) << (r.n / r.seconds / 1e6) << "\n";
+        }
+    }
+
+    if(threadResults.empty()) {
+        return;
+    }
+    out << "\n" << left << setw(10) << "structure" << setw(13) << "workload"
+        << right << setw(10) << "n" << setw(10) << "threads" << setw(11) << "mixed" << setw(12) << "rebalances" << "\n"
+        << "(Mops/s)\n";
+    for(size_t i = 0; i < threadResults.size(); i++) {
+        const ThreadResult& r = threadResults[i];
+        out << left << setw(10) << r.structure << setw(13) << r.workload
+            << right << setw(10) << r.n << setw(10) << r.threads
+            << setw(11) << fixed << setprecision(2) << (r.n / r.seconds / 1e6)
+            << setw(12) << r.rebalances << "\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t maxSize = 1000000;
+    string jsonPath = "bench.json";
+
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--max-size" && i + 1 < argc) {
+            maxSize = static_cast<size_t>(atof(argv[++i]));
+        }
+        else if(arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        }
+        else if(arg == "--filter" && i + 1 < argc) {
+            filterText = argv[++i];
+        }
+        else {
+            cerr << "Usage: " << argv[0] << " [--max-size N] [--json FILE] [--filter TEXT]" << endl;
+            return 1;
+        }
+    }
+
+    for(size_t n = 1000; n <= maxSize; n *= 10) {
+        vector<Workload> workloads = makeWorkloads(n);
+        runKeyType<IntKeys>("int", workloads);
+        runKeyType<Uint64Keys>("uint64", workloads);
+        runKeyType<SparseKeys>("sparse", workloads);
+        runKeyType<StringKeys>("string", workloads);
+        runKeyType<UrlKeys>("url", workloads);
+        runKeyType<PathKeys>("path", workloads);
+        runMixedKeyType<IntKeys>("int", n);
+        runMixedKeyType<Uint64Keys>("uint64", n);
+        runMixedKeyType<SparseKeys>("sparse", n);
+        runMixedKeyType<StringKeys>("string", n);
+        runMixedKeyType<UrlKeys>("url", n);
+        runMixedKeyType<PathKeys>("path", n);
+        if(n * 10 > maxSize) {
+            runThreadCounts(n);
+        }
+    }
+
+    ofstream json(jsonPath.c_str());
+    if(!json) {
+        cerr << "Cannot write " << jsonPath << endl;
+        return 1;
+    }
+    writeJson(json);
+    printTable(cout);
+    return 0;
+}
@@ -0,0 +1,307 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+/**
+* Counters reported by a CountingBloomFilter. The observed false positive
+* rate is the share of absent keys that got past the filter; the
+* estimated rate is predicted from how full the filter currently is.
+*/
+struct BloomFilterStats
+{
+    BloomFilterStats() :
+        targetFalsePositiveRate(0), estimatedFalsePositiveRate(0),
+        observedFalsePositiveRate(0), rejected(0), passed(0), falsePositives(0),
+        hashCount(0), memoryBytes(0)
+    {}
+
+    double targetFalsePositiveRate;
+    double estimatedFalsePositiveRate;
+    double observedFalsePositiveRate;
+    uint64_t rejected;          // lookups answered "absent" by the filter
+    uint64_t passed;            // lookups that had to search the tree
+    uint64_t falsePositives;    // passed lookups whose key was not there
+    int hashCount;
+    size_t memoryBytes;
+};
+
+/**
+* A blocked counting Bloom filter. Each key maps to one 64-byte block
+* (one cache line) and sets k of its 64 8-bit counters, so a lookup costs
+* a single cache miss however many probes it makes. Counters make removal
+* possible; a counter that reaches 255 sticks there, which can only cause
+* extra false positives, never false negatives.
+*
+* Blocks don't fill evenly, so a blocked filter needs more space than a
+* classic one for the same false positive rate; the constructor sizes it
+* with the blocked formula rather than the classic m = -n ln p / (ln 2)^2.
+*
+* Hash is a functor giving a size_t for a Key (std::hash by default).
+*/
+template <typename Key, typename Hash = std::hash<Key> >
+class CountingBloomFilter
+{
+public:
+    CountingBloomFilter(size_t expectedItems, double falsePositiveRate);
+
+    void add(const Key& key);
+    void remove(const Key& key);
+    bool mayContain(const Key& key) const;
+    void clear();
+
+    void recordFalsePositive() const;
+    BloomFilterStats stats() const;
+    void resetStats();
+
+private:
+    static const size_t BLOCK_CELLS = 64;
+
+    uint8_t* block(uint64_t h) const;
+    static uint64_t mix(uint64_t h);
+    static uint64_t nextProbe(uint64_t bits, int i);
+    static double blockedRate(int k, double keysPerBlock);
+
+    std::vector<uint8_t> storage_;
+    uint8_t* cells_;            // storage_ aligned to a cache line
+    size_t numBlocks_;
+    int k_;
+    double targetRate_;
+    size_t items_;
+    mutable uint64_t rejected_;
+    mutable uint64_t passed_;
+    mutable uint64_t falsePositives_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the CountingBloomFilter class.
+  -----------------------------------------------
+*/
+
+/**
+* Sizes the filter for expectedItems keys at the given false positive rate,
+* which must lie in (0, 1): the fewest counters per key, and the best
+* probe count for them, whose blocked false positive rate meets the target.
+*/
+template <typename Key, typename Hash>
+CountingBloomFilter<Key, Hash>::CountingBloomFilter(size_t expectedItems, double falsePositiveRate) :
+    cells_(NULL), numBlocks_(1), k_(1), targetRate_(falsePositiveRate), items_(0),
+    rejected_(0), passed_(0), falsePositives_(0)
+{
+    if(!(falsePositiveRate > 0.0 && falsePositiveRate < 1.0)) {
+        throw std::invalid_argument("Bloom filter false positive rate must be in (0, 1)");
+    }
+    if(expectedItems == 0) {
+        expectedItems = 1;
+    }
+    //start from the classic size and grow by 5% steps
+    const double ln2 = std::log(2.0);
+    double cellsPerItem = -std::log(falsePositiveRate) / (ln2 * ln2);
+    for(;;) {
+        double keysPerBlock = BLOCK_CELLS / cellsPerItem;
+        double best = 1.0;
+        for(int k = 1; k <= 16; k++) {
+            double rate = blockedRate(k, keysPerBlock);
+            if(rate < best) {
+                best = rate;
+                k_ = k;
+            }
+        }
+        if(best <= falsePositiveRate || cellsPerItem > 64 * BLOCK_CELLS) {
+            break;
+        }
+        cellsPerItem *= 1.05;
+    }
+    double cells = std::ceil(cellsPerItem * static_cast<double>(expectedItems));
+    numBlocks_ = static_cast<size_t>(std::ceil(cells / BLOCK_CELLS));
+    if(numBlocks_ == 0) {
+        numBlocks_ = 1;
+    }
+
+    storage_.assign(numBlocks_ * BLOCK_CELLS + BLOCK_CELLS - 1, 0);
+    uintptr_t base = reinterpret_cast<uintptr_t>(&storage_[0]);
+    cells_ = &storage_[0] + ((BLOCK_CELLS - base % BLOCK_CELLS) % BLOCK_CELLS);
+}
+
+template <typename Key, typename Hash>
+void CountingBloomFilter<Key, Hash>::add(const Key& key)
+{
+    uint64_t h = mix(static_cast<uint64_t>(Hash()(key)));
+    uint8_t* cells = block(h);
+    uint64_t bits = mix(h);
+    for(int i = 0; i < k_; i++) {
+        uint8_t& c = cells[bits & (BLOCK_CELLS - 1)];
+        if(c != 255) {
+            c++;
+        }
+        bits = nextProbe(bits, i);
+    }
+    items_++;
+}
+
+/**
+* Removes a key that was added earlier; removing a key that was never
+* added corrupts the filter.
+*/
+template <typename Key, typename Hash>
+void CountingBloomFilter<Key, Hash>::remove(const Key& key)
+{
+    uint64_t h = mix(static_cast<uint64_t>(Hash()(key)));
+    uint8_t* cells = block(h);
+    uint64_t bits = mix(h);
+    for(int i = 0; i < k_; i++) {
+        uint8_t& c = cells[bits & (BLOCK_CELLS - 1)];
+        //saturated counters no longer know their count
+        if(c != 0 && c != 255) {
+            c--;
+        }
+        bits = nextProbe(bits, i);
+    }
+    if(items_ > 0) {
+        items_--;
+    }
+}
+
+/**
+* Returns false if the key is certainly absent, true if it may be present.
+*/
+template <typename Key, typename Hash>
+bool CountingBloomFilter<Key, Hash>::mayContain(const Key& key) const
+{
+    uint64_t h = mix(static_cast<uint64_t>(Hash()(key)));
+    const uint8_t* cells = block(h);
+    uint64_t bits = mix(h);
+    for(int i = 0; i < k_; i++) {
+        if(cells[bits & (BLOCK_CELLS - 1)] == 0) {
+            rejected_++;
+            return false;
+        }
+        bits = nextProbe(bits, i);
+    }
+    passed_++;
+    return true;
+}
+
+/**
+* Forgets every key (the counters in stats() are kept).
+*/
+template <typename Key, typename Hash>
+void CountingBloomFilter<Key, Hash>::clear()
+{
+    for(size_t i = 0; i < numBlocks_ * BLOCK_CELLS; i++) {
+        cells_[i] = 0;
+    }
+    items_ = 0;
+}
+
+/**
+* Tells the filter that a key it let through turned out to be absent.
+*/
+template <typename Key, typename Hash>
+void CountingBloomFilter<Key, Hash>::recordFalsePositive() const
+{
+    falsePositives_++;
+}
+
+template <typename Key, typename Hash>
+BloomFilterStats CountingBloomFilter<Key, Hash>::stats() const
+{
+    BloomFilterStats s;
+    s.targetFalsePositiveRate = targetRate_;
+    s.estimatedFalsePositiveRate = blockedRate(k_, static_cast<double>(items_) / numBlocks_);
+    uint64_t absent = rejected_ + falsePositives_;
+    s.observedFalsePositiveRate = absent == 0 ? 0.0 : static_cast<double>(falsePositives_) / absent;
+    s.rejected = rejected_;
+    s.passed = passed_;
+    s.falsePositives = falsePositives_;
+    s.hashCount = k_;
+    s.memoryBytes = numBlocks_ * BLOCK_CELLS;
+    return s;
+}
+
+template <typename Key, typename Hash>
+void CountingBloomFilter<Key, Hash>::resetStats()
+{
+    rejected_ = 0;
+    passed_ = 0;
+    falsePositives_ = 0;
+}
+
+//HELPER: block
+/*
+    the high 32 bits of h pick the block (multiply-shift instead of modulo);
+    the probes inside it come from a second mix of h
+*/
+template <typename Key, typename Hash>
+uint8_t* CountingBloomFilter<Key, Hash>::block(uint64_t h) const
+{
+    size_t index = static_cast<size_t>(((h >> 32) * static_cast<uint64_t>(numBlocks_)) >> 32);
+    return cells_ + index * BLOCK_CELLS;
+}
+
+//HELPER: nextProbe
+/*
+    every probe takes its own 6 bits of the probe hash, which is remixed
+    once its 60 usable bits are spent; independent positions matter here,
+    since arithmetic probe sequences collide badly within a 64-cell block
+*/
+template <typename Key, typename Hash>
+uint64_t CountingBloomFilter<Key, Hash>::nextProbe(uint64_t bits, int i)
+{
+    if(i % 10 == 9) {
+        return mix(bits);
+    }
+    return bits >> 6;
+}
+
+//HELPER: blockedRate
+/*
+    false positive rate with keysPerBlock keys per block on average: the
+    number of keys in the probed block is Poisson distributed, and with j
+    keys in it each of the k probes hits a set counter with probability
+    1 - (1 - 1/64)^(k j)
+*/
+template <typename Key, typename Hash>
+double CountingBloomFilter<Key, Hash>::blockedRate(int k, double keysPerBlock)
+{
+    double rate = 0;
+    double poisson = std::exp(-keysPerBlock);
+    double miss = 1.0 - 1.0 / BLOCK_CELLS;
+    int maxKeys = static_cast<int>(keysPerBlock + 10 * std::sqrt(keysPerBlock) + 20);
+    for(int j = 0; j <= maxKeys; j++) {
+        if(j > 0) {
+            poisson *= keysPerBlock / j;
+        }
+        rate += poisson * std::pow(1.0 - std::pow(miss, k * j), k);
+    }
+    return rate;
+}
+
+//HELPER: mix
+/*
+    splitmix64 finalizer; std::hash is the identity for integers
+*/
+template <typename Key, typename Hash>
+uint64_t CountingBloomFilter<Key, Hash>::mix(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the CountingBloomFilter class.
+  -----------------------------------------------
+*/
+
+#endif
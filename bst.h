@@ -4,7 +4,182 @@
 #include <iostream>
 #include <exception>
 #include <cstdlib>
+#include <cstdint>
 #include <utility>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include "bloomfilter.h"
+
+/**
+* Operation counters for a search tree. They are only collected when the
+* tree headers are compiled with BST_STATS defined; otherwise the counting
+* statements compile to nothing and stats() always returns zeros.
+*/
+struct TreeStats
+{
+    TreeStats() :
+        comparisons(0), nodeVisits(0), singleRotations(0), doubleRotations(0),
+        rebalanceSteps(0), nodeSwaps(0), allocations(0), frees(0)
+    {}
+
+    uint64_t comparisons;       // key comparisons during descents
+    uint64_t nodeVisits;        // nodes visited during descents
+    uint64_t singleRotations;   // rebalancing cases fixed by one rotation
+    uint64_t doubleRotations;   // rebalancing cases fixed by two rotations
+    uint64_t rebalanceSteps;    // levels walked up by the fix-up routines
+    uint64_t nodeSwaps;
+    uint64_t allocations;
+    uint64_t frees;
+};
+
+/**
+* Hit/miss counters of a tree's lookup cache (see setLookupCacheSize).
+*/
+struct LookupCacheStats
+{
+    LookupCacheStats() :
+        hits(0), misses(0)
+    {}
+
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/**
+* Hash used by the lookup cache and the Bloom filter: std::hash where the
+* key type has one. Key types without std::hash can't enable either.
+*/
+template<typename Key, typename Enable = void>
+struct LookupCacheHash
+{
+    static const bool enabled = false;
+    static size_t hash(const Key&) { return 0; }
+    size_t operator()(const Key& key) const { return hash(key); }
+};
+
+template<typename Key>
+struct LookupCacheHash<Key, decltype(void(std::hash<Key>()(std::declval<const Key&>())))>
+{
+    static const bool enabled = true;
+    static size_t hash(const Key& key) { return std::hash<Key>()(key); }
+    size_t operator()(const Key& key) const { return hash(key); }
+};
+
+/**
+* Key traits hook for inline key prefixes. A key type that enables it
+* provides window(key, offset): the 7 bytes of the key starting at offset,
+* zero padded and packed big-endian into the top 56 bits, so that two keys
+* known to agree on their first offset bytes are ordered by their windows
+* whenever the windows differ. compareFrom() compares two such keys from a
+* given byte on and reports their common prefix length.
+*/
+template<typename Key>
+struct KeyPrefixTraits
+{
+    static const bool enabled = false;
+};
+
+template<>
+struct KeyPrefixTraits<std::string>
+{
+    static const bool enabled = true;
+
+    static uint64_t window(const std::string& key, size_t offset)
+    {
+        if(offset + 8 <= key.size()) {
+            return load(key.data() + offset) & ~static_cast<uint64_t>(0xFF);
+        }
+        unsigned char buf[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        if(offset < key.size()) {
+            size_t n = key.size() - offset;
+            std::memcpy(buf, key.data() + offset, n < 7 ? n : 7);
+        }
+        return load(reinterpret_cast<const char*>(buf));
+    }
+
+    static size_t length(const std::string& key) { return key.size(); }
+
+    static int compareFrom(const std::string& a, const std::string& b, size_t from, size_t& lcp)
+    {
+        size_t len = a.size() < b.size() ? a.size() : b.size();
+        size_t i = from;
+        //a word at a time, then the tail
+        for(; i + 8 <= len; i += 8) {
+            uint64_t x = load(a.data() + i);
+            uint64_t y = load(b.data() + i);
+            if(x != y) {
+                lcp = i + static_cast<size_t>(__builtin_clzll(x ^ y) / 8);
+                return x < y ? -1 : 1;
+            }
+        }
+        const unsigned char* pa = reinterpret_cast<const unsigned char*>(a.data());
+        const unsigned char* pb = reinterpret_cast<const unsigned char*>(b.data());
+        while(i < len && pa[i] == pb[i]) {
+            i++;
+        }
+        lcp = i;
+        if(i < len) {
+            return pa[i] < pb[i] ? -1 : 1;
+        }
+        return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+    }
+
+    //8 bytes as a big-endian integer
+    static uint64_t load(const char* p)
+    {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        return word;
+    }
+};
+
+/**
+* The packed prefix window stored in each node (nothing for key types
+* without KeyPrefixTraits): 7 key bytes in the top 56 bits and, in the low
+* byte, the offset they were taken from.
+*/
+template<typename Key, bool Enabled = KeyPrefixTraits<Key>::enabled>
+class KeyPrefixSlot
+{
+public:
+    uint64_t getKeyPrefix() const { return 0; }
+    void setKeyPrefix(uint64_t) {}
+};
+
+template<typename Key>
+class KeyPrefixSlot<Key, true>
+{
+public:
+    KeyPrefixSlot() : keyPrefix_(0) {}
+    uint64_t getKeyPrefix() const { return keyPrefix_; }
+    void setKeyPrefix(uint64_t prefix) { keyPrefix_ = prefix; }
+
+private:
+    uint64_t keyPrefix_;
+};
+
+// Number of lookups find_many() keeps in flight at once.
+#define FIND_MANY_LANES 16
+
+#ifdef BST_STATS
+#define BST_STAT(field, n) (this->stats_.field += (n))
+#else
+#define BST_STAT(field, n) ((void)0)
+#endif
+
+// Per-operation latency histograms (see latency.h), only with BST_LATENCY.
+#ifdef BST_LATENCY
+#include "latency.h"
+#define BST_LATENCY_SCOPE(op) LatencyTimer latencyTimer(op)
+#else
+#define BST_LATENCY_SCOPE(op) ((void)0)
+#endif
 
 /**
  * A templated class for a Node in a search tree.
@@ -14,7 +189,7 @@
  * and AVL trees.
  */
 template <typename Key, typename Value>
-class Node
+class Node : public KeyPrefixSlot<Key>
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
@@ -186,6 +361,115 @@ void Node<Key, Value>::setValue(const Value& value)
   ---------------------------------------
 */
 
+/**
+* Compares one search key against the nodes of a root-to-leaf descent.
+* Keys in a subtree share a prefix with the subtree's bounds (its nearest
+* ancestors on either side), and the cursor tracks how many leading bytes
+* the search key shares with the current bounds. A node whose window was
+* taken at or before that point is ordered by comparing windows as
+* integers, and the full key is only read on a tie or when the window
+* is unusable, starting from the known common prefix.
+*
+* order() returns -1 or 1 when the search key is smaller or larger and 0
+* when the caller has to compare the keys itself: always for key types
+* without KeyPrefixTraits, only for equal keys otherwise.
+*/
+template<typename Key, bool Enabled = KeyPrefixTraits<Key>::enabled>
+class KeyPrefixCursor
+{
+public:
+    explicit KeyPrefixCursor(const Key&) {}
+    template<typename NodeType>
+    int order(const NodeType*) { return 0; }
+    uint64_t pack() const { return 0; }
+    static uint64_t packBetween(const Key&, const Key*, const Key*) { return 0; }
+};
+
+template<typename Key>
+class KeyPrefixCursor<Key, true>
+{
+public:
+    typedef KeyPrefixTraits<Key> Traits;
+
+    explicit KeyPrefixCursor(const Key& key) : key_(&key), lowLcp_(0), highLcp_(0) {}
+
+    template<typename NodeType>
+    int order(const NodeType* node)
+    {
+        const Key& other = node->getKey();
+        size_t known = lowLcp_ < highLcp_ ? lowLcp_ : highLcp_;
+        uint64_t stored = node->getKeyPrefix();
+        size_t offset = static_cast<size_t>(stored & 0xFF);
+        size_t lcp;
+        int result;
+        if(offset <= known) {
+            uint64_t mine = Traits::window(*key_, offset);
+            uint64_t theirs = stored & ~static_cast<uint64_t>(0xFF);
+            if(mine != theirs) {
+                result = mine < theirs ? -1 : 1;
+                //padding bytes match real NULs, so cap at the shorter key
+                lcp = offset + static_cast<size_t>(__builtin_clzll(mine ^ theirs) / 8);
+                lcp = minLength(lcp, other);
+            }
+            else {
+                result = Traits::compareFrom(*key_, other, minLength(offset + 7, other), lcp);
+            }
+        }
+        else {
+            result = Traits::compareFrom(*key_, other, known, lcp);
+        }
+        //node becomes the upper (lower) bound of the rest of the descent
+        if(result < 0) {
+            highLcp_ = lcp;
+        }
+        else if(result > 0) {
+            lowLcp_ = lcp;
+        }
+        return result;
+    }
+
+    //the window for a new leaf holding the search key, whose bounds are
+    //those of the descent so far
+    uint64_t pack() const
+    {
+        size_t offset = lowLcp_ < highLcp_ ? lowLcp_ : highLcp_;
+        if(offset > 0xFF) {
+            offset = 0xFF;
+        }
+        return Traits::window(*key_, offset) | offset;
+    }
+
+    //the window for a node holding key, given its bounds' keys (NULL for
+    //a missing bound)
+    static uint64_t packBetween(const Key& key, const Key* low, const Key* high)
+    {
+        size_t offset = 0;
+        if(low != NULL && high != NULL) {
+            size_t lowLcp, highLcp;
+            Traits::compareFrom(key, *low, 0, lowLcp);
+            Traits::compareFrom(key, *high, 0, highLcp);
+            offset = lowLcp < highLcp ? lowLcp : highLcp;
+            if(offset > 0xFF) {
+                offset = 0xFF;
+            }
+        }
+        return Traits::window(key, offset) | offset;
+    }
+
+private:
+    size_t minLength(size_t n, const Key& other) const
+    {
+        if(Traits::length(*key_) < n) {
+            n = Traits::length(*key_);
+        }
+        return Traits::length(other) < n ? Traits::length(other) : n;
+    }
+
+    const Key* key_;
+    size_t lowLcp_;
+    size_t highLcp_;
+};
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -201,6 +485,14 @@ public:
     bool isBalanced() const; //TODO
     void print() const;
     bool empty() const;
+    TreeStats stats() const;
+    void resetStats();
+    void setLookupCacheSize(size_t slots);
+    LookupCacheStats lookupCacheStats() const;
+    void resetLookupCacheStats();
+    void enableBloomFilter(size_t expectedItems, double falsePositiveRate);
+    void disableBloomFilter();
+    BloomFilterStats bloomFilterStats() const;
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
@@ -231,13 +523,19 @@ public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    void find_many(const std::vector<Key>& keys, std::vector<iterator>& out) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    virtual iterator erase(iterator pos);
+    virtual void erase(iterator first, iterator last);
+    void erase(const Key& lo, const Key& hi);
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
 protected:
     // Mandatory helper functions
     Node<Key, Value>* internalFind(const Key& k) const; // TODO
-    Node<Key, Value> *getSmallestNode() const;  // TODO
+    virtual Node<Key, Value> *getSmallestNode() const;  // TODO
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
@@ -255,13 +553,48 @@ protected:
     //for iterator
     static Node<Key, Value>* successor(Node<Key, Value>* current);
 
-    //for clear
-    void trickleDownDelete(Node<Key,Value>* next);
+    //for clear (linked is false for nodes that never went through nodeAdded)
+    void trickleDownDelete(Node<Key,Value>* next, bool linked = true);
+
+    //for subclasses that take or return iterators
+    static Node<Key, Value>* iteratorNode(const iterator& it);
+    static iterator makeIterator(Node<Key, Value>* node);
+
+    //every node linked into or freed from the tree passes through these;
+    //nodeLinked/nodeUnlinked alone are for nodes moved between trees
+    void nodeAdded(Node<Key,Value>* node);
+    void nodeAdded(Node<Key,Value>* node, uint64_t keyPrefix);
+    void freeNode(Node<Key,Value>* node);
+    void nodeLinked(Node<Key,Value>* node, uint64_t keyPrefix);
+    void nodeUnlinked(Node<Key,Value>* node);
+
+    //for the lookup cache
+    Node<Key, Value>* cachedFind(const Key& key) const;
+    size_t lookupCacheSlot(const Key& key) const;
+    void invalidateCached(Node<Key,Value>* node);
+    void clearLookupCache();
+
+    //for the Bloom filter
+    Node<Key, Value>* filteredFind(const Key& key) const;
+    void rebuildBloomFilter();
 
 
 protected:
     Node<Key, Value>* root_;
     // You should not need other data members
+
+    // Direct-mapped key -> node cache in front of find()/operator[]; empty
+    // while disabled. Slots holding a freed or moved node are cleared.
+    mutable std::vector<Node<Key, Value>*> lookupCache_;
+    int lookupCacheShift_;
+    mutable LookupCacheStats lookupCacheStats_;
+
+    // Counting Bloom filter over the keys, consulted by find()/operator[]
+    // before anything else; NULL while disabled.
+    CountingBloomFilter<Key, LookupCacheHash<Key> >* bloom_;
+#ifdef BST_STATS
+    mutable TreeStats stats_;
+#endif
 };
 
 /*
@@ -347,6 +680,7 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator&
 BinarySearchTree<Key, Value>::iterator::operator++()
 {
+    BST_LATENCY_SCOPE(LAT_ITERATE);
     // TODO
     //later --> reverse predecessor
     current_ = successor(current_);
@@ -370,7 +704,8 @@ Begin implementations for the BinarySearchTree class.
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+BinarySearchTree<Key, Value>::BinarySearchTree() :
+    lookupCacheShift_(64), bloom_(NULL)
 {
     // TODO
     root_ = NULL;
@@ -381,6 +716,7 @@ BinarySearchTree<Key, Value>::~BinarySearchTree()
 {
     // TODO
     this->clear();
+    delete bloom_;
 }
 
 /**
@@ -392,6 +728,126 @@ bool BinarySearchTree<Key, Value>::empty() const
     return root_ == NULL;
 }
 
+/**
+* Returns a copy of the operation counters (all zero unless BST_STATS is
+* defined).
+*/
+template<class Key, class Value>
+TreeStats BinarySearchTree<Key, Value>::stats() const
+{
+#ifdef BST_STATS
+    return stats_;
+#else
+    return TreeStats();
+#endif
+}
+
+/**
+* Zeroes the operation counters.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::resetStats()
+{
+#ifdef BST_STATS
+    stats_ = TreeStats();
+#endif
+}
+
+/**
+* Sizes the lookup cache consulted by find() and operator[] before they
+* descend from the root; 0 (the default) disables it. The size is rounded
+* up to a power of two. Resizing drops the cached entries but keeps the
+* counters.
+*
+* The cache pays off when the same keys are looked up in bursts. It is
+* written to by const lookups, so a tree with the cache enabled must not
+* be read from several threads at once.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::setLookupCacheSize(size_t slots)
+{
+    if(slots == 0) {
+        std::vector<Node<Key, Value>*>().swap(lookupCache_);
+        lookupCacheShift_ = 64;
+        return;
+    }
+    if(!LookupCacheHash<Key>::enabled) {
+        throw std::invalid_argument("Lookup cache needs std::hash for the key type");
+    }
+    int bits = 0;
+    while((static_cast<size_t>(1) << bits) < slots) {
+        bits++;
+    }
+    lookupCache_.assign(static_cast<size_t>(1) << bits, NULL);
+    lookupCacheShift_ = 64 - bits;
+}
+
+/**
+* Returns the lookup cache's hit and miss counts.
+*/
+template<class Key, class Value>
+LookupCacheStats BinarySearchTree<Key, Value>::lookupCacheStats() const
+{
+    return lookupCacheStats_;
+}
+
+/**
+* Zeroes the lookup cache counters.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::resetLookupCacheStats()
+{
+    lookupCacheStats_ = LookupCacheStats();
+}
+
+/**
+* Attaches a counting Bloom filter sized for expectedItems keys at the
+* given false positive rate (replacing any existing one) and fills it with
+* the current keys. find() and operator[] then reject most absent keys
+* after probing a single cache line instead of descending the tree.
+* Going well past expectedItems raises the false positive rate; compare
+* the estimated and target rates in bloomFilterStats() to decide when to
+* resize.
+*
+* Like the lookup cache, the filter's counters are written by const
+* lookups, so the tree must not be read from several threads at once.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::enableBloomFilter(size_t expectedItems, double falsePositiveRate)
+{
+    if(!LookupCacheHash<Key>::enabled) {
+        throw std::invalid_argument("Bloom filter needs std::hash for the key type");
+    }
+    CountingBloomFilter<Key, LookupCacheHash<Key> >* bloom =
+        new CountingBloomFilter<Key, LookupCacheHash<Key> >(expectedItems, falsePositiveRate);
+    delete bloom_;
+    bloom_ = bloom;
+    rebuildBloomFilter();
+}
+
+/**
+* Detaches and frees the Bloom filter.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::disableBloomFilter()
+{
+    delete bloom_;
+    bloom_ = NULL;
+}
+
+/**
+* Returns the Bloom filter's configured, estimated and observed false
+* positive rates and lookup counters (all zero while disabled).
+*/
+template<class Key, class Value>
+BloomFilterStats BinarySearchTree<Key, Value>::bloomFilterStats() const
+{
+    if(bloom_ == NULL) {
+        return BloomFilterStats();
+    }
+    return bloom_->stats();
+}
+
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::print() const
 {
@@ -429,11 +885,160 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::find(const Key & k) const
 {
-    Node<Key, Value> *curr = internalFind(k);
+    BST_LATENCY_SCOPE(LAT_FIND);
+    Node<Key, Value> *curr = filteredFind(k);
     BinarySearchTree<Key, Value>::iterator it(curr);
     return it;
 }
 
+/**
+* Returns an iterator to the first item whose key is not less than key, or
+* the end iterator if there is none.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::lower_bound(const Key& key) const
+{
+    Node<Key, Value>* best = NULL;
+    Node<Key, Value>* temp = root_;
+    KeyPrefixCursor<Key> cursor(key);
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        int order = cursor.order(temp);
+        if(order > 0 || (order == 0 && (BST_STAT(comparisons, 1), temp->getKey() < key))) {
+            temp = temp->getRight();
+        }
+        else {
+            best = temp;
+            temp = temp->getLeft();
+        }
+    }
+    return iterator(best);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key, or
+* the end iterator if there is none.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::upper_bound(const Key& key) const
+{
+    Node<Key, Value>* best = NULL;
+    Node<Key, Value>* temp = root_;
+    KeyPrefixCursor<Key> cursor(key);
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        int order = cursor.order(temp);
+        if(order < 0 || (order == 0 && (BST_STAT(comparisons, 1), key < temp->getKey()))) {
+            best = temp;
+            temp = temp->getLeft();
+        }
+        else {
+            temp = temp->getRight();
+        }
+    }
+    return iterator(best);
+}
+
+/**
+* Looks up every key in keys and sets out[i] to find(keys[i]). The Bloom
+* filter and lookup cache are consulted and updated as find() does.
+*
+* Rather than finishing one descent before starting the next, up to
+* FIND_MANY_LANES descents are in flight at once: each pass moves every one
+* of them down a level and prefetches the child it moves to, so by the time
+* a lookup comes round again its node is usually in cache, and the cache
+* misses of different lookups overlap instead of queueing up. A lookup
+* that finishes hands its lane to the next key.
+*
+* The lookups overlap, so they have no latency of their own: the batch is
+* recorded as one LAT_FIND_MANY sample, apart from the LAT_FIND ones.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::find_many(const std::vector<Key>& keys, std::vector<iterator>& out) const
+{
+    BST_LATENCY_SCOPE(LAT_FIND_MANY);
+    out.assign(keys.size(), end());
+
+    //one in-flight descent
+    struct Lane
+    {
+        Lane(size_t index, Node<Key, Value>* node, const Key& key) :
+            index(index), node(node), cursor(key)
+        {}
+
+        size_t index;
+        Node<Key, Value>* node;
+        KeyPrefixCursor<Key> cursor;
+    };
+    std::vector<Lane> lanes;
+    lanes.reserve(FIND_MANY_LANES);
+    size_t next = 0;
+
+    while(true) {
+        //refill free lanes; filter rejections and cache hits finish at once
+        while(lanes.size() < FIND_MANY_LANES && next < keys.size()) {
+            size_t i = next++;
+            if(root_ == NULL || (bloom_ != NULL && !bloom_->mayContain(keys[i]))) {
+                continue;
+            }
+            if(!lookupCache_.empty()) {
+                Node<Key, Value>* cached = lookupCache_[lookupCacheSlot(keys[i])];
+                if(cached != NULL && cached->getKey() == keys[i]) {
+                    lookupCacheStats_.hits++;
+                    out[i] = iterator(cached);
+                    continue;
+                }
+                lookupCacheStats_.misses++;
+            }
+            __builtin_prefetch(root_);
+            lanes.push_back(Lane(i, root_, keys[i]));
+        }
+        if(lanes.empty()) {
+            break;
+        }
+
+        //move every lane down one level
+        for(size_t j = 0; j < lanes.size(); ) {
+            Lane& lane = lanes[j];
+            const Key& key = keys[lane.index];
+            Node<Key, Value>* temp = lane.node;
+            BST_STAT(nodeVisits, 1);
+            BST_STAT(comparisons, 1);
+            int order = lane.cursor.order(temp);
+            Node<Key, Value>* child = NULL;
+            if(order == 0 && temp->getKey() == key) {
+                out[lane.index] = iterator(temp);
+                if(!lookupCache_.empty()) {
+                    lookupCache_[lookupCacheSlot(key)] = temp;
+                }
+            }
+            else if(order < 0 || (order == 0 && (BST_STAT(comparisons, 1), key < temp->getKey()))) {
+                child = temp->getLeft();
+            }
+            else {
+                child = temp->getRight();
+            }
+
+            if(child != NULL) {
+                __builtin_prefetch(child);
+                lane.node = child;
+                j++;
+                continue;
+            }
+            //done: found, or fell off a leaf
+            if(out[lane.index] == end() && bloom_ != NULL) {
+                bloom_->recordFalsePositive();
+            }
+            lanes[j] = lanes.back();
+            lanes.pop_back();
+        }
+    }
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
@@ -441,14 +1046,16 @@ BinarySearchTree<Key, Value>::find(const Key & k) const
 template<class Key, class Value>
 Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
 {
-    Node<Key, Value> *curr = internalFind(key);
+    BST_LATENCY_SCOPE(LAT_SUBSCRIPT);
+    Node<Key, Value> *curr = filteredFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
     return curr->getValue();
 }
 template<class Key, class Value>
 Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 {
-    Node<Key, Value> *curr = internalFind(key);
+    BST_LATENCY_SCOPE(LAT_SUBSCRIPT);
+    Node<Key, Value> *curr = filteredFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
     return curr->getValue();
 }
@@ -462,6 +1069,7 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 template<class Key, class Value>
 void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
+    BST_LATENCY_SCOPE(LAT_INSERT);
     // TODO
     //set temp to root node
     Node<Key, Value>* temp = root_;
@@ -469,6 +1077,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
     //get key & get value
     Key insertKey = keyValuePair.first;
     Value insertVal = keyValuePair.second;
+    KeyPrefixCursor<Key> cursor(insertKey);
 
     //if root is null (manually insert)
     if(temp == NULL){
@@ -476,19 +1085,24 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 
         //set root
         root_ = rootNode;
+        nodeAdded(rootNode);
         return;
     }
 
     //while temp is not null --> continue to traverse
     while(temp != NULL){
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        //packed prefixes decide without touching the key when they differ
+        int order = cursor.order(temp);
         //check if tempKey = insertKey
-        if(insertKey == temp->getKey()){
+        if(order == 0 && insertKey == temp->getKey()){
             //overwrite current value
             temp->setValue(insertVal);
             return;
         }
         //if insertKey is less than
-        else if (insertKey < temp->getKey()){
+        else if (order < 0 || (order == 0 && (BST_STAT(comparisons, 1), insertKey < temp->getKey()))){
             //if left empty location
             if(temp->getLeft() == NULL){
                 //insert
@@ -496,6 +1110,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 
                 //update left
                 temp->setLeft(Left);
+                nodeAdded(Left, cursor.pack());
 
                 return;
             }
@@ -514,6 +1129,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 
                 //update right
                 temp->setRight(Right);
+                nodeAdded(Right, cursor.pack());
 
                 return;
             }
@@ -534,6 +1150,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::remove(const Key& key)
 {
+    BST_LATENCY_SCOPE(LAT_REMOVE);
     // TODO
 
     //1. find node
@@ -559,7 +1176,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         //if temp is root
         if(temp == root_){
             root_ = NULL;
-            delete temp;
+            freeNode(temp);
             
         }
         else{
@@ -574,7 +1191,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
             }
 
             //delete node
-            delete temp;
+            freeNode(temp);
         }
     }
     //3. if one child --> promote child
@@ -590,7 +1207,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
                 temp->getRight()->setParent(NULL);
                 root_ = temp->getRight();
             }
-            delete temp;
+            freeNode(temp);
         }
         //left child of parent
         else if(temp == temp->getParent()->getLeft()){
@@ -612,7 +1229,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
                 //set LChild's parent to parent
                 RChild->setParent(Parent);
             }
-            delete temp;
+            freeNode(temp);
         }
         //right child of parent
         else{
@@ -634,7 +1251,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
                 //set LChild's parent to parent
                 RChild->setParent(Parent);
             }
-            delete temp;
+            freeNode(temp);
         }
     }
     return;
@@ -668,7 +1285,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     //     temp->getRight()->setParent( temp->getParent() );
     // }
 
-    // delete temp;
+    // freeNode(temp);
     // return;
 }
 
@@ -775,6 +1392,60 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
 }
 
 
+/**
+* Removes the item at pos (which must not be end()) and returns an
+* iterator to the item after it. This goes through remove() and looks the
+* next key up again; AVLTree overrides it to unlink the node directly.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::erase(iterator pos)
+{
+    Node<Key, Value>* node = pos.current_;
+    if(node == NULL) {
+        throw std::out_of_range("Invalid iterator");
+    }
+    //copies: remove() frees the node while it may still read its key
+    Key key = node->getKey();
+    Node<Key, Value>* next = successor(node);
+    if(next == NULL) {
+        remove(key);
+        return end();
+    }
+    Key nextKey = next->getKey();
+    remove(key);
+    return find(nextKey);
+}
+
+/**
+* Removes the items from first up to, but not including, last (first must
+* not come after last). The keys are removed one by one through remove(),
+* so every subclass keeps its invariants; AVLTree overrides this to cut
+* the range out in one piece.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::erase(iterator first, iterator last)
+{
+    std::vector<Key> keys;
+    for(iterator it = first; it != last; ++it) {
+        keys.push_back(it->first);
+    }
+    for(size_t i = 0; i < keys.size(); i++) {
+        remove(keys[i]);
+    }
+}
+
+/**
+* Removes every item with lo <= key < hi.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if(!(lo < hi)) {
+        return;
+    }
+    erase(lower_bound(lo), lower_bound(hi));
+}
+
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
@@ -782,13 +1453,25 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::clear()
 {
+    BST_LATENCY_SCOPE(LAT_CLEAR);
     // TODO
     //check if root is null you are done
     if(root_ == NULL){
         return;
     }
-    //else start deleting
+    //else start deleting, with the cache and filter set aside so freeNode
+    //skips them
+    std::vector<Node<Key, Value>*> cache;
+    cache.swap(lookupCache_);
+    CountingBloomFilter<Key, LookupCacheHash<Key> >* bloom = bloom_;
+    bloom_ = NULL;
     trickleDownDelete(root_);
+    cache.swap(lookupCache_);
+    clearLookupCache();
+    bloom_ = bloom;
+    if(bloom_ != NULL) {
+        bloom_->clear();
+    }
 
     //set root to null to reset
     root_ = NULL;
@@ -812,18 +1495,234 @@ void BinarySearchTree<Key, Value>::clear()
 
 //trickleDownDelete (helper function for clear)
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::trickleDownDelete(Node<Key,Value>* next){
-    //if there is a left node (explore)
-    if(next->getLeft() != NULL){
-        trickleDownDelete(next->getLeft());
+void BinarySearchTree<Key, Value>::trickleDownDelete(Node<Key,Value>* next, bool linked){
+    //post-order walk over the parent pointers rather than recursion, since
+    //unbalanced trees (sorted input, splay trees) can be as deep as they are big
+    Node<Key,Value>* stop = next->getParent();
+    while(next != stop){
+        //if there is a left node (explore), fetching the right one meanwhile
+        if(next->getLeft() != NULL){
+            if(next->getRight() != NULL){
+                __builtin_prefetch(next->getRight());
+            }
+            next = next->getLeft();
+        }
+        //if there is a right node (explore)
+        else if(next->getRight() != NULL){
+            next = next->getRight();
+        }
+        //delete on way back up, unhooking from the parent
+        else{
+            Node<Key,Value>* parent = next->getParent();
+            if(parent != stop){
+                if(parent->getLeft() == next){
+                    parent->setLeft(NULL);
+                }
+                else{
+                    parent->setRight(NULL);
+                }
+            }
+            if(linked){
+                freeNode(next);
+            }
+            else{
+                BST_STAT(frees, 1);
+                delete next;
+            }
+            next = parent;
+        }
+    }
+}
+
+/**
+* Gives subclasses access to the node behind an iterator (NULL for end()).
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::iteratorNode(const iterator& it)
+{
+    return it.current_;
+}
+
+/**
+* Builds an iterator for a node in this tree (NULL gives end()).
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::makeIterator(Node<Key, Value>* node)
+{
+    return iterator(node);
+}
+
+/**
+* Called once a newly allocated node has been linked into the tree as a
+* leaf. Its inline key prefix is packed from its neighbours; inserts that
+* just descended to the leaf pass the cursor's packing instead.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::nodeAdded(Node<Key,Value>* node)
+{
+    uint64_t keyPrefix = 0;
+    if(KeyPrefixTraits<Key>::enabled) {
+        //a new leaf's bounds are its predecessor and successor
+        Node<Key, Value>* low = predecessor(node);
+        Node<Key, Value>* high = successor(node);
+        keyPrefix = KeyPrefixCursor<Key>::packBetween(node->getKey(),
+            low != NULL ? &low->getKey() : NULL, high != NULL ? &high->getKey() : NULL);
     }
-    //if there is a right node (explore)
-    if(next->getRight() != NULL){
-        trickleDownDelete(next->getRight());
+    nodeAdded(node, keyPrefix);
+}
+
+/**
+* Called once a newly allocated node has been linked into the tree, with
+* its inline key prefix (see KeyPrefixCursor).
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::nodeAdded(Node<Key,Value>* node, uint64_t keyPrefix)
+{
+    BST_STAT(allocations, 1);
+    nodeLinked(node, keyPrefix);
+}
+
+/**
+* Frees a node that has already been unlinked from the tree (or, for
+* clear(), whose whole tree is going away).
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::freeNode(Node<Key,Value>* node)
+{
+    BST_STAT(frees, 1);
+    nodeUnlinked(node);
+    delete node;
+}
+
+/**
+* Registers a node that has been linked into the tree, newly allocated or
+* not: adds its key to the Bloom filter and sets its inline key prefix.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::nodeLinked(Node<Key,Value>* node, uint64_t keyPrefix)
+{
+    if(bloom_ != NULL) {
+        bloom_->add(node->getKey());
     }
-    //delete on way back up
-    delete next;
+    node->setKeyPrefix(keyPrefix);
+}
 
+/**
+* Forgets a node that has been unlinked from the tree, whether it is about
+* to be freed or to move elsewhere: drops it from the lookup cache and its
+* key from the Bloom filter.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::nodeUnlinked(Node<Key,Value>* node)
+{
+    if(!lookupCache_.empty()) {
+        invalidateCached(node);
+    }
+    if(bloom_ != NULL) {
+        bloom_->remove(node->getKey());
+    }
+}
+
+//HELPER: filteredFind
+/*
+    cachedFind behind the Bloom filter; keys the filter lets through but
+    the tree doesn't have are counted as false positives
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::filteredFind(const Key& key) const
+{
+    if(bloom_ == NULL) {
+        return cachedFind(key);
+    }
+    if(!bloom_->mayContain(key)) {
+        return NULL;
+    }
+    Node<Key, Value>* node = cachedFind(key);
+    if(node == NULL) {
+        bloom_->recordFalsePositive();
+    }
+    return node;
+}
+
+//HELPER: rebuildBloomFilter
+/*
+    refills the filter from the keys in the tree, for when nodes arrive
+    or leave other than through nodeAdded/freeNode (e.g. moved between
+    trees or loaded in bulk)
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rebuildBloomFilter()
+{
+    if(bloom_ == NULL) {
+        return;
+    }
+    bloom_->clear();
+    for(Node<Key, Value>* temp = getSmallestNode(); temp != NULL; temp = successor(temp)) {
+        bloom_->add(temp->getKey());
+    }
+}
+
+//HELPER: cachedFind
+/*
+    internalFind behind the lookup cache: a slot holding a node with the
+    same key is a hit, anything else descends and caches what it finds
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::cachedFind(const Key& key) const
+{
+    if(lookupCache_.empty()) {
+        return internalFind(key);
+    }
+    size_t slot = lookupCacheSlot(key);
+    Node<Key, Value>* node = lookupCache_[slot];
+    if(node != NULL && node->getKey() == key) {
+        lookupCacheStats_.hits++;
+        return node;
+    }
+    lookupCacheStats_.misses++;
+    node = internalFind(key);
+    if(node != NULL) {
+        lookupCache_[slot] = node;
+    }
+    return node;
+}
+
+//HELPER: lookupCacheSlot
+/*
+    Fibonacci hashing: the top bits of hash * 2^64/phi, so keys whose hashes
+    differ only in their high bits still spread out
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::lookupCacheSlot(const Key& key) const
+{
+    uint64_t h = static_cast<uint64_t>(LookupCacheHash<Key>::hash(key));
+    return static_cast<size_t>((h * 0x9E3779B97F4A7C15ULL) >> lookupCacheShift_);
+}
+
+//HELPER: invalidateCached
+/*
+    drops node from the cache if it occupies its slot
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::invalidateCached(Node<Key,Value>* node)
+{
+    size_t slot = lookupCacheSlot(node->getKey());
+    if(lookupCache_[slot] == node) {
+        lookupCache_[slot] = NULL;
+    }
+}
+
+//HELPER: clearLookupCache
+/*
+    empties every slot, for when nodes leave the tree other than through
+    freeNode (e.g. moved to another tree)
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::clearLookupCache()
+{
+    for(size_t i = 0; i < lookupCache_.size(); i++) {
+        lookupCache_[i] = NULL;
+    }
 }
 
 
@@ -864,15 +1763,20 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
     // TODO
     //set temp node to root
     Node<Key,Value>* temp = this->root_;
+    KeyPrefixCursor<Key> cursor(key);
 
     //while temp node is not null
     while(temp != NULL){
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        //packed prefixes decide without touching the key when they differ
+        int order = cursor.order(temp);
         //check if equal -->
-        if(temp->getKey() == key){
+        if(order == 0 && temp->getKey() == key){
             return temp;
         }
         //if key less than
-        else if (key < temp->getKey()){
+        else if (order < 0 || (order == 0 && (BST_STAT(comparisons, 1), key < temp->getKey()))){
             temp = temp->getLeft();
         }
         //key greater than
@@ -1029,6 +1933,12 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
     }
+    BST_STAT(nodeSwaps, 1);
+    //nodes keep their items, but drop them so no slot outlives a move
+    if(!lookupCache_.empty()) {
+        invalidateCached(n1);
+        invalidateCached(n2);
+    }
     Node<Key, Value>* n1p = n1->getParent();
     Node<Key, Value>* n1r = n1->getRight();
     Node<Key, Value>* n1lt = n1->getLeft();
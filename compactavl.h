@@ -0,0 +1,712 @@
+#ifndef COMPACTAVL_H
+#define COMPACTAVL_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <utility>
+#include "bst.h"
+
+// Upper bound on the height of any AVL tree that fits in memory
+// (1.44 * log2(n) stays below this for n < 2^64).
+#define COMPACT_AVL_MAX_HEIGHT 96
+
+// Pending ancestors an iterator keeps inline. Higher ones are dropped and
+// found again with a descent from the root once the iterator gets there.
+#define COMPACT_AVL_ITER_STACK 8
+
+/**
+* A node for CompactAVLTree. Unlike AVLNode it has no parent pointer and
+* no virtual functions, so it only carries the item, two child pointers
+* and the balance. Children are indexed 0 (left) and 1 (right), which
+* lets the fix-up code handle both mirror cases with one path.
+*/
+template <typename Key, typename Value>
+class CompactAVLNode
+{
+public:
+    CompactAVLNode(const Key& key, const Value& value);
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+    Value& getValue();
+
+    CompactAVLNode<Key, Value>* getChild(int dir) const;
+    void setChild(int dir, CompactAVLNode<Key, Value>* child);
+    int8_t getBalance() const;
+    void setBalance(int8_t balance);
+    void updateBalance(int8_t diff);
+
+protected:
+    std::pair<const Key, Value> item_;
+    CompactAVLNode<Key, Value>* child_[2];
+    int8_t balance_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the CompactAVLNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(const Key& key, const Value& value) :
+    item_(key, value), balance_(0)
+{
+    child_[0] = NULL;
+    child_[1] = NULL;
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem()
+{
+    return item_;
+}
+
+template<class Key, class Value>
+const Key& CompactAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<class Key, class Value>
+Value& CompactAVLNode<Key, Value>::getValue()
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+CompactAVLNode<Key, Value>* CompactAVLNode<Key, Value>::getChild(int dir) const
+{
+    return child_[dir];
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setChild(int dir, CompactAVLNode<Key, Value>* child)
+{
+    child_[dir] = child;
+}
+
+template<class Key, class Value>
+int8_t CompactAVLNode<Key, Value>::getBalance() const
+{
+    return balance_;
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    balance_ = balance;
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::updateBalance(int8_t diff)
+{
+    balance_ += diff;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the CompactAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVL tree without parent pointers.
+*
+* insert and remove record the root-to-leaf path in a fixed-size stack
+* while descending, then rebalance iteratively back up that stack and stop
+* as soon as a subtree's height is unchanged. Rotations only rewrite child
+* pointers. Iterators carry a small stack of the ancestors still to be
+* visited. Balance is height(right) - height(left), as in AVLTree.
+*/
+template <typename Key, typename Value>
+class CompactAVLTree
+{
+public:
+    CompactAVLTree();
+    ~CompactAVLTree();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    TreeStats stats() const;
+    void resetStats();
+
+    /**
+    * In-order iterator. The stack holds the current node on top and below
+    * it the ancestors whose left subtree we are in, i.e. the nodes still
+    * to be visited on the way back up. Only the deepest
+    * COMPACT_AVL_ITER_STACK of them are kept, so iterators stay small to
+    * copy; when the stack runs out with some dropped, the next node is
+    * found by descending from the root again. Each such descent follows a
+    * walk through a subtree at least that high, so it is rare.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class CompactAVLTree<Key, Value>;
+        void push(CompactAVLNode<Key, Value>* node);
+        void pushLeftSpine(CompactAVLNode<Key, Value>* node);
+        void seekAfter(const Key& key);
+        CompactAVLNode<Key, Value>* current() const;
+
+        const CompactAVLTree<Key, Value>* tree_;
+        CompactAVLNode<Key, Value>* stack_[COMPACT_AVL_ITER_STACK];
+        int depth_;
+        bool dropped_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    CompactAVLNode<Key, Value>* internalFind(const Key& key) const;
+    static CompactAVLNode<Key, Value>* rotate(CompactAVLNode<Key, Value>* node, int dir);
+    CompactAVLNode<Key, Value>* rebalance(CompactAVLNode<Key, Value>* node, bool& shorter);
+    void clearNode(CompactAVLNode<Key, Value>* node);
+    int height(CompactAVLNode<Key, Value>* node, bool& ok) const;
+
+    CompactAVLNode<Key, Value>* root_;
+#ifdef BST_STATS
+    mutable TreeStats stats_;
+#endif
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the CompactAVLTree::iterator class.
+---------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::iterator::iterator() :
+    tree_(NULL), depth_(0), dropped_(false)
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>& CompactAVLTree<Key, Value>::iterator::operator*() const
+{
+    return current()->getItem();
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>* CompactAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(current()->getItem());
+}
+
+template<class Key, class Value>
+bool CompactAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current() == rhs.current();
+}
+
+template<class Key, class Value>
+bool CompactAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current() != rhs.current();
+}
+
+/**
+* Pops the current node; if it has a right subtree, its smallest node is
+* next (pushing the left spine on the way), otherwise the next pending
+* ancestor is.
+*/
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator&
+CompactAVLTree<Key, Value>::iterator::operator++()
+{
+    BST_LATENCY_SCOPE(LAT_ITERATE);
+    CompactAVLNode<Key, Value>* node = stack_[--depth_];
+    if(node->getChild(1) != NULL) {
+        pushLeftSpine(node->getChild(1));
+    }
+    else if(depth_ == 0 && dropped_) {
+        seekAfter(node->getKey());
+    }
+    return *this;
+}
+
+//HELPER: push
+/*
+    pushes a pending node, dropping the highest one if the stack is full
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::iterator::push(CompactAVLNode<Key, Value>* node)
+{
+    if(depth_ == COMPACT_AVL_ITER_STACK) {
+        for(int i = 1; i < depth_; i++) {
+            stack_[i - 1] = stack_[i];
+        }
+        depth_--;
+        dropped_ = true;
+    }
+    stack_[depth_++] = node;
+}
+
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::iterator::pushLeftSpine(CompactAVLNode<Key, Value>* node)
+{
+    while(node != NULL) {
+        push(node);
+        node = node->getChild(0);
+    }
+}
+
+//HELPER: seekAfter
+/*
+    rebuilds the stack for the smallest key greater than key, pushing the
+    nodes we pass on the left as find() does
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::iterator::seekAfter(const Key& key)
+{
+    depth_ = 0;
+    dropped_ = false;
+    CompactAVLNode<Key, Value>* temp = tree_->root_;
+    while(temp != NULL) {
+        if(key < temp->getKey()) {
+            push(temp);
+            temp = temp->getChild(0);
+        }
+        else {
+            temp = temp->getChild(1);
+        }
+    }
+}
+
+template<class Key, class Value>
+CompactAVLNode<Key, Value>* CompactAVLTree<Key, Value>::iterator::current() const
+{
+    return depth_ == 0 ? NULL : stack_[depth_ - 1];
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the CompactAVLTree::iterator class.
+-------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::CompactAVLTree() :
+    root_(NULL)
+{
+
+}
+
+template<class Key, class Value>
+CompactAVLTree<Key, Value>::~CompactAVLTree()
+{
+    clear();
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is already present.
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    BST_LATENCY_SCOPE(LAT_INSERT);
+    CompactAVLNode<Key, Value>* path[COMPACT_AVL_MAX_HEIGHT];
+    int dirs[COMPACT_AVL_MAX_HEIGHT];
+    int depth = 0;
+
+    //1. descend, remembering the path
+    CompactAVLNode<Key, Value>* temp = root_;
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        if(keyValuePair.first == temp->getKey()) {
+            temp->getValue() = keyValuePair.second;
+            return;
+        }
+        BST_STAT(comparisons, 1);
+        int dir = (keyValuePair.first < temp->getKey()) ? 0 : 1;
+        path[depth] = temp;
+        dirs[depth] = dir;
+        depth++;
+        temp = temp->getChild(dir);
+    }
+
+    //2. link the new leaf
+    CompactAVLNode<Key, Value>* node = new CompactAVLNode<Key, Value>(keyValuePair.first, keyValuePair.second);
+    BST_STAT(allocations, 1);
+    if(depth == 0) {
+        root_ = node;
+        return;
+    }
+    path[depth - 1]->setChild(dirs[depth - 1], node);
+
+    //3. walk back up until some subtree's height stops growing
+    for(int i = depth - 1; i >= 0; i--) {
+        BST_STAT(rebalanceSteps, 1);
+        CompactAVLNode<Key, Value>* parent = path[i];
+        parent->updateBalance(dirs[i] ? 1 : -1);
+        if(parent->getBalance() == 0) {
+            return;
+        }
+        if(parent->getBalance() == 1 || parent->getBalance() == -1) {
+            continue;
+        }
+
+        //out of balance: one (double) rotation restores the old height
+        bool shorter;
+        CompactAVLNode<Key, Value>* sub = rebalance(parent, shorter);
+        if(i == 0) {
+            root_ = sub;
+        }
+        else {
+            path[i - 1]->setChild(dirs[i - 1], sub);
+        }
+        return;
+    }
+}
+
+/**
+* Removes the key if present. A node with two children is replaced by its
+* predecessor node (relinked, not copied, since keys are const).
+*/
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::remove(const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    CompactAVLNode<Key, Value>* path[COMPACT_AVL_MAX_HEIGHT];
+    int dirs[COMPACT_AVL_MAX_HEIGHT];
+    int depth = 0;
+
+    //1. descend to the node, remembering the path
+    CompactAVLNode<Key, Value>* temp = root_;
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        if(key == temp->getKey()) {
+            break;
+        }
+        BST_STAT(comparisons, 1);
+        int dir = (key < temp->getKey()) ? 0 : 1;
+        path[depth] = temp;
+        dirs[depth] = dir;
+        depth++;
+        temp = temp->getChild(dir);
+    }
+    if(temp == NULL) {
+        return;
+    }
+
+    //2a. two children: unlink the predecessor and put it in temp's place
+    if(temp->getChild(0) != NULL && temp->getChild(1) != NULL) {
+        int slot = depth;
+        path[depth] = temp;
+        dirs[depth] = 0;
+        depth++;
+        CompactAVLNode<Key, Value>* pred = temp->getChild(0);
+        while(pred->getChild(1) != NULL) {
+            path[depth] = pred;
+            dirs[depth] = 1;
+            depth++;
+            pred = pred->getChild(1);
+        }
+        path[depth - 1]->setChild(dirs[depth - 1], pred->getChild(0));
+
+        pred->setChild(0, temp->getChild(0));
+        pred->setChild(1, temp->getChild(1));
+        pred->setBalance(temp->getBalance());
+        if(slot == 0) {
+            root_ = pred;
+        }
+        else {
+            path[slot - 1]->setChild(dirs[slot - 1], pred);
+        }
+        path[slot] = pred;
+        BST_STAT(nodeSwaps, 1);
+    }
+    //2b. at most one child: promote it
+    else {
+        CompactAVLNode<Key, Value>* child = temp->getChild(0) != NULL ? temp->getChild(0) : temp->getChild(1);
+        if(depth == 0) {
+            root_ = child;
+        }
+        else {
+            path[depth - 1]->setChild(dirs[depth - 1], child);
+        }
+    }
+    delete temp;
+    BST_STAT(frees, 1);
+
+    //3. walk back up while subtrees keep getting shorter
+    for(int i = depth - 1; i >= 0; i--) {
+        BST_STAT(rebalanceSteps, 1);
+        CompactAVLNode<Key, Value>* parent = path[i];
+        parent->updateBalance(dirs[i] ? -1 : 1);
+        if(parent->getBalance() == 1 || parent->getBalance() == -1) {
+            return;
+        }
+        if(parent->getBalance() == 0) {
+            continue;
+        }
+
+        bool shorter;
+        CompactAVLNode<Key, Value>* sub = rebalance(parent, shorter);
+        if(i == 0) {
+            root_ = sub;
+        }
+        else {
+            path[i - 1]->setChild(dirs[i - 1], sub);
+        }
+        if(!shorter) {
+            return;
+        }
+    }
+}
+
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::clear()
+{
+    BST_LATENCY_SCOPE(LAT_CLEAR);
+    if(root_ != NULL) {
+        clearNode(root_);
+        root_ = NULL;
+    }
+}
+
+template<class Key, class Value>
+bool CompactAVLTree<Key, Value>::isBalanced() const
+{
+    bool ok = true;
+    height(root_, ok);
+    return ok;
+}
+
+template<class Key, class Value>
+bool CompactAVLTree<Key, Value>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<class Key, class Value>
+TreeStats CompactAVLTree<Key, Value>::stats() const
+{
+#ifdef BST_STATS
+    return stats_;
+#else
+    return TreeStats();
+#endif
+}
+
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::resetStats()
+{
+#ifdef BST_STATS
+    stats_ = TreeStats();
+#endif
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::begin() const
+{
+    iterator it;
+    it.tree_ = this;
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns an iterator to key, or end(). The ancestors we pass on the left
+* are pushed during the descent so the iterator can continue from there.
+*/
+template<class Key, class Value>
+typename CompactAVLTree<Key, Value>::iterator CompactAVLTree<Key, Value>::find(const Key& key) const
+{
+    BST_LATENCY_SCOPE(LAT_FIND);
+    iterator it;
+    it.tree_ = this;
+    CompactAVLNode<Key, Value>* temp = root_;
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        if(key == temp->getKey()) {
+            it.push(temp);
+            return it;
+        }
+        BST_STAT(comparisons, 1);
+        if(key < temp->getKey()) {
+            it.push(temp);
+            temp = temp->getChild(0);
+        }
+        else {
+            temp = temp->getChild(1);
+        }
+    }
+    return end();
+}
+
+template<class Key, class Value>
+Value& CompactAVLTree<Key, Value>::operator[](const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_SUBSCRIPT);
+    CompactAVLNode<Key, Value>* curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+template<class Key, class Value>
+Value const & CompactAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    BST_LATENCY_SCOPE(LAT_SUBSCRIPT);
+    CompactAVLNode<Key, Value>* curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+//HELPER: internalFind
+template<class Key, class Value>
+CompactAVLNode<Key, Value>* CompactAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    CompactAVLNode<Key, Value>* temp = root_;
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        if(key == temp->getKey()) {
+            return temp;
+        }
+        BST_STAT(comparisons, 1);
+        temp = temp->getChild(key < temp->getKey() ? 0 : 1);
+    }
+    return NULL;
+}
+
+//HELPER: rotate
+/*
+    lifts node's dir child above it and returns the child (the new subtree
+    root); balances are left to the caller
+*/
+template<class Key, class Value>
+CompactAVLNode<Key, Value>* CompactAVLTree<Key, Value>::rotate(CompactAVLNode<Key, Value>* node, int dir)
+{
+    CompactAVLNode<Key, Value>* child = node->getChild(dir);
+    node->setChild(dir, child->getChild(1 - dir));
+    child->setChild(1 - dir, node);
+    return child;
+}
+
+//HELPER: rebalance
+/*
+    fixes a node whose balance is +2 or -2 and returns the new subtree root.
+    shorter is set if the subtree ended up one level lower than it was
+    before the fix (always the case except for a single rotation around a
+    balanced child, which only happens on removal)
+*/
+template<class Key, class Value>
+CompactAVLNode<Key, Value>* CompactAVLTree<Key, Value>::rebalance(CompactAVLNode<Key, Value>* node, bool& shorter)
+{
+    //dir is the heavy side, sign is +1 for right heavy and -1 for left
+    int dir = node->getBalance() > 0 ? 1 : 0;
+    int8_t sign = dir ? 1 : -1;
+    CompactAVLNode<Key, Value>* child = node->getChild(dir);
+
+    //zig-zig (or balanced child): single rotation
+    if(child->getBalance() != -sign) {
+        CompactAVLNode<Key, Value>* top = rotate(node, dir);
+        BST_STAT(singleRotations, 1);
+        if(child->getBalance() == 0) {
+            node->setBalance(sign);
+            child->setBalance(-sign);
+            shorter = false;
+        }
+        else {
+            node->setBalance(0);
+            child->setBalance(0);
+            shorter = true;
+        }
+        return top;
+    }
+
+    //zig-zag: double rotation through the grandchild
+    CompactAVLNode<Key, Value>* grand = child->getChild(1 - dir);
+    node->setChild(dir, rotate(child, 1 - dir));
+    CompactAVLNode<Key, Value>* top = rotate(node, dir);
+    BST_STAT(doubleRotations, 1);
+    if(grand->getBalance() == sign) {
+        node->setBalance(-sign);
+        child->setBalance(0);
+    }
+    else if(grand->getBalance() == 0) {
+        node->setBalance(0);
+        child->setBalance(0);
+    }
+    else {
+        node->setBalance(0);
+        child->setBalance(sign);
+    }
+    grand->setBalance(0);
+    shorter = true;
+    return top;
+}
+
+//HELPER: clearNode
+template<class Key, class Value>
+void CompactAVLTree<Key, Value>::clearNode(CompactAVLNode<Key, Value>* node)
+{
+    if(node->getChild(0) != NULL) {
+        clearNode(node->getChild(0));
+    }
+    if(node->getChild(1) != NULL) {
+        clearNode(node->getChild(1));
+    }
+    delete node;
+    BST_STAT(frees, 1);
+}
+
+//HELPER: height
+/*
+    height of the subtree; clears ok if any node is out of balance or its
+    stored balance is wrong
+*/
+template<class Key, class Value>
+int CompactAVLTree<Key, Value>::height(CompactAVLNode<Key, Value>* node, bool& ok) const
+{
+    if(node == NULL) {
+        return 0;
+    }
+    int left = height(node->getChild(0), ok);
+    int right = height(node->getChild(1), ok);
+    if(right - left != node->getBalance() || right - left > 1 || left - right > 1) {
+        ok = false;
+    }
+    return 1 + (left > right ? left : right);
+}
+
+#endif
@@ -0,0 +1,746 @@
+#ifndef DURABLESTORE_H
+#define DURABLESTORE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "avlbst.h"
+#include "snapshot.h"
+
+// Items copied from the live tree per lock hold while taking a checkpoint.
+#define DURABLE_CHECKPOINT_CHUNK 1024
+
+// Largest log record payload, in bytes. Recovery treats a longer length
+// field as a torn record rather than trying to read it.
+#define DURABLE_MAX_RECORD (1u << 30)
+
+/**
+* When the log writer thread forces log data to disk.
+*   SYNC_NONE:     never; data reaches the OS page cache only.
+*   SYNC_INTERVAL: at most every syncIntervalMs; writers do not wait.
+*   SYNC_COMMIT:   after every group of records; each insert/remove waits
+*                  until its record is on disk (group commit), and the
+*                  change only becomes visible to lookups at that point.
+*/
+enum SyncPolicy
+{
+    SYNC_NONE,
+    SYNC_INTERVAL,
+    SYNC_COMMIT
+};
+
+/**
+* Tuning knobs for DurableAVLStore.
+*/
+struct DurabilityOptions
+{
+    DurabilityOptions() :
+        sync(SYNC_COMMIT), syncIntervalMs(10), checkpointEvery(1000000)
+    {}
+
+    SyncPolicy sync;
+    // Used with SYNC_INTERVAL.
+    unsigned syncIntervalMs;
+    // Take a checkpoint after this many logged operations (0 disables).
+    uint64_t checkpointEvery;
+};
+
+/**
+* An AVLTree-backed key/value table whose updates survive a crash.
+*
+* Every insert/remove is queued as a record for a write-ahead log in dir
+* before it touches the in-memory tree, so a failed log rejects the update
+* outright. A dedicated thread writes the log: records queued while it is
+* busy go out together in a single write (and fsync, depending on the
+* SyncPolicy). Under SYNC_COMMIT that thread also applies each group to the
+* tree once it is synced.
+*
+* Checkpoints run on a background thread every checkpointEvery updates.
+* The writer first moves the log aside to wal.old.log and starts a new one;
+* the tree is then copied a chunk at a time (so updates carry on in
+* between), saved with AVLTree::save tagged with the sequence number (LSN)
+* of the last record applied before the copy began, and the old log is
+* deleted. Records are blind writes, so replaying those past that LSN over
+* the copy gives the right tree. On construction the latest checkpoint is
+* loaded and the records after it are replayed from both logs; a torn
+* record at the end of the current log is discarded.
+*
+* Log record: payload length (u32), FNV-1a checksum of the payload (u32),
+* then the payload: LSN (u64), op (u8), key, and the value for inserts.
+*
+* All public members are thread safe.
+*/
+template <typename Key, typename Value,
+          typename KeySer = SnapshotSerializer<Key>, typename ValueSer = SnapshotSerializer<Value> >
+class DurableAVLStore
+{
+public:
+    explicit DurableAVLStore(const std::string& dir, const DurabilityOptions& options = DurabilityOptions());
+    ~DurableAVLStore();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool lookup(const Key& key, Value& value) const;
+
+    void checkpoint();
+    void sync();
+    uint64_t lastLsn() const;
+
+private:
+    DurableAVLStore(const DurableAVLStore&);
+    DurableAVLStore& operator=(const DurableAVLStore&);
+
+    enum { OP_INSERT = 1, OP_REMOVE = 2 };
+
+    // An update waiting to be applied by the writer under SYNC_COMMIT.
+    struct PendingOp
+    {
+        uint8_t op;
+        Key key;
+        Value value;
+    };
+
+    void recover();
+    uint64_t replayLog(const std::string& path, uint64_t checkpointLsn, bool tornTail);
+    uint64_t appendRecord(uint8_t op, const Key& key, const Value* value);
+    void waitWritten(uint64_t lsn, bool synced);
+    void checkpointLocked();
+    void rotateLogs();
+    bool switchLog();
+    void syncDir();
+    void writerLoop();
+    void checkpointerLoop();
+    static uint32_t checksum(const char* data, size_t len);
+
+    std::string dir_;
+    std::string logPath_;
+    std::string oldLogPath_;
+    std::string checkpointPath_;
+    DurabilityOptions options_;
+    int logFd_;
+
+    // Guards the tree and LSN assignment; records are queued in LSN order.
+    // Lock order: treeMutex_ before queueMutex_.
+    mutable std::mutex treeMutex_;
+    AVLTree<Key, Value> tree_;
+    uint64_t nextLsn_;
+    uint64_t appliedLsn_;
+    uint64_t opsSinceCheckpoint_;
+
+    // Serializes checkpoints and guards hasOldLog_.
+    std::mutex checkpointMutex_;
+    bool hasOldLog_;
+
+    // Guards the queue shared with the writer and checkpoint threads.
+    std::mutex queueMutex_;
+    std::condition_variable queueReady_;
+    std::condition_variable durable_;
+    std::condition_variable checkpointReady_;
+    std::vector<char> pending_;
+    std::vector<PendingOp> pendingOps_;
+    uint64_t pendingLsn_;
+    uint64_t writtenLsn_;
+    uint64_t syncedLsn_;
+    bool syncRequested_;
+    bool rotateRequested_;
+    bool checkpointDue_;
+    bool stopping_;
+    bool checkpointerStopping_;
+    bool failed_;
+    std::thread writer_;
+    std::thread checkpointer_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the DurableAVLStore class.
+  -----------------------------------------------
+*/
+
+/**
+* Opens (creating if needed) the store in dir, recovers its contents and
+* starts the log writer and checkpoint threads. Throws std::runtime_error
+* on I/O failure.
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+DurableAVLStore<Key, Value, KeySer, ValueSer>::DurableAVLStore(const std::string& dir, const DurabilityOptions& options) :
+    dir_(dir), logPath_(dir + "/wal.log"), oldLogPath_(dir + "/wal.old.log"),
+    checkpointPath_(dir + "/checkpoint"), options_(options), logFd_(-1),
+    nextLsn_(1), appliedLsn_(0), opsSinceCheckpoint_(0), hasOldLog_(false),
+    pendingLsn_(0), writtenLsn_(0), syncedLsn_(0), syncRequested_(false),
+    rotateRequested_(false), checkpointDue_(false), stopping_(false),
+    checkpointerStopping_(false), failed_(false)
+{
+    if(::mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Cannot create " + dir_);
+    }
+    recover();
+
+    logFd_ = ::open(logPath_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(logFd_ < 0) {
+        throw std::runtime_error("Cannot open " + logPath_);
+    }
+    appliedLsn_ = pendingLsn_ = writtenLsn_ = syncedLsn_ = nextLsn_ - 1;
+    writer_ = std::thread(&DurableAVLStore::writerLoop, this);
+    checkpointer_ = std::thread(&DurableAVLStore::checkpointerLoop, this);
+}
+
+/**
+* Lets a running checkpoint finish, then drains and syncs the log and stops
+* the writer.
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+DurableAVLStore<Key, Value, KeySer, ValueSer>::~DurableAVLStore()
+{
+    //the checkpointer needs the writer to rotate the log, so it stops first
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        checkpointerStopping_ = true;
+    }
+    checkpointReady_.notify_one();
+    checkpointer_.join();
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        stopping_ = true;
+    }
+    queueReady_.notify_one();
+    writer_.join();
+    ::close(logFd_);
+}
+
+/**
+* Inserts or overwrites a key. Throws std::runtime_error, leaving the tree
+* unchanged, if the log has failed. With SYNC_COMMIT, returns once the
+* update is on disk.
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(treeMutex_);
+        lsn = appendRecord(OP_INSERT, keyValuePair.first, &keyValuePair.second);
+        if(options_.sync != SYNC_COMMIT) {
+            tree_.insert(keyValuePair);
+            appliedLsn_ = lsn;
+        }
+    }
+    if(options_.sync == SYNC_COMMIT) {
+        waitWritten(lsn, true);
+    }
+}
+
+/**
+* Removes a key. Throws std::runtime_error, leaving the tree unchanged, if
+* the log has failed. With SYNC_COMMIT, returns once the update is on disk.
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::remove(const Key& key)
+{
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(treeMutex_);
+        lsn = appendRecord(OP_REMOVE, key, NULL);
+        if(options_.sync != SYNC_COMMIT) {
+            tree_.remove(key);
+            appliedLsn_ = lsn;
+        }
+    }
+    if(options_.sync == SYNC_COMMIT) {
+        waitWritten(lsn, true);
+    }
+}
+
+/**
+* Copies the value for key into value and returns true, or returns false
+* if the key is absent.
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+bool DurableAVLStore<Key, Value, KeySer, ValueSer>::lookup(const Key& key, Value& value) const
+{
+    std::lock_guard<std::mutex> lock(treeMutex_);
+    typename AVLTree<Key, Value>::iterator it = tree_.find(key);
+    if(it == tree_.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+/**
+* Saves the tree and drops the log records it covers. Updates and lookups
+* are only held up while each chunk of the tree is copied.
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::checkpoint()
+{
+    std::lock_guard<std::mutex> lock(checkpointMutex_);
+    checkpointLocked();
+}
+
+/**
+* Blocks until every update made so far is on disk, whatever the policy.
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::sync()
+{
+    waitWritten(lastLsn(), true);
+}
+
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+uint64_t DurableAVLStore<Key, Value, KeySer, ValueSer>::lastLsn() const
+{
+    std::lock_guard<std::mutex> lock(treeMutex_);
+    return nextLsn_ - 1;
+}
+
+//HELPER: recover
+/*
+    loads the checkpoint, then replays the records newer than it from the
+    old log (left by an unfinished checkpoint) and the current one
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::recover()
+{
+    uint64_t checkpointLsn = 0;
+    std::ifstream ckpt(checkpointPath_.c_str(), std::ios::binary);
+    if(ckpt) {
+        if(!ckpt.read(reinterpret_cast<char*>(&checkpointLsn), sizeof(checkpointLsn))) {
+            throw std::runtime_error("Corrupt checkpoint " + checkpointPath_);
+        }
+        tree_.template load<KeySer, ValueSer>(ckpt);
+    }
+    nextLsn_ = checkpointLsn + 1;
+
+    hasOldLog_ = (::access(oldLogPath_.c_str(), F_OK) == 0);
+    if(hasOldLog_) {
+        replayLog(oldLogPath_, checkpointLsn, false);
+    }
+    uint64_t goodBytes = replayLog(logPath_, checkpointLsn, true);
+
+    //drop a torn tail so later records are not hidden behind it
+    if(::access(logPath_.c_str(), F_OK) == 0 &&
+       ::truncate(logPath_.c_str(), static_cast<off_t>(goodBytes)) != 0) {
+        throw std::runtime_error("Cannot truncate " + logPath_);
+    }
+}
+
+//HELPER: replayLog
+/*
+    applies the records of one log file newer than checkpointLsn and returns
+    the length of its intact prefix. A bad record ends the current log (a
+    torn write, if tornTail is set) but means corruption in the old one,
+    which was synced before it was moved aside
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+uint64_t DurableAVLStore<Key, Value, KeySer, ValueSer>::replayLog(const std::string& path, uint64_t checkpointLsn, bool tornTail)
+{
+    std::ifstream log(path.c_str(), std::ios::binary | std::ios::ate);
+    if(!log) {
+        return 0;
+    }
+    uint64_t fileBytes = static_cast<uint64_t>(log.tellg());
+    log.seekg(0);
+
+    std::vector<char> payload;
+    uint64_t goodBytes = 0;
+    while(goodBytes < fileBytes) {
+        uint32_t frame[2];
+        if(fileBytes - goodBytes < sizeof(frame) || !log.read(reinterpret_cast<char*>(frame), sizeof(frame))) {
+            break;
+        }
+        //a length running past the end of the file is a torn header
+        uint64_t left = fileBytes - goodBytes - sizeof(frame);
+        if(frame[0] < sizeof(uint64_t) + 1 || frame[0] > left || frame[0] > DURABLE_MAX_RECORD) {
+            break;
+        }
+        payload.resize(frame[0]);
+        if(!log.read(&payload[0], frame[0]) || checksum(&payload[0], payload.size()) != frame[1]) {
+            break;
+        }
+
+        SnapshotReader in(&payload[0], payload.size());
+        uint64_t lsn;
+        uint8_t op;
+        Key key;
+        in.get(&lsn, sizeof(lsn));
+        in.get(&op, sizeof(op));
+        KeySer::read(in, key);
+        if(lsn > checkpointLsn) {
+            if(op == OP_INSERT) {
+                Value value;
+                ValueSer::read(in, value);
+                tree_.insert(std::make_pair(key, value));
+            }
+            else {
+                tree_.remove(key);
+            }
+        }
+        if(lsn >= nextLsn_) {
+            nextLsn_ = lsn + 1;
+        }
+        goodBytes += sizeof(frame) + frame[0];
+    }
+    if(goodBytes < fileBytes && !tornTail) {
+        throw std::runtime_error("Corrupt log " + path);
+    }
+    return goodBytes;
+}
+
+//HELPER: appendRecord
+/*
+    encodes one record with the next LSN, queues it for the writer and
+    returns its LSN; under SYNC_COMMIT the update is queued as well, for the
+    writer to apply. Called with treeMutex_ held, before the tree changes,
+    so the log order matches the tree order
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+uint64_t DurableAVLStore<Key, Value, KeySer, ValueSer>::appendRecord(uint8_t op, const Key& key, const Value* value)
+{
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    if(failed_) {
+        throw std::runtime_error("Write-ahead log failed: " + logPath_);
+    }
+    uint64_t lsn = nextLsn_;
+    size_t start = pending_.size();
+    pending_.resize(start + 2 * sizeof(uint32_t));
+    SnapshotWriter out(pending_);
+    out.put(&lsn, sizeof(lsn));
+    out.put(&op, sizeof(op));
+    KeySer::write(out, key);
+    if(value != NULL) {
+        ValueSer::write(out, *value);
+    }
+
+    size_t payloadStart = start + 2 * sizeof(uint32_t);
+    if(pending_.size() - payloadStart > DURABLE_MAX_RECORD) {
+        pending_.resize(start);
+        throw std::length_error("Log record too large");
+    }
+    uint32_t frame[2];
+    frame[0] = static_cast<uint32_t>(pending_.size() - payloadStart);
+    frame[1] = checksum(&pending_[payloadStart], frame[0]);
+    std::memcpy(&pending_[start], frame, sizeof(frame));
+
+    if(options_.sync == SYNC_COMMIT) {
+        pendingOps_.push_back(PendingOp());
+        pendingOps_.back().op = op;
+        pendingOps_.back().key = key;
+        if(value != NULL) {
+            pendingOps_.back().value = *value;
+        }
+    }
+    nextLsn_++;
+    pendingLsn_ = lsn;
+    queueReady_.notify_one();
+
+    if(options_.checkpointEvery != 0 && ++opsSinceCheckpoint_ == options_.checkpointEvery) {
+        checkpointDue_ = true;
+        checkpointReady_.notify_one();
+    }
+    return lsn;
+}
+
+//HELPER: waitWritten
+/*
+    blocks until the writer has written lsn to the log, and also synced it
+    if synced is set (which forces a sync under any policy)
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::waitWritten(uint64_t lsn, bool synced)
+{
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    while((synced ? syncedLsn_ : writtenLsn_) < lsn && !failed_) {
+        if(synced) {
+            syncRequested_ = true;
+        }
+        queueReady_.notify_one();
+        durable_.wait(lock);
+    }
+    if(failed_) {
+        throw std::runtime_error("Write-ahead log failed: " + logPath_);
+    }
+}
+
+//HELPER: checkpointLocked
+/*
+    called with checkpointMutex_ held. Once the log is rotated, every record
+    in the old one is in the tree, so a copy of the tree started after that
+    covers them. The copy is taken a chunk at a time; updates that slip in
+    between chunks are past its LSN and get replayed again on recovery. The
+    checkpoint is written to a temporary file and renamed into place, so a
+    crash leaves either the old or the new one, and the old log is only
+    deleted after that
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::checkpointLocked()
+{
+    //a previous checkpoint that failed midway left its old log behind
+    if(!hasOldLog_) {
+        rotateLogs();
+        hasOldLog_ = true;
+    }
+
+    AVLTree<Key, Value> copy;
+    uint64_t lsn = 0;
+    Key last;
+    bool started = false;
+    bool done = false;
+    while(!done) {
+        std::lock_guard<std::mutex> lock(treeMutex_);
+        if(!started) {
+            lsn = appliedLsn_;
+            opsSinceCheckpoint_ = 0;
+        }
+        typename AVLTree<Key, Value>::iterator it = started ? tree_.upper_bound(last) : tree_.begin();
+        for(size_t n = 0; n < DURABLE_CHECKPOINT_CHUNK && it != tree_.end(); ++n, ++it) {
+            copy.insert(copy.end(), *it);
+            last = it->first;
+        }
+        done = (it == tree_.end());
+        started = true;
+    }
+
+    std::string tmpPath = checkpointPath_ + ".tmp";
+    {
+        std::vector<char> buf(SNAPSHOT_BUFFER_SIZE);
+        std::ofstream out;
+        out.rdbuf()->pubsetbuf(&buf[0], buf.size());
+        out.open(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&lsn), sizeof(lsn));
+        copy.template save<KeySer, ValueSer>(out);
+        out.close();
+        if(!out) {
+            throw std::runtime_error("Cannot write " + tmpPath);
+        }
+    }
+
+    int fd = ::open(tmpPath.c_str(), O_RDONLY);
+    bool synced = (fd >= 0 && ::fsync(fd) == 0);
+    if(fd >= 0) {
+        ::close(fd);
+    }
+    if(!synced || ::rename(tmpPath.c_str(), checkpointPath_.c_str()) != 0) {
+        throw std::runtime_error("Cannot install " + checkpointPath_);
+    }
+    syncDir();
+
+    //if this is lost in a crash, recovery skips the records in it again
+    if(::unlink(oldLogPath_.c_str()) != 0 && errno != ENOENT) {
+        throw std::runtime_error("Cannot remove " + oldLogPath_);
+    }
+    hasOldLog_ = false;
+}
+
+//HELPER: rotateLogs
+/*
+    asks the writer to move the log aside after its next group and waits
+    until it has
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::rotateLogs()
+{
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    rotateRequested_ = true;
+    queueReady_.notify_one();
+    while(rotateRequested_ && !failed_) {
+        durable_.wait(lock);
+    }
+    if(failed_) {
+        throw std::runtime_error("Write-ahead log failed: " + logPath_);
+    }
+}
+
+//HELPER: switchLog
+/*
+    called by the writer with the log synced: renames it to the old log and
+    opens an empty one in its place
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+bool DurableAVLStore<Key, Value, KeySer, ValueSer>::switchLog()
+{
+    if(::rename(logPath_.c_str(), oldLogPath_.c_str()) != 0) {
+        return false;
+    }
+    int fd = ::open(logPath_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_TRUNC, 0644);
+    if(fd < 0) {
+        return false;
+    }
+    ::close(logFd_);
+    logFd_ = fd;
+    syncDir();
+    return true;
+}
+
+//HELPER: syncDir
+/*
+    makes renames and new files in the store directory durable
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::syncDir()
+{
+    int fd = ::open(dir_.c_str(), O_RDONLY);
+    if(fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+//HELPER: writerLoop
+/*
+    body of the log writer thread: takes everything queued as one group,
+    writes it with a single call and syncs according to the policy. Under
+    SYNC_COMMIT the group is then applied to the tree; the waiting writers
+    are only released after that, so they see their own updates
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::writerLoop()
+{
+    typedef std::chrono::steady_clock Clock;
+    std::vector<char> batch;
+    std::vector<PendingOp> ops;
+    Clock::time_point lastSync = Clock::now();
+    bool unsynced = false;
+
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    while(true) {
+        if(pending_.empty() && !stopping_ && !syncRequested_ && !rotateRequested_) {
+            if(options_.sync == SYNC_INTERVAL && unsynced) {
+                queueReady_.wait_for(lock, std::chrono::milliseconds(options_.syncIntervalMs));
+            }
+            else {
+                queueReady_.wait(lock);
+            }
+        }
+        if(pending_.empty() && stopping_ && !unsynced) {
+            break;
+        }
+
+        batch.swap(pending_);
+        ops.swap(pendingOps_);
+        uint64_t batchLsn = pendingLsn_;
+        bool rotate = rotateRequested_;
+        bool forceSync = syncRequested_ || stopping_ || rotate;
+        syncRequested_ = false;
+        lock.unlock();
+
+        bool ok = true;
+        size_t done = 0;
+        while(ok && done < batch.size()) {
+            ssize_t n = ::write(logFd_, &batch[done], batch.size() - done);
+            if(n < 0 && errno != EINTR) {
+                ok = false;
+            }
+            else if(n > 0) {
+                done += static_cast<size_t>(n);
+            }
+        }
+        unsynced = unsynced || !batch.empty();
+        batch.clear();
+
+        bool syncNow = forceSync || (options_.sync == SYNC_COMMIT) ||
+            (options_.sync == SYNC_INTERVAL &&
+             Clock::now() - lastSync >= std::chrono::milliseconds(options_.syncIntervalMs));
+        bool didSync = false;
+        if(ok && syncNow) {
+            if(unsynced) {
+                ok = (::fdatasync(logFd_) == 0);
+                lastSync = Clock::now();
+                unsynced = false;
+            }
+            didSync = ok;
+        }
+
+        if(ok && !ops.empty()) {
+            std::lock_guard<std::mutex> treeLock(treeMutex_);
+            for(size_t i = 0; i < ops.size(); i++) {
+                if(ops[i].op == OP_INSERT) {
+                    tree_.insert(std::make_pair(ops[i].key, ops[i].value));
+                }
+                else {
+                    tree_.remove(ops[i].key);
+                }
+            }
+            appliedLsn_ = batchLsn;
+        }
+        ops.clear();
+        if(ok && rotate) {
+            ok = switchLog();
+        }
+
+        lock.lock();
+        if(!ok) {
+            failed_ = true;
+        }
+        writtenLsn_ = batchLsn;
+        if(didSync) {
+            syncedLsn_ = batchLsn;
+        }
+        if(rotate && ok) {
+            rotateRequested_ = false;
+        }
+        durable_.notify_all();
+        if(!ok) {
+            break;
+        }
+    }
+}
+
+//HELPER: checkpointerLoop
+/*
+    body of the checkpoint thread. A failed checkpoint leaves the logs in
+    place, so nothing is lost; the next one retries
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+void DurableAVLStore<Key, Value, KeySer, ValueSer>::checkpointerLoop()
+{
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    while(true) {
+        while(!checkpointDue_ && !checkpointerStopping_) {
+            checkpointReady_.wait(lock);
+        }
+        if(checkpointerStopping_) {
+            break;
+        }
+        checkpointDue_ = false;
+        lock.unlock();
+        try {
+            checkpoint();
+        }
+        catch(const std::exception&) {
+        }
+        lock.lock();
+    }
+}
+
+//HELPER: checksum
+/*
+    32-bit FNV-1a over a record payload
+*/
+template<typename Key, typename Value, typename KeySer, typename ValueSer>
+uint32_t DurableAVLStore<Key, Value, KeySer, ValueSer>::checksum(const char* data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < len; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef INTERVALTREE_H
+#define INTERVALTREE_H
+
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "aggregateavl.h"
+
+/**
+* The closed interval [start, end], the key type of IntervalTree. Intervals
+* are ordered by start, then by end.
+*/
+template <typename Point>
+struct Interval
+{
+    Interval() : start(), end() {}
+    Interval(const Point& s, const Point& e) : start(s), end(e) {}
+
+    Point start;
+    Point end;
+};
+
+template <typename Point>
+bool operator<(const Interval<Point>& a, const Interval<Point>& b)
+{
+    return a.start < b.start || (!(b.start < a.start) && a.end < b.end);
+}
+
+template <typename Point>
+bool operator==(const Interval<Point>& a, const Interval<Point>& b)
+{
+    return a.start == b.start && a.end == b.end;
+}
+
+template <typename Point>
+std::ostream& operator<<(std::ostream& out, const Interval<Point>& interval)
+{
+    return out << '[' << interval.start << ", " << interval.end << ']';
+}
+
+/**
+* Monoid policy for IntervalTree: the largest interval end in a subtree.
+*/
+template <typename Point, typename Value>
+struct IntervalEndMonoid
+{
+    typedef Point aggregate_type;
+    static Point identity() { return std::numeric_limits<Point>::lowest(); }
+    static Point combine(const Point& a, const Point& b) { return a < b ? b : a; }
+    static Point lift(const Interval<Point>& key, const Value&) { return key.end; }
+};
+
+/**
+* An interval tree: an AVL tree keyed by closed Intervals whose nodes keep
+* the largest end in their subtree (an AggregateAVLTree with
+* IntervalEndMonoid). Insert and remove are O(log n), with the usual AVL
+* fix-ups keeping the ends current.
+*
+* overlapping() skips every subtree whose largest end lies before the
+* query and stops at the first start past it, so a query reporting k
+* intervals visits O(log n) nodes plus the paths down to the reported
+* ones: O(log n + k) when the matches are close together in start order,
+* and never more than O(log n + k log(n / k)).
+*
+* Point must be ordered by < and have std::numeric_limits. Each interval
+* is stored once; inserting the same interval again overwrites its value.
+*/
+template <class Point, class Value>
+class IntervalTree : public AggregateAVLTree<Interval<Point>, Value, IntervalEndMonoid<Point, Value> >
+{
+public:
+    typedef AggregateAVLTree<Interval<Point>, Value, IntervalEndMonoid<Point, Value> > Base;
+    typedef typename Base::iterator iterator;
+
+    using Base::insert;
+    using Base::remove;
+    void insert(const Point& start, const Point& end, const Value& value);
+    void remove(const Point& start, const Point& end);
+
+    void overlapping(const Point& lo, const Point& hi, std::vector<iterator>& out) const;
+    void stabbing(const Point& point, std::vector<iterator>& out) const;
+
+protected:
+    typedef typename Base::ANode ANode;
+
+    virtual AVLNode<Interval<Point>, Value>* createNode(const Interval<Point>& key, const Value& value, AVLNode<Interval<Point>, Value>* parent) override;
+
+    void collectOverlaps(ANode* node, const Point& lo, const Point& hi, std::vector<iterator>& out) const;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the IntervalTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Inserts the interval [start, end] (overwriting the value if it is
+* already there); throws std::invalid_argument if end < start.
+*/
+template<class Point, class Value>
+void IntervalTree<Point, Value>::insert(const Point& start, const Point& end, const Value& value)
+{
+    this->insert(std::make_pair(Interval<Point>(start, end), value));
+}
+
+/**
+* Removes the interval [start, end] if present.
+*/
+template<class Point, class Value>
+void IntervalTree<Point, Value>::remove(const Point& start, const Point& end)
+{
+    this->remove(Interval<Point>(start, end));
+}
+
+/**
+* Sets out to every interval that shares at least one point with [lo, hi],
+* in key order. out is empty if hi < lo.
+*/
+template<class Point, class Value>
+void IntervalTree<Point, Value>::overlapping(const Point& lo, const Point& hi, std::vector<iterator>& out) const
+{
+    out.clear();
+    if(hi < lo) {
+        return;
+    }
+    collectOverlaps(static_cast<ANode*>(this->root_), lo, hi, out);
+}
+
+/**
+* Sets out to every interval containing point, in key order.
+*/
+template<class Point, class Value>
+void IntervalTree<Point, Value>::stabbing(const Point& point, std::vector<iterator>& out) const
+{
+    overlapping(point, point, out);
+}
+
+//HELPER: createNode
+/*
+    every interval enters the tree here (insert, hinted insert and load),
+    so this is where malformed ones are rejected
+*/
+template<class Point, class Value>
+AVLNode<Interval<Point>, Value>* IntervalTree<Point, Value>::createNode(const Interval<Point>& key, const Value& value, AVLNode<Interval<Point>, Value>* parent)
+{
+    if(key.end < key.start) {
+        throw std::invalid_argument("Interval end before its start");
+    }
+    return Base::createNode(key, value, parent);
+}
+
+//HELPER: collectOverlaps
+/*
+    in-order walk of node's subtree: a subtree whose largest end is before
+    lo holds no matches, and once a start is past hi neither does anything
+    to its right
+*/
+template<class Point, class Value>
+void IntervalTree<Point, Value>::collectOverlaps(ANode* node, const Point& lo, const Point& hi, std::vector<iterator>& out) const
+{
+    if(node == NULL || node->getAggregate() < lo) {
+        return;
+    }
+    BST_STAT(nodeVisits, 1);
+    collectOverlaps(node->getLeft(), lo, hi, out);
+    if(hi < node->getKey().start) {
+        return;
+    }
+    if(!(node->getKey().end < lo)) {
+        out.push_back(this->makeIterator(node));
+    }
+    collectOverlaps(node->getRight(), lo, hi, out);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the IntervalTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/**
+* Tree operations that get their own latency histogram.
+*/
+enum LatencyOp
+{
+    LAT_INSERT,
+    LAT_REMOVE,
+    LAT_FIND,
+    LAT_SUBSCRIPT,      // operator[]
+    LAT_ITERATE,        // one iterator increment
+    LAT_CLEAR,
+    LAT_FIND_MANY,      // one find_many() batch, however many keys
+    LAT_NUM_OPS
+};
+
+static const char* const LATENCY_OP_NAMES[LAT_NUM_OPS] = {
+    "insert", "remove", "find", "operator[]", "iterate", "clear", "find_many"
+};
+
+/**
+* A log-linear (HDR-style) histogram of latencies in nanoseconds.
+*
+* Values below 32 get a bucket each; above that every power of two is
+* split into 16 buckets, so any recorded value is known to within about
+* 6% across the whole 64-bit range using under 1000 counters.
+*/
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKETS = 16;
+    static const int NUM_BUCKETS = 60 * SUB_BUCKETS + 16;
+
+    LatencyHistogram();
+
+    void record(uint64_t ns);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t max() const;
+    double mean() const;
+    uint64_t percentile(double p) const;
+
+    static int bucketOf(uint64_t ns);
+    static uint64_t bucketHigh(int bucket);
+
+private:
+    friend class LatencyRecorder;
+
+    uint64_t counts_[NUM_BUCKETS];
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+};
+
+/**
+* Per-thread latency recorder. Each thread records into its own counters
+* with plain (relaxed) stores, so recording never contends; collect()
+* merges the counters of every live thread plus those of threads that
+* have already exited.
+*/
+class LatencyRecorder
+{
+public:
+    static LatencyRecorder& local();
+
+    void record(LatencyOp op, uint64_t ns);
+
+    static std::vector<LatencyHistogram> collect();
+    static void reset();
+    static void dump(std::ostream& out);
+
+    ~LatencyRecorder();
+
+private:
+    LatencyRecorder();
+    LatencyRecorder(const LatencyRecorder&);
+    LatencyRecorder& operator=(const LatencyRecorder&);
+
+    void addTo(std::vector<LatencyHistogram>& hists) const;
+    void clear();
+
+    static std::mutex& registryMutex();
+    static std::vector<LatencyRecorder*>& registry();
+    static std::vector<LatencyHistogram>& retired();
+
+    struct Slot
+    {
+        std::atomic<uint64_t> counts[LatencyHistogram::NUM_BUCKETS];
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+    Slot slots_[LAT_NUM_OPS];
+};
+
+/**
+* Times the enclosing scope into the calling thread's recorder.
+*/
+class LatencyTimer
+{
+public:
+    explicit LatencyTimer(LatencyOp op) :
+        op_(op), start_(std::chrono::steady_clock::now())
+    {}
+    ~LatencyTimer()
+    {
+        std::chrono::steady_clock::duration d = std::chrono::steady_clock::now() - start_;
+        LatencyRecorder::local().record(op_,
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+    }
+
+private:
+    LatencyOp op_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the LatencyHistogram class.
+  -----------------------------------------------
+*/
+
+inline LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+inline void LatencyHistogram::record(uint64_t ns)
+{
+    counts_[bucketOf(ns)]++;
+    count_++;
+    sum_ += ns;
+    if(ns > max_) {
+        max_ = ns;
+    }
+}
+
+inline void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for(int i = 0; i < NUM_BUCKETS; i++) {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    if(other.max_ > max_) {
+        max_ = other.max_;
+    }
+}
+
+inline void LatencyHistogram::reset()
+{
+    for(int i = 0; i < NUM_BUCKETS; i++) {
+        counts_[i] = 0;
+    }
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+}
+
+inline uint64_t LatencyHistogram::count() const
+{
+    return count_;
+}
+
+inline uint64_t LatencyHistogram::max() const
+{
+    return max_;
+}
+
+inline double LatencyHistogram::mean() const
+{
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+}
+
+/**
+* Returns the latency (upper bucket bound, capped at the max) below which
+* p percent of the samples fall.
+*/
+inline uint64_t LatencyHistogram::percentile(double p) const
+{
+    if(count_ == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(p / 100.0 * count_ + 0.5);
+    if(target < 1) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for(int i = 0; i < NUM_BUCKETS; i++) {
+        seen += counts_[i];
+        if(seen >= target) {
+            return bucketHigh(i) < max_ ? bucketHigh(i) : max_;
+        }
+    }
+    return max_;
+}
+
+//HELPER: bucketOf
+/*
+    values under 32 map to themselves; otherwise with e = msb - 4 the
+    bucket is 16 * e + (ns >> e), where ns >> e lies in [16, 32)
+*/
+inline int LatencyHistogram::bucketOf(uint64_t ns)
+{
+    if(ns < 2 * SUB_BUCKETS) {
+        return static_cast<int>(ns);
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    int e = msb - 4;
+    return e * SUB_BUCKETS + static_cast<int>(ns >> e);
+}
+
+//HELPER: bucketHigh
+/*
+    largest value that maps to bucket
+*/
+inline uint64_t LatencyHistogram::bucketHigh(int bucket)
+{
+    if(bucket < 2 * SUB_BUCKETS) {
+        return static_cast<uint64_t>(bucket);
+    }
+    int e = bucket / SUB_BUCKETS - 1;
+    uint64_t m = static_cast<uint64_t>(bucket % SUB_BUCKETS + SUB_BUCKETS);
+    return ((m + 1) << e) - 1;
+}
+
+/*
+  -----------------------------------------------
+  Begin implementations for the LatencyRecorder class.
+  -----------------------------------------------
+*/
+
+/**
+* The calling thread's recorder, registered on first use.
+*/
+inline LatencyRecorder& LatencyRecorder::local()
+{
+    static thread_local LatencyRecorder recorder;
+    return recorder;
+}
+
+inline LatencyRecorder::LatencyRecorder()
+{
+    clear();
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().push_back(this);
+}
+
+/**
+* On thread exit the counters are folded into the retired totals.
+*/
+inline LatencyRecorder::~LatencyRecorder()
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::vector<LatencyRecorder*>& recorders = registry();
+    for(size_t i = 0; i < recorders.size(); i++) {
+        if(recorders[i] == this) {
+            recorders.erase(recorders.begin() + i);
+            break;
+        }
+    }
+    addTo(retired());
+}
+
+inline void LatencyRecorder::record(LatencyOp op, uint64_t ns)
+{
+    //single writer per slot, so load + store is enough
+    Slot& slot = slots_[op];
+    std::atomic<uint64_t>& bucket = slot.counts[LatencyHistogram::bucketOf(ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    slot.sum.store(slot.sum.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    if(ns > slot.max.load(std::memory_order_relaxed)) {
+        slot.max.store(ns, std::memory_order_relaxed);
+    }
+}
+
+/**
+* Returns one histogram per LatencyOp, merged over all threads.
+*/
+inline std::vector<LatencyHistogram> LatencyRecorder::collect()
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::vector<LatencyHistogram> hists = retired();
+    std::vector<LatencyRecorder*>& recorders = registry();
+    for(size_t i = 0; i < recorders.size(); i++) {
+        recorders[i]->addTo(hists);
+    }
+    return hists;
+}
+
+/**
+* Zeroes the counters of every thread. Samples recorded concurrently with
+* the reset may survive it.
+*/
+inline void LatencyRecorder::reset()
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::vector<LatencyHistogram>& old = retired();
+    for(size_t i = 0; i < old.size(); i++) {
+        old[i].reset();
+    }
+    std::vector<LatencyRecorder*>& recorders = registry();
+    for(size_t i = 0; i < recorders.size(); i++) {
+        recorders[i]->clear();
+    }
+}
+
+/**
+* Prints count, mean and p50/p99/p999/max (in ns) for every operation that
+* has samples.
+*/
+inline void LatencyRecorder::dump(std::ostream& out)
+{
+    std::vector<LatencyHistogram> hists = collect();
+    out << std::left << std::setw(12) << "op" << std::right << std::setw(12) << "count"
+        << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p99"
+        << std::setw(10) << "p999" << std::setw(12) << "max" << "\n";
+    for(int op = 0; op < LAT_NUM_OPS; op++) {
+        const LatencyHistogram& h = hists[op];
+        if(h.count() == 0) {
+            continue;
+        }
+        out << std::left << std::setw(12) << LATENCY_OP_NAMES[op] << std::right
+            << std::setw(12) << h.count()
+            << std::setw(10) << static_cast<uint64_t>(h.mean())
+            << std::setw(10) << h.percentile(50)
+            << std::setw(10) << h.percentile(99)
+            << std::setw(10) << h.percentile(99.9)
+            << std::setw(12) << h.max() << "\n";
+    }
+}
+
+//HELPER: addTo
+/*
+    adds this thread's counters to hists (one histogram per op)
+*/
+inline void LatencyRecorder::addTo(std::vector<LatencyHistogram>& hists) const
+{
+    for(int op = 0; op < LAT_NUM_OPS; op++) {
+        LatencyHistogram h;
+        for(int b = 0; b < LatencyHistogram::NUM_BUCKETS; b++) {
+            h.counts_[b] = slots_[op].counts[b].load(std::memory_order_relaxed);
+            h.count_ += h.counts_[b];
+        }
+        h.sum_ = slots_[op].sum.load(std::memory_order_relaxed);
+        h.max_ = slots_[op].max.load(std::memory_order_relaxed);
+        hists[op].merge(h);
+    }
+}
+
+inline void LatencyRecorder::clear()
+{
+    for(int op = 0; op < LAT_NUM_OPS; op++) {
+        for(int b = 0; b < LatencyHistogram::NUM_BUCKETS; b++) {
+            slots_[op].counts[b].store(0, std::memory_order_relaxed);
+        }
+        slots_[op].sum.store(0, std::memory_order_relaxed);
+        slots_[op].max.store(0, std::memory_order_relaxed);
+    }
+}
+
+inline std::mutex& LatencyRecorder::registryMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline std::vector<LatencyRecorder*>& LatencyRecorder::registry()
+{
+    static std::vector<LatencyRecorder*> recorders;
+    return recorders;
+}
+
+inline std::vector<LatencyHistogram>& LatencyRecorder::retired()
+{
+    static std::vector<LatencyHistogram> hists(LAT_NUM_OPS);
+    return hists;
+}
+
+#endif
@@ -0,0 +1,397 @@
+#ifndef MAPPEDTREE_H
+#define MAPPEDTREE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <typeinfo>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bst.h"
+#include "snapshot.h"
+
+/**
+* Read-only search tree stored in a single file and opened with mmap.
+*
+* Nodes refer to each other by byte offsets from the start of the file
+* (0 means no child), so the file can be mapped anywhere and used in place:
+* opening it only checks the header and the OS pages nodes in as find,
+* lower_bound and iteration touch them. The writer lays the nodes out in
+* key order as a perfectly balanced tree, which also makes iteration a
+* plain walk over consecutive entries.
+*
+* Keys and values must be trivially copyable. The header records the
+* format version, the key/value sizes and a tag derived from their type
+* names, and opening a file written for other types throws. The type names
+* are those of typeid, which are up to the compiler's ABI, so a file only
+* opens in builds whose compilers name the types alike (e.g. GCC and Clang
+* on the same platform, but not MSVC).
+*
+* Child offsets read from the file are checked before they are followed,
+* so a corrupt file makes find and lower_bound throw std::runtime_error
+* instead of reading outside the mapping.
+*/
+template <typename Key, typename Value>
+class MappedTree
+{
+public:
+    /**
+    * One node as laid out in the file. The key and value are named like
+    * std::pair members so iterators read the same as tree iterators.
+    */
+    struct Entry
+    {
+        Key first;
+        Value second;
+        uint64_t left;
+        uint64_t right;
+    };
+
+    /**
+    * Fixed-size header at offset 0 of every file.
+    */
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t keySize;
+        uint32_t valueSize;
+        uint32_t entrySize;
+        uint64_t typeTag;
+        uint64_t count;
+        uint64_t rootOffset;
+        uint64_t entriesOffset;
+    };
+
+    // Iteration walks the entries in key order.
+    typedef const Entry* iterator;
+
+    explicit MappedTree(const std::string& path);
+    ~MappedTree();
+
+    static void write(const std::string& path, const BinarySearchTree<Key, Value>& tree);
+    template<typename Iter>
+    static void write(const std::string& path, Iter first, Iter last);
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    uint64_t size() const;
+    bool empty() const;
+
+private:
+    MappedTree(const MappedTree&);
+    MappedTree& operator=(const MappedTree&);
+
+    const Entry* entryAt(uint64_t offset, uint64_t lo, uint64_t hi) const;
+    static uint64_t typeTag();
+    template<typename Iter>
+    static void writeRange(std::ostream& out, Iter& it, uint64_t lo, uint64_t hi, uint64_t base);
+    static uint64_t offsetOf(uint64_t lo, uint64_t hi, uint64_t base);
+
+    const char* base_;
+    size_t length_;
+    int fd_;
+    const Header* header_;
+    const Entry* entries_;
+
+    static_assert(std::is_trivially_copyable<Key>::value, "MappedTree keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "MappedTree values must be trivially copyable");
+};
+
+static const char MAPPED_TREE_MAGIC[8] = { 'A', 'V', 'L', 'M', 'A', 'P', '\0', '\0' };
+static const uint32_t MAPPED_TREE_VERSION = 1;
+// Entries start on a cache line boundary after the header.
+static const uint64_t MAPPED_TREE_ALIGN = 64;
+
+/*
+  -----------------------------------------------
+  Begin implementations for the MappedTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Maps the file at path. Only the header is read here; everything else is
+* paged in lazily. Throws std::runtime_error if the file cannot be mapped
+* or does not hold a tree of these key/value types.
+*/
+template<typename Key, typename Value>
+MappedTree<Key, Value>::MappedTree(const std::string& path) :
+    base_(NULL), length_(0), fd_(-1), header_(NULL), entries_(NULL)
+{
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if(fd_ < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat st;
+    if(::fstat(fd_, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd_);
+        throw std::runtime_error("Not a mapped tree: " + path);
+    }
+    length_ = static_cast<size_t>(st.st_size);
+
+    void* addr = ::mmap(NULL, length_, PROT_READ, MAP_SHARED, fd_, 0);
+    if(addr == MAP_FAILED) {
+        ::close(fd_);
+        throw std::runtime_error("Cannot map " + path);
+    }
+    base_ = static_cast<const char*>(addr);
+    header_ = reinterpret_cast<const Header*>(base_);
+
+    const char* error = NULL;
+    if(std::memcmp(header_->magic, MAPPED_TREE_MAGIC, sizeof(MAPPED_TREE_MAGIC)) != 0) {
+        error = "Not a mapped tree: ";
+    }
+    else if(header_->version != MAPPED_TREE_VERSION) {
+        error = "Unsupported mapped tree version: ";
+    }
+    else if(header_->keySize != sizeof(Key) || header_->valueSize != sizeof(Value) ||
+            header_->entrySize != sizeof(Entry) || header_->typeTag != typeTag()) {
+        error = "Mapped tree key/value type mismatch: ";
+    }
+    else if(header_->entriesOffset % MAPPED_TREE_ALIGN != 0 || header_->entriesOffset < sizeof(Header) ||
+            header_->entriesOffset > length_ ||
+            header_->count > (length_ - header_->entriesOffset) / sizeof(Entry)) {
+        error = "Truncated mapped tree: ";
+    }
+    else if(header_->count == 0 ? header_->rootOffset != 0 :
+            (header_->rootOffset < header_->entriesOffset ||
+             (header_->rootOffset - header_->entriesOffset) % sizeof(Entry) != 0 ||
+             (header_->rootOffset - header_->entriesOffset) / sizeof(Entry) >= header_->count)) {
+        error = "Corrupt mapped tree: ";
+    }
+    if(error != NULL) {
+        ::munmap(const_cast<char*>(base_), length_);
+        ::close(fd_);
+        throw std::runtime_error(error + path);
+    }
+    entries_ = reinterpret_cast<const Entry*>(base_ + header_->entriesOffset);
+}
+
+template<typename Key, typename Value>
+MappedTree<Key, Value>::~MappedTree()
+{
+    ::munmap(const_cast<char*>(base_), length_);
+    ::close(fd_);
+}
+
+/**
+* Writes the contents of tree to path in mapped tree format.
+*/
+template<typename Key, typename Value>
+void MappedTree<Key, Value>::write(const std::string& path, const BinarySearchTree<Key, Value>& tree)
+{
+    write(path, tree.begin(), tree.end());
+}
+
+/**
+* Writes the items in [first, last) to path in mapped tree format. The
+* items must already be in strictly increasing key order, e.g. a tree's
+* iterators or a sorted frozen snapshot.
+*/
+template<typename Key, typename Value>
+template<typename Iter>
+void MappedTree<Key, Value>::write(const std::string& path, Iter first, Iter last)
+{
+    uint64_t count = 0;
+    for(Iter it = first; it != last; ++it) {
+        ++count;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAPPED_TREE_MAGIC, sizeof(MAPPED_TREE_MAGIC));
+    header.version = MAPPED_TREE_VERSION;
+    header.keySize = sizeof(Key);
+    header.valueSize = sizeof(Value);
+    header.entrySize = sizeof(Entry);
+    header.typeTag = typeTag();
+    header.count = count;
+    header.entriesOffset = (sizeof(Header) + MAPPED_TREE_ALIGN - 1) / MAPPED_TREE_ALIGN * MAPPED_TREE_ALIGN;
+    header.rootOffset = offsetOf(0, count, header.entriesOffset);
+
+    std::vector<char> buf(SNAPSHOT_BUFFER_SIZE);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(&buf[0], buf.size());
+    out.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+
+    std::vector<char> pad(header.entriesOffset - sizeof(Header), 0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(pad.data(), pad.size());
+
+    Iter it = first;
+    writeRange(out, it, 0, count, header.entriesOffset);
+
+    out.close();
+    if(!out) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+template<typename Key, typename Value>
+typename MappedTree<Key, Value>::iterator MappedTree<Key, Value>::begin() const
+{
+    return entries_;
+}
+
+template<typename Key, typename Value>
+typename MappedTree<Key, Value>::iterator MappedTree<Key, Value>::end() const
+{
+    return entries_ + header_->count;
+}
+
+/**
+* Returns the entry with the given key, or end() if there is none.
+*/
+template<typename Key, typename Value>
+typename MappedTree<Key, Value>::iterator MappedTree<Key, Value>::find(const Key& key) const
+{
+    uint64_t lo = 0;
+    uint64_t hi = header_->count;
+    const Entry* temp = entryAt(header_->rootOffset, lo, hi);
+    while(temp != NULL) {
+        uint64_t index = static_cast<uint64_t>(temp - entries_);
+        if(key < temp->first) {
+            hi = index;
+            temp = entryAt(temp->left, lo, hi);
+        }
+        else if(temp->first < key) {
+            lo = index + 1;
+            temp = entryAt(temp->right, lo, hi);
+        }
+        else {
+            return temp;
+        }
+    }
+    return end();
+}
+
+/**
+* Returns the first entry whose key is not less than key, or end().
+*/
+template<typename Key, typename Value>
+typename MappedTree<Key, Value>::iterator MappedTree<Key, Value>::lower_bound(const Key& key) const
+{
+    const Entry* best = end();
+    uint64_t lo = 0;
+    uint64_t hi = header_->count;
+    const Entry* temp = entryAt(header_->rootOffset, lo, hi);
+    while(temp != NULL) {
+        uint64_t index = static_cast<uint64_t>(temp - entries_);
+        if(temp->first < key) {
+            lo = index + 1;
+            temp = entryAt(temp->right, lo, hi);
+        }
+        else {
+            best = temp;
+            hi = index;
+            temp = entryAt(temp->left, lo, hi);
+        }
+    }
+    return best;
+}
+
+template<typename Key, typename Value>
+uint64_t MappedTree<Key, Value>::size() const
+{
+    return header_->count;
+}
+
+template<typename Key, typename Value>
+bool MappedTree<Key, Value>::empty() const
+{
+    return header_->count == 0;
+}
+
+//HELPER: entryAt
+/*
+    turns a file offset into an entry pointer (0 is the null offset). A
+    descent narrows the entry indexes a child may have to [lo, hi), so an
+    offset outside them or off an entry boundary can only come from a
+    corrupt file; rejecting it keeps reads inside the mapping and makes
+    every descent end within size() steps
+*/
+template<typename Key, typename Value>
+const typename MappedTree<Key, Value>::Entry* MappedTree<Key, Value>::entryAt(uint64_t offset, uint64_t lo, uint64_t hi) const
+{
+    if(offset == 0) {
+        return NULL;
+    }
+    uint64_t rel = offset - header_->entriesOffset;
+    if(offset < header_->entriesOffset || rel % sizeof(Entry) != 0 ||
+       rel / sizeof(Entry) < lo || rel / sizeof(Entry) >= hi) {
+        throw std::runtime_error("Corrupt mapped tree");
+    }
+    return entries_ + rel / sizeof(Entry);
+}
+
+//HELPER: typeTag
+/*
+    FNV-1a hash of the key and value type names, used to catch files opened
+    with the wrong types even when the sizes happen to match
+*/
+template<typename Key, typename Value>
+uint64_t MappedTree<Key, Value>::typeTag()
+{
+    std::string names = std::string(typeid(Key).name()) + "/" + typeid(Value).name();
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < names.size(); i++) {
+        hash ^= static_cast<unsigned char>(names[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//HELPER: offsetOf
+/*
+    file offset of the root of the balanced subtree over entries [lo, hi)
+*/
+template<typename Key, typename Value>
+uint64_t MappedTree<Key, Value>::offsetOf(uint64_t lo, uint64_t hi, uint64_t base)
+{
+    if(lo >= hi) {
+        return 0;
+    }
+    return base + (lo + (hi - lo) / 2) * sizeof(Entry);
+}
+
+//HELPER: writeRange
+/*
+    writes entries [lo, hi) in order, pulling items from it. The middle of
+    each range is the subtree root, so child offsets follow from the ranges
+*/
+template<typename Key, typename Value>
+template<typename Iter>
+void MappedTree<Key, Value>::writeRange(std::ostream& out, Iter& it, uint64_t lo, uint64_t hi, uint64_t base)
+{
+    if(lo >= hi) {
+        return;
+    }
+    uint64_t mid = lo + (hi - lo) / 2;
+    writeRange(out, it, lo, mid, base);
+
+    Entry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.first = it->first;
+    entry.second = it->second;
+    entry.left = offsetOf(lo, mid, base);
+    entry.right = offsetOf(mid + 1, hi, base);
+    out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    ++it;
+
+    writeRange(out, it, mid + 1, hi, base);
+}
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef MULTIAVL_H
+#define MULTIAVL_H
+
+#include <cstddef>
+#include <utility>
+#include "avlbst.h"
+
+// Longest run of equal keys AVLMultiTree::erase(key) unlinks one node at a
+// time; longer runs are cut out of the tree in one piece.
+#define MULTI_ERASE_UNLINK_MAX 16
+
+/**
+* An AVL tree that keeps every inserted item, like std::multimap: items
+* with equal keys are separate nodes, kept next to each other in the order
+* they were inserted (iteration visits them oldest first).
+*
+* insert() always adds a node; a new item goes after every item with an
+* equal key, including when it is inserted through a node handle or by
+* merge(), which here moves every node of the other tree. find(),
+* extract(key) and lower_bound() give the oldest item with a key;
+* equal_range(), count() and erase(key) cover all of them in O(log n + k)
+* for k items with that key, and erase(iterator) removes just one.
+* remove(key) removes them all. operator[] returns one of them, not
+* necessarily the oldest.
+*/
+template <class Key, class Value>
+class AVLMultiTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename AVLTree<Key, Value>::iterator iterator;
+    typedef typename AVLTree<Key, Value>::node_type node_type;
+
+    using AVLTree<Key, Value>::insert;
+    iterator insert(iterator hint, const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key) override;
+    using AVLTree<Key, Value>::erase;
+    size_t erase(const Key& key);
+    virtual void erase(iterator first, iterator last) override;
+    using AVLTree<Key, Value>::extract;
+    node_type extract(const Key& key);
+
+    iterator find(const Key& key) const;
+    size_t count(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+
+protected:
+    virtual AVLNode<Key,Value>* findSlot(const Key& key, AVLNode<Key,Value>*& parent, bool& left, uint64_t& keyPrefix) override;
+
+    static bool isRunStart(AVLNode<Key,Value>* node);
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the AVLMultiTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Inserts new_item using hint as a starting point, as AVLTree does. A key
+* equal to the hint's is not placed at the hint but after the last item
+* with that key, so insertion order is kept.
+*/
+template<class Key, class Value>
+typename AVLMultiTree<Key, Value>::iterator
+AVLMultiTree<Key, Value>::insert(iterator hint, const std::pair<const Key, Value> &new_item)
+{
+    AVLNode<Key,Value>* h = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(hint));
+    if(h != NULL && !(new_item.first < h->getKey()) && !(h->getKey() < new_item.first)){
+        BST_LATENCY_SCOPE(LAT_INSERT);
+        return this->makeIterator(this->internalInsert(new_item));
+    }
+    return AVLTree<Key, Value>::insert(hint, new_item);
+}
+
+/**
+* Removes every item with the given key.
+*/
+template<class Key, class Value>
+void AVLMultiTree<Key, Value>::remove(const Key& key)
+{
+    erase(key);
+}
+
+/**
+* Removes every item with the given key and returns how many there were.
+* A few duplicates are unlinked where they are; a long run is cut out with
+* the split/join range erase, so this is O(log n + k) either way.
+*/
+template<class Key, class Value>
+size_t AVLMultiTree<Key, Value>::erase(const Key& key)
+{
+    AVLNode<Key,Value>* lo = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(this->lower_bound(key)));
+    size_t n = 0;
+    for(AVLNode<Key,Value>* temp = lo; temp != NULL && !(key < temp->getKey()); n++){
+        if(n == MULTI_ERASE_UNLINK_MAX){
+            iterator last = this->upper_bound(key);
+            for(iterator it = this->makeIterator(temp); it != last; ++it){
+                n++;
+            }
+            erase(this->makeIterator(lo), last);
+            return n;
+        }
+        temp = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::successor(temp));
+    }
+
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    for(size_t i = 0; i < n; i++){
+        AVLNode<Key,Value>* next = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::successor(lo));
+        this->detachNode(lo);
+        this->freeNode(lo);
+        lo = next;
+    }
+    return n;
+}
+
+/**
+* Removes the items from first up to, but not including, last. AVLTree
+* cuts the range out by key, which is only exact where a run of equal
+* keys starts, so items at either end that share a key with an item
+* outside the range are unlinked one at a time first.
+*/
+template<class Key, class Value>
+void AVLMultiTree<Key, Value>::erase(iterator first, iterator last)
+{
+    AVLNode<Key,Value>* lo = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(first));
+    AVLNode<Key,Value>* hi = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(last));
+
+    //front: later duplicates of a key that is kept
+    while(lo != NULL && lo != hi && !isRunStart(lo)){
+        AVLNode<Key,Value>* next = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::successor(lo));
+        this->detachNode(lo);
+        this->freeNode(lo);
+        lo = next;
+    }
+
+    //back: earlier duplicates of last's key (lo comes before last, so
+    //last always has a predecessor here)
+    while(hi != NULL && lo != hi){
+        AVLNode<Key,Value>* temp = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::predecessor(hi));
+        if(temp->getKey() < hi->getKey()){
+            break;
+        }
+        if(temp == lo){
+            lo = hi;
+        }
+        this->detachNode(temp);
+        this->freeNode(temp);
+    }
+
+    if(lo != hi){
+        AVLTree<Key, Value>::erase(this->makeIterator(lo), this->makeIterator(hi));
+    }
+}
+
+/**
+* Unlinks the oldest item with the given key and returns its node in a
+* handle (an empty one if the key is missing).
+*/
+template<class Key, class Value>
+typename AVLMultiTree<Key, Value>::node_type AVLMultiTree<Key, Value>::extract(const Key& key)
+{
+    iterator it = find(key);
+    if(it == this->end()){
+        return node_type();
+    }
+    return AVLTree<Key, Value>::extract(it);
+}
+
+/**
+* Returns an iterator to the oldest item with the given key, or the end
+* iterator if there is none.
+*/
+template<class Key, class Value>
+typename AVLMultiTree<Key, Value>::iterator AVLMultiTree<Key, Value>::find(const Key& key) const
+{
+    iterator it = this->lower_bound(key);
+    if(it != this->end() && !(key < it->first)){
+        return it;
+    }
+    return this->end();
+}
+
+/**
+* Returns the number of items with the given key.
+*/
+template<class Key, class Value>
+size_t AVLMultiTree<Key, Value>::count(const Key& key) const
+{
+    size_t n = 0;
+    for(iterator it = this->lower_bound(key); it != this->end() && !(key < it->first); ++it){
+        n++;
+    }
+    return n;
+}
+
+/**
+* Returns the range of items with the given key, oldest first; both ends
+* are upper_bound(key) if there are none. One descent, then a walk over
+* the k matches: O(log n + k).
+*/
+template<class Key, class Value>
+std::pair<typename AVLMultiTree<Key, Value>::iterator, typename AVLMultiTree<Key, Value>::iterator>
+AVLMultiTree<Key, Value>::equal_range(const Key& key) const
+{
+    iterator first = this->lower_bound(key);
+    iterator last = first;
+    while(last != this->end() && !(key < last->first)){
+        ++last;
+    }
+    return std::make_pair(first, last);
+}
+
+//HELPER: findSlot
+/*
+    like AVLTree's, but never stops at an equal key: equal keys go right,
+    so key lands after all of its duplicates. Always returns NULL
+*/
+template<class Key, class Value>
+AVLNode<Key,Value>* AVLMultiTree<Key, Value>::findSlot(const Key& key, AVLNode<Key,Value>*& parent, bool& left, uint64_t& keyPrefix)
+{
+    AVLNode<Key, Value>* temp = static_cast<AVLNode<Key, Value>*>(this->root_);
+    parent = NULL;
+    left = false;
+    if(temp == NULL){
+        keyPrefix = KeyPrefixCursor<Key>::packBetween(key, NULL, NULL);
+        return NULL;
+    }
+
+    KeyPrefixCursor<Key> cursor(key);
+
+    //append fast path: a key equal to the maximum goes last too
+    BST_STAT(comparisons, 1);
+    int order = cursor.order(this->rightmost_);
+    if(order > 0 || (order == 0 && !(key < this->rightmost_->getKey()))){
+        parent = this->rightmost_;
+        keyPrefix = cursor.pack();
+        return NULL;
+    }
+
+    while(temp != NULL){
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        order = cursor.order(temp);
+        parent = temp;
+        if(order < 0 || (order == 0 && (BST_STAT(comparisons, 1), key < temp->getKey()))){
+            left = true;
+            temp = temp->getLeft();
+        }
+        else{
+            left = false;
+            temp = temp->getRight();
+        }
+    }
+    keyPrefix = cursor.pack();
+    return NULL;
+}
+
+//HELPER: isRunStart
+/*
+    whether node holds the oldest item with its key
+*/
+template<class Key, class Value>
+bool AVLMultiTree<Key, Value>::isRunStart(AVLNode<Key,Value>* node)
+{
+    Node<Key, Value>* pred = BinarySearchTree<Key, Value>::predecessor(node);
+    return pred == NULL || pred->getKey() < node->getKey();
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AVLMultiTree class.
+  -----------------------------------------------
+*/
+
+#endif
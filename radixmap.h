@@ -0,0 +1,1166 @@
+#ifndef RADIXMAP_H
+#define RADIXMAP_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <type_traits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "bst.h"
+
+// Deepest path through an OrderedRadixMap: one inner node per key byte,
+// plus the leaf.
+#define RADIX_MAX_DEPTH 9
+
+/**
+* Common header of every OrderedRadixMap node; type_ tells which of the
+* node layouts below it is.
+*/
+struct RadixNode
+{
+    enum Type { LEAF, NODE4, NODE16, NODE48, NODE256 };
+
+    explicit RadixNode(uint8_t type) : type_(type) {}
+
+    uint8_t type_;
+};
+
+/**
+* Header of the inner nodes. prefix_ holds the bytes every key below the
+* node shares after the bytes consumed by its ancestors (path
+* compression); since keys are at most 8 bytes the whole prefix is always
+* stored, so descents never need to check it again at the leaf.
+*/
+struct RadixInnerNode : public RadixNode
+{
+    explicit RadixInnerNode(uint8_t type) : RadixNode(type), count_(0), prefixLen_(0)
+    {
+        std::memset(prefix_, 0, sizeof(prefix_));
+    }
+
+    uint16_t count_;
+    uint8_t prefixLen_;
+    uint8_t prefix_[8];
+};
+
+/**
+* Up to 4 children, with their key bytes kept sorted.
+*/
+struct RadixNode4 : public RadixInnerNode
+{
+    RadixNode4() : RadixInnerNode(NODE4)
+    {
+        std::memset(keys_, 0, sizeof(keys_));
+        std::memset(children_, 0, sizeof(children_));
+    }
+
+    uint8_t keys_[4];
+    RadixNode* children_[4];
+};
+
+/**
+* Up to 16 children, with their key bytes kept sorted in one 16-byte
+* vector so a single SSE2 compare finds a byte.
+*/
+struct RadixNode16 : public RadixInnerNode
+{
+    RadixNode16() : RadixInnerNode(NODE16)
+    {
+        std::memset(keys_, 0, sizeof(keys_));
+        std::memset(children_, 0, sizeof(children_));
+    }
+
+    uint8_t keys_[16];
+    RadixNode* children_[16];
+};
+
+/**
+* Up to 48 children: index_[byte] is the child's slot plus one (0 for no
+* child).
+*/
+struct RadixNode48 : public RadixInnerNode
+{
+    RadixNode48() : RadixInnerNode(NODE48)
+    {
+        std::memset(index_, 0, sizeof(index_));
+        std::memset(children_, 0, sizeof(children_));
+    }
+
+    uint8_t index_[256];
+    RadixNode* children_[48];
+};
+
+/**
+* One child pointer for every byte value.
+*/
+struct RadixNode256 : public RadixInnerNode
+{
+    RadixNode256() : RadixInnerNode(NODE256)
+    {
+        std::memset(children_, 0, sizeof(children_));
+    }
+
+    RadixNode* children_[256];
+};
+
+/**
+* A leaf holds one item.
+*/
+template <typename Key, typename Value>
+class RadixLeaf : public RadixNode
+{
+public:
+    RadixLeaf(const Key& key, const Value& value);
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+    Value& getValue();
+    void setValue(const Value& value);
+
+protected:
+    std::pair<const Key, Value> item_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RadixLeaf class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+RadixLeaf<Key, Value>::RadixLeaf(const Key& key, const Value& value) :
+    RadixNode(LEAF), item_(key, value)
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& RadixLeaf<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& RadixLeaf<Key, Value>::getItem()
+{
+    return item_;
+}
+
+template<class Key, class Value>
+const Key& RadixLeaf<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<class Key, class Value>
+Value& RadixLeaf<Key, Value>::getValue()
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+void RadixLeaf<Key, Value>::setValue(const Value& value)
+{
+    item_.second = value;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RadixLeaf class.
+  -----------------------------------------------
+*/
+
+/**
+* An ordered adaptive radix tree (ART) for integer keys, with the same
+* insert/remove/find/iterator/operator[] interface as BinarySearchTree plus
+* lower_bound.
+*
+* Keys are split into bytes, most significant first (signed keys have
+* their sign bit flipped so the byte order is the numeric order), and each
+* inner node branches on one byte. Lookups therefore take at most
+* sizeof(Key) steps whatever the number of items, and compare single bytes
+* instead of keys. Inner nodes come in four sizes (4, 16, 48 and 256
+* children) and grow or shrink as children come and go, so sparse levels
+* stay small. Chains of single-child nodes are collapsed into a prefix
+* stored in the node below (path compression), and a subtree holding a
+* single key is just its leaf (lazy expansion).
+*
+* Iterators carry the path from the root to their leaf, as in
+* CompactAVLTree.
+*/
+template <typename Key, typename Value>
+class OrderedRadixMap
+{
+    static_assert(std::is_integral<Key>::value, "OrderedRadixMap needs an integral key type");
+
+public:
+    OrderedRadixMap();
+    ~OrderedRadixMap();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    TreeStats stats() const;
+    void resetStats();
+
+    /**
+    * In-order iterator. The stack holds every inner node on the path to
+    * the current leaf, with the position of the child taken at each.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class OrderedRadixMap<Key, Value>;
+        void descendMin(RadixNode* node);
+        void advance();
+        void push(RadixInnerNode* node, int pos);
+
+        RadixInnerNode* nodes_[RADIX_MAX_DEPTH];
+        int positions_[RADIX_MAX_DEPTH];
+        int depth_;
+        RadixLeaf<Key, Value>* leaf_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    typedef typename std::make_unsigned<Key>::type Bits;
+
+    static Bits toBits(const Key& key);
+    static uint8_t byteAt(Bits bits, size_t i);
+
+    RadixLeaf<Key, Value>* internalFind(const Key& key) const;
+
+    //child slots, addressed by position: an index for Node4/16, the key
+    //byte for Node48/256
+    static int findPos(const RadixInnerNode* node, uint8_t byte);
+    static int lowerPos(const RadixInnerNode* node, uint8_t byte);
+    static int nextPos(const RadixInnerNode* node, int pos);
+    static uint8_t posByte(const RadixInnerNode* node, int pos);
+    static RadixNode** childAt(RadixInnerNode* node, int pos);
+
+    void addChild(RadixNode** ref, uint8_t byte, RadixNode* child);
+    void removeChild(RadixNode** ref, uint8_t byte);
+    void clearNode(RadixNode* node);
+
+    RadixNode* root_;
+    size_t size_;
+#ifdef BST_STATS
+    mutable TreeStats stats_;
+#endif
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the OrderedRadixMap::iterator class.
+---------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+OrderedRadixMap<Key, Value>::iterator::iterator() :
+    depth_(0), leaf_(NULL)
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>& OrderedRadixMap<Key, Value>::iterator::operator*() const
+{
+    return leaf_->getItem();
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>* OrderedRadixMap<Key, Value>::iterator::operator->() const
+{
+    return &(leaf_->getItem());
+}
+
+template<class Key, class Value>
+bool OrderedRadixMap<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_;
+}
+
+template<class Key, class Value>
+bool OrderedRadixMap<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return leaf_ != rhs.leaf_;
+}
+
+template<class Key, class Value>
+typename OrderedRadixMap<Key, Value>::iterator&
+OrderedRadixMap<Key, Value>::iterator::operator++()
+{
+    BST_LATENCY_SCOPE(LAT_ITERATE);
+    advance();
+    return *this;
+}
+
+/**
+* Walks down the smallest children from node to its first leaf.
+*/
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::iterator::descendMin(RadixNode* node)
+{
+    while(node->type_ != RadixNode::LEAF) {
+        RadixInnerNode* inner = static_cast<RadixInnerNode*>(node);
+        int pos = nextPos(inner, -1);
+        push(inner, pos);
+        node = *childAt(inner, pos);
+    }
+    leaf_ = static_cast<RadixLeaf<Key, Value>*>(node);
+}
+
+/**
+* Moves past the subtree below the deepest pending child: to the first
+* leaf of the next sibling on the way up, or to end().
+*/
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::iterator::advance()
+{
+    while(depth_ > 0) {
+        RadixInnerNode* inner = nodes_[depth_ - 1];
+        int pos = nextPos(inner, positions_[depth_ - 1]);
+        if(pos >= 0) {
+            positions_[depth_ - 1] = pos;
+            descendMin(*childAt(inner, pos));
+            return;
+        }
+        depth_--;
+    }
+    leaf_ = NULL;
+}
+
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::iterator::push(RadixInnerNode* node, int pos)
+{
+    nodes_[depth_] = node;
+    positions_[depth_] = pos;
+    depth_++;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the OrderedRadixMap::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the OrderedRadixMap class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value>
+OrderedRadixMap<Key, Value>::OrderedRadixMap() :
+    root_(NULL), size_(0)
+{
+
+}
+
+template<class Key, class Value>
+OrderedRadixMap<Key, Value>::~OrderedRadixMap()
+{
+    clear();
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is already present.
+*/
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    BST_LATENCY_SCOPE(LAT_INSERT);
+    Bits bits = toBits(keyValuePair.first);
+    RadixNode** ref = &root_;
+    size_t depth = 0;
+
+    while(true) {
+        RadixNode* node = *ref;
+        //empty tree
+        if(node == NULL) {
+            BST_STAT(allocations, 1);
+            *ref = new RadixLeaf<Key, Value>(keyValuePair.first, keyValuePair.second);
+            size_++;
+            return;
+        }
+        BST_STAT(nodeVisits, 1);
+
+        //leaf: overwrite, or split it into a Node4 on the first differing byte
+        if(node->type_ == RadixNode::LEAF) {
+            RadixLeaf<Key, Value>* leaf = static_cast<RadixLeaf<Key, Value>*>(node);
+            BST_STAT(comparisons, 1);
+            if(leaf->getKey() == keyValuePair.first) {
+                leaf->setValue(keyValuePair.second);
+                return;
+            }
+            Bits other = toBits(leaf->getKey());
+            size_t diff = depth;
+            while(byteAt(bits, diff) == byteAt(other, diff)) {
+                diff++;
+            }
+            BST_STAT(allocations, 2);
+            RadixNode4* split = new RadixNode4;
+            split->prefixLen_ = static_cast<uint8_t>(diff - depth);
+            for(size_t i = depth; i < diff; i++) {
+                split->prefix_[i - depth] = byteAt(bits, i);
+            }
+            *ref = split;
+            addChild(ref, byteAt(other, diff), leaf);
+            addChild(ref, byteAt(bits, diff), new RadixLeaf<Key, Value>(keyValuePair.first, keyValuePair.second));
+            size_++;
+            return;
+        }
+
+        //inner node whose prefix the key leaves: split the prefix
+        RadixInnerNode* inner = static_cast<RadixInnerNode*>(node);
+        size_t p = 0;
+        while(p < inner->prefixLen_ && inner->prefix_[p] == byteAt(bits, depth + p)) {
+            p++;
+        }
+        if(p < inner->prefixLen_) {
+            BST_STAT(allocations, 2);
+            RadixNode4* split = new RadixNode4;
+            split->prefixLen_ = static_cast<uint8_t>(p);
+            std::memcpy(split->prefix_, inner->prefix_, p);
+            uint8_t innerByte = inner->prefix_[p];
+            inner->prefixLen_ = static_cast<uint8_t>(inner->prefixLen_ - (p + 1));
+            std::memmove(inner->prefix_, inner->prefix_ + p + 1, inner->prefixLen_);
+            *ref = split;
+            addChild(ref, innerByte, inner);
+            addChild(ref, byteAt(bits, depth + p), new RadixLeaf<Key, Value>(keyValuePair.first, keyValuePair.second));
+            size_++;
+            return;
+        }
+        depth += inner->prefixLen_;
+
+        uint8_t byte = byteAt(bits, depth);
+        int pos = findPos(inner, byte);
+        if(pos < 0) {
+            BST_STAT(allocations, 1);
+            addChild(ref, byte, new RadixLeaf<Key, Value>(keyValuePair.first, keyValuePair.second));
+            size_++;
+            return;
+        }
+        ref = childAt(inner, pos);
+        depth++;
+    }
+}
+
+/**
+* Removes the key if present; a node left with too few children shrinks
+* to the next smaller size, and a Node4 left with one child is merged
+* into it.
+*/
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::remove(const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    Bits bits = toBits(key);
+    RadixNode** ref = &root_;
+    RadixNode** parentRef = NULL;
+    uint8_t branch = 0;
+    size_t depth = 0;
+
+    while(*ref != NULL) {
+        BST_STAT(nodeVisits, 1);
+        RadixNode* node = *ref;
+        if(node->type_ == RadixNode::LEAF) {
+            RadixLeaf<Key, Value>* leaf = static_cast<RadixLeaf<Key, Value>*>(node);
+            BST_STAT(comparisons, 1);
+            if(!(leaf->getKey() == key)) {
+                return;
+            }
+            if(parentRef == NULL) {
+                root_ = NULL;
+            }
+            else {
+                removeChild(parentRef, branch);
+            }
+            BST_STAT(frees, 1);
+            delete leaf;
+            size_--;
+            return;
+        }
+
+        RadixInnerNode* inner = static_cast<RadixInnerNode*>(node);
+        for(size_t i = 0; i < inner->prefixLen_; i++) {
+            if(inner->prefix_[i] != byteAt(bits, depth + i)) {
+                return;
+            }
+        }
+        depth += inner->prefixLen_;
+        uint8_t byte = byteAt(bits, depth);
+        int pos = findPos(inner, byte);
+        if(pos < 0) {
+            return;
+        }
+        parentRef = ref;
+        branch = byte;
+        ref = childAt(inner, pos);
+        depth++;
+    }
+}
+
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::clear()
+{
+    BST_LATENCY_SCOPE(LAT_CLEAR);
+    if(root_ != NULL) {
+        clearNode(root_);
+        root_ = NULL;
+    }
+    size_ = 0;
+}
+
+template<class Key, class Value>
+bool OrderedRadixMap<Key, Value>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<class Key, class Value>
+size_t OrderedRadixMap<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+TreeStats OrderedRadixMap<Key, Value>::stats() const
+{
+#ifdef BST_STATS
+    return stats_;
+#else
+    return TreeStats();
+#endif
+}
+
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::resetStats()
+{
+#ifdef BST_STATS
+    stats_ = TreeStats();
+#endif
+}
+
+template<class Key, class Value>
+typename OrderedRadixMap<Key, Value>::iterator OrderedRadixMap<Key, Value>::begin() const
+{
+    iterator it;
+    if(root_ != NULL) {
+        it.descendMin(root_);
+    }
+    return it;
+}
+
+template<class Key, class Value>
+typename OrderedRadixMap<Key, Value>::iterator OrderedRadixMap<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns an iterator to key, or end(). The path is recorded during the
+* descent so the iterator can continue from there.
+*/
+template<class Key, class Value>
+typename OrderedRadixMap<Key, Value>::iterator OrderedRadixMap<Key, Value>::find(const Key& key) const
+{
+    BST_LATENCY_SCOPE(LAT_FIND);
+    Bits bits = toBits(key);
+    iterator it;
+    RadixNode* node = root_;
+    size_t depth = 0;
+
+    while(node != NULL) {
+        BST_STAT(nodeVisits, 1);
+        if(node->type_ == RadixNode::LEAF) {
+            RadixLeaf<Key, Value>* leaf = static_cast<RadixLeaf<Key, Value>*>(node);
+            BST_STAT(comparisons, 1);
+            if(leaf->getKey() == key) {
+                it.leaf_ = leaf;
+                return it;
+            }
+            return end();
+        }
+        RadixInnerNode* inner = static_cast<RadixInnerNode*>(node);
+        for(size_t i = 0; i < inner->prefixLen_; i++) {
+            if(inner->prefix_[i] != byteAt(bits, depth + i)) {
+                return end();
+            }
+        }
+        depth += inner->prefixLen_;
+        int pos = findPos(inner, byteAt(bits, depth));
+        if(pos < 0) {
+            return end();
+        }
+        it.push(inner, pos);
+        node = *childAt(inner, pos);
+        depth++;
+    }
+    return end();
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end().
+*/
+template<class Key, class Value>
+typename OrderedRadixMap<Key, Value>::iterator OrderedRadixMap<Key, Value>::lower_bound(const Key& key) const
+{
+    BST_LATENCY_SCOPE(LAT_FIND);
+    Bits bits = toBits(key);
+    iterator it;
+    RadixNode* node = root_;
+    size_t depth = 0;
+    if(node == NULL) {
+        return it;
+    }
+
+    while(true) {
+        BST_STAT(nodeVisits, 1);
+        if(node->type_ == RadixNode::LEAF) {
+            RadixLeaf<Key, Value>* leaf = static_cast<RadixLeaf<Key, Value>*>(node);
+            BST_STAT(comparisons, 1);
+            if(leaf->getKey() < key) {
+                it.advance();
+            }
+            else {
+                it.leaf_ = leaf;
+            }
+            return it;
+        }
+        //a prefix that differs puts the whole subtree on one side of key
+        RadixInnerNode* inner = static_cast<RadixInnerNode*>(node);
+        for(size_t i = 0; i < inner->prefixLen_; i++) {
+            uint8_t byte = byteAt(bits, depth + i);
+            if(inner->prefix_[i] > byte) {
+                it.descendMin(inner);
+                return it;
+            }
+            if(inner->prefix_[i] < byte) {
+                it.advance();
+                return it;
+            }
+        }
+        depth += inner->prefixLen_;
+
+        uint8_t byte = byteAt(bits, depth);
+        int pos = lowerPos(inner, byte);
+        if(pos < 0) {
+            it.advance();
+            return it;
+        }
+        it.push(inner, pos);
+        node = *childAt(inner, pos);
+        if(posByte(inner, pos) > byte) {
+            it.descendMin(node);
+            return it;
+        }
+        depth++;
+    }
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<class Key, class Value>
+Value& OrderedRadixMap<Key, Value>::operator[](const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_SUBSCRIPT);
+    RadixLeaf<Key, Value>* curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+template<class Key, class Value>
+Value const & OrderedRadixMap<Key, Value>::operator[](const Key& key) const
+{
+    BST_LATENCY_SCOPE(LAT_SUBSCRIPT);
+    RadixLeaf<Key, Value>* curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+//HELPER: toBits
+/*
+    the key as an unsigned integer with the same order (the sign bit of a
+    signed key flipped)
+*/
+template<class Key, class Value>
+typename OrderedRadixMap<Key, Value>::Bits OrderedRadixMap<Key, Value>::toBits(const Key& key)
+{
+    Bits bits = static_cast<Bits>(key);
+    if(std::is_signed<Key>::value) {
+        bits ^= static_cast<Bits>(static_cast<Bits>(1) << (8 * sizeof(Key) - 1));
+    }
+    return bits;
+}
+
+//HELPER: byteAt
+/*
+    byte i of the key, counting from the most significant
+*/
+template<class Key, class Value>
+uint8_t OrderedRadixMap<Key, Value>::byteAt(Bits bits, size_t i)
+{
+    return static_cast<uint8_t>(bits >> (8 * (sizeof(Key) - 1 - i)));
+}
+
+//HELPER: internalFind
+template<class Key, class Value>
+RadixLeaf<Key, Value>* OrderedRadixMap<Key, Value>::internalFind(const Key& key) const
+{
+    Bits bits = toBits(key);
+    RadixNode* node = root_;
+    size_t depth = 0;
+    while(node != NULL) {
+        BST_STAT(nodeVisits, 1);
+        if(node->type_ == RadixNode::LEAF) {
+            RadixLeaf<Key, Value>* leaf = static_cast<RadixLeaf<Key, Value>*>(node);
+            BST_STAT(comparisons, 1);
+            return leaf->getKey() == key ? leaf : NULL;
+        }
+        RadixInnerNode* inner = static_cast<RadixInnerNode*>(node);
+        for(size_t i = 0; i < inner->prefixLen_; i++) {
+            if(inner->prefix_[i] != byteAt(bits, depth + i)) {
+                return NULL;
+            }
+        }
+        depth += inner->prefixLen_;
+        int pos = findPos(inner, byteAt(bits, depth));
+        if(pos < 0) {
+            return NULL;
+        }
+        node = *childAt(inner, pos);
+        depth++;
+    }
+    return NULL;
+}
+
+//HELPER: findPos
+/*
+    position of the child for byte, or -1. Node16 compares all 16 key
+    bytes at once with SSE2 where available
+*/
+template<class Key, class Value>
+int OrderedRadixMap<Key, Value>::findPos(const RadixInnerNode* node, uint8_t byte)
+{
+    switch(node->type_) {
+    case RadixNode::NODE4: {
+        const RadixNode4* n = static_cast<const RadixNode4*>(node);
+        for(int i = 0; i < n->count_; i++) {
+            if(n->keys_[i] == byte) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    case RadixNode::NODE16: {
+        const RadixNode16* n = static_cast<const RadixNode16*>(node);
+#ifdef __SSE2__
+        __m128i match = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(byte)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(n->keys_)));
+        int mask = _mm_movemask_epi8(match) & ((1 << n->count_) - 1);
+        return mask != 0 ? __builtin_ctz(mask) : -1;
+#else
+        for(int i = 0; i < n->count_; i++) {
+            if(n->keys_[i] == byte) {
+                return i;
+            }
+        }
+        return -1;
+#endif
+    }
+    case RadixNode::NODE48: {
+        const RadixNode48* n = static_cast<const RadixNode48*>(node);
+        return n->index_[byte] != 0 ? byte : -1;
+    }
+    default: {
+        const RadixNode256* n = static_cast<const RadixNode256*>(node);
+        return n->children_[byte] != NULL ? byte : -1;
+    }
+    }
+}
+
+//HELPER: lowerPos
+/*
+    position of the first child whose byte is >= byte, or -1
+*/
+template<class Key, class Value>
+int OrderedRadixMap<Key, Value>::lowerPos(const RadixInnerNode* node, uint8_t byte)
+{
+    switch(node->type_) {
+    case RadixNode::NODE4: {
+        const RadixNode4* n = static_cast<const RadixNode4*>(node);
+        for(int i = 0; i < n->count_; i++) {
+            if(n->keys_[i] >= byte) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    case RadixNode::NODE16: {
+        const RadixNode16* n = static_cast<const RadixNode16*>(node);
+#ifdef __SSE2__
+        //SSE2 only compares signed bytes: flip the top bits first
+        __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+        __m128i keys = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(n->keys_)), bias);
+        __m128i less = _mm_cmplt_epi8(keys, _mm_xor_si128(_mm_set1_epi8(static_cast<char>(byte)), bias));
+        int mask = ~_mm_movemask_epi8(less) & ((1 << n->count_) - 1);
+        return mask != 0 ? __builtin_ctz(mask) : -1;
+#else
+        for(int i = 0; i < n->count_; i++) {
+            if(n->keys_[i] >= byte) {
+                return i;
+            }
+        }
+        return -1;
+#endif
+    }
+    default:
+        return nextPos(node, static_cast<int>(byte) - 1);
+    }
+}
+
+//HELPER: nextPos
+/*
+    position of the first child after pos (-1 for the first child), or -1
+*/
+template<class Key, class Value>
+int OrderedRadixMap<Key, Value>::nextPos(const RadixInnerNode* node, int pos)
+{
+    switch(node->type_) {
+    case RadixNode::NODE4:
+    case RadixNode::NODE16:
+        return pos + 1 < node->count_ ? pos + 1 : -1;
+    case RadixNode::NODE48: {
+        const RadixNode48* n = static_cast<const RadixNode48*>(node);
+        for(int b = pos + 1; b < 256; b++) {
+            if(n->index_[b] != 0) {
+                return b;
+            }
+        }
+        return -1;
+    }
+    default: {
+        const RadixNode256* n = static_cast<const RadixNode256*>(node);
+        for(int b = pos + 1; b < 256; b++) {
+            if(n->children_[b] != NULL) {
+                return b;
+            }
+        }
+        return -1;
+    }
+    }
+}
+
+//HELPER: posByte
+template<class Key, class Value>
+uint8_t OrderedRadixMap<Key, Value>::posByte(const RadixInnerNode* node, int pos)
+{
+    switch(node->type_) {
+    case RadixNode::NODE4:
+        return static_cast<const RadixNode4*>(node)->keys_[pos];
+    case RadixNode::NODE16:
+        return static_cast<const RadixNode16*>(node)->keys_[pos];
+    default:
+        return static_cast<uint8_t>(pos);
+    }
+}
+
+//HELPER: childAt
+template<class Key, class Value>
+RadixNode** OrderedRadixMap<Key, Value>::childAt(RadixInnerNode* node, int pos)
+{
+    switch(node->type_) {
+    case RadixNode::NODE4:
+        return &static_cast<RadixNode4*>(node)->children_[pos];
+    case RadixNode::NODE16:
+        return &static_cast<RadixNode16*>(node)->children_[pos];
+    case RadixNode::NODE48: {
+        RadixNode48* n = static_cast<RadixNode48*>(node);
+        return &n->children_[n->index_[pos] - 1];
+    }
+    default:
+        return &static_cast<RadixNode256*>(node)->children_[pos];
+    }
+}
+
+//HELPER: addChild
+/*
+    adds child under byte to the inner node *ref, first replacing the node
+    with the next larger size if it is full
+*/
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::addChild(RadixNode** ref, uint8_t byte, RadixNode* child)
+{
+    RadixInnerNode* node = static_cast<RadixInnerNode*>(*ref);
+    switch(node->type_) {
+    case RadixNode::NODE4: {
+        RadixNode4* n = static_cast<RadixNode4*>(node);
+        if(n->count_ < 4) {
+            int i = 0;
+            while(i < n->count_ && n->keys_[i] < byte) {
+                i++;
+            }
+            std::memmove(n->keys_ + i + 1, n->keys_ + i, n->count_ - i);
+            std::memmove(n->children_ + i + 1, n->children_ + i, (n->count_ - i) * sizeof(RadixNode*));
+            n->keys_[i] = byte;
+            n->children_[i] = child;
+            n->count_++;
+            return;
+        }
+        //grow to a Node16
+        BST_STAT(allocations, 1);
+        BST_STAT(frees, 1);
+        RadixNode16* grown = new RadixNode16;
+        grown->count_ = n->count_;
+        grown->prefixLen_ = n->prefixLen_;
+        std::memcpy(grown->prefix_, n->prefix_, sizeof(n->prefix_));
+        std::memcpy(grown->keys_, n->keys_, sizeof(n->keys_));
+        std::memcpy(grown->children_, n->children_, sizeof(n->children_));
+        *ref = grown;
+        delete n;
+        addChild(ref, byte, child);
+        return;
+    }
+    case RadixNode::NODE16: {
+        RadixNode16* n = static_cast<RadixNode16*>(node);
+        if(n->count_ < 16) {
+            int i = 0;
+            while(i < n->count_ && n->keys_[i] < byte) {
+                i++;
+            }
+            std::memmove(n->keys_ + i + 1, n->keys_ + i, n->count_ - i);
+            std::memmove(n->children_ + i + 1, n->children_ + i, (n->count_ - i) * sizeof(RadixNode*));
+            n->keys_[i] = byte;
+            n->children_[i] = child;
+            n->count_++;
+            return;
+        }
+        //grow to a Node48
+        BST_STAT(allocations, 1);
+        BST_STAT(frees, 1);
+        RadixNode48* grown = new RadixNode48;
+        grown->count_ = n->count_;
+        grown->prefixLen_ = n->prefixLen_;
+        std::memcpy(grown->prefix_, n->prefix_, sizeof(n->prefix_));
+        for(int i = 0; i < n->count_; i++) {
+            grown->children_[i] = n->children_[i];
+            grown->index_[n->keys_[i]] = static_cast<uint8_t>(i + 1);
+        }
+        *ref = grown;
+        delete n;
+        addChild(ref, byte, child);
+        return;
+    }
+    case RadixNode::NODE48: {
+        RadixNode48* n = static_cast<RadixNode48*>(node);
+        if(n->count_ < 48) {
+            int slot = 0;
+            while(n->children_[slot] != NULL) {
+                slot++;
+            }
+            n->children_[slot] = child;
+            n->index_[byte] = static_cast<uint8_t>(slot + 1);
+            n->count_++;
+            return;
+        }
+        //grow to a Node256
+        BST_STAT(allocations, 1);
+        BST_STAT(frees, 1);
+        RadixNode256* grown = new RadixNode256;
+        grown->count_ = n->count_;
+        grown->prefixLen_ = n->prefixLen_;
+        std::memcpy(grown->prefix_, n->prefix_, sizeof(n->prefix_));
+        for(int b = 0; b < 256; b++) {
+            if(n->index_[b] != 0) {
+                grown->children_[b] = n->children_[n->index_[b] - 1];
+            }
+        }
+        *ref = grown;
+        delete n;
+        addChild(ref, byte, child);
+        return;
+    }
+    default: {
+        RadixNode256* n = static_cast<RadixNode256*>(node);
+        n->children_[byte] = child;
+        n->count_++;
+        return;
+    }
+    }
+}
+
+//HELPER: removeChild
+/*
+    removes the child under byte from the inner node *ref, then shrinks the
+    node once it drops well below its size (so a node at a boundary doesn't
+    flip back and forth), or replaces a Node4 left with one child by that
+    child, moving the Node4's prefix and byte in front of the child's
+*/
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::removeChild(RadixNode** ref, uint8_t byte)
+{
+    RadixInnerNode* node = static_cast<RadixInnerNode*>(*ref);
+    switch(node->type_) {
+    case RadixNode::NODE4: {
+        RadixNode4* n = static_cast<RadixNode4*>(node);
+        int i = findPos(n, byte);
+        std::memmove(n->keys_ + i, n->keys_ + i + 1, n->count_ - i - 1);
+        std::memmove(n->children_ + i, n->children_ + i + 1, (n->count_ - i - 1) * sizeof(RadixNode*));
+        n->count_--;
+        if(n->count_ == 1) {
+            RadixNode* only = n->children_[0];
+            if(only->type_ != RadixNode::LEAF) {
+                RadixInnerNode* below = static_cast<RadixInnerNode*>(only);
+                uint8_t prefix[8];
+                size_t len = n->prefixLen_;
+                std::memcpy(prefix, n->prefix_, len);
+                prefix[len++] = n->keys_[0];
+                std::memcpy(prefix + len, below->prefix_, below->prefixLen_);
+                len += below->prefixLen_;
+                std::memcpy(below->prefix_, prefix, len);
+                below->prefixLen_ = static_cast<uint8_t>(len);
+            }
+            *ref = only;
+            BST_STAT(frees, 1);
+            delete n;
+        }
+        return;
+    }
+    case RadixNode::NODE16: {
+        RadixNode16* n = static_cast<RadixNode16*>(node);
+        int i = findPos(n, byte);
+        std::memmove(n->keys_ + i, n->keys_ + i + 1, n->count_ - i - 1);
+        std::memmove(n->children_ + i, n->children_ + i + 1, (n->count_ - i - 1) * sizeof(RadixNode*));
+        n->count_--;
+        if(n->count_ <= 3) {
+            BST_STAT(allocations, 1);
+            BST_STAT(frees, 1);
+            RadixNode4* shrunk = new RadixNode4;
+            shrunk->count_ = n->count_;
+            shrunk->prefixLen_ = n->prefixLen_;
+            std::memcpy(shrunk->prefix_, n->prefix_, sizeof(n->prefix_));
+            std::memcpy(shrunk->keys_, n->keys_, n->count_);
+            std::memcpy(shrunk->children_, n->children_, n->count_ * sizeof(RadixNode*));
+            *ref = shrunk;
+            delete n;
+        }
+        return;
+    }
+    case RadixNode::NODE48: {
+        RadixNode48* n = static_cast<RadixNode48*>(node);
+        n->children_[n->index_[byte] - 1] = NULL;
+        n->index_[byte] = 0;
+        n->count_--;
+        if(n->count_ <= 12) {
+            BST_STAT(allocations, 1);
+            BST_STAT(frees, 1);
+            RadixNode16* shrunk = new RadixNode16;
+            shrunk->prefixLen_ = n->prefixLen_;
+            std::memcpy(shrunk->prefix_, n->prefix_, sizeof(n->prefix_));
+            for(int b = 0; b < 256; b++) {
+                if(n->index_[b] != 0) {
+                    shrunk->keys_[shrunk->count_] = static_cast<uint8_t>(b);
+                    shrunk->children_[shrunk->count_] = n->children_[n->index_[b] - 1];
+                    shrunk->count_++;
+                }
+            }
+            *ref = shrunk;
+            delete n;
+        }
+        return;
+    }
+    default: {
+        RadixNode256* n = static_cast<RadixNode256*>(node);
+        n->children_[byte] = NULL;
+        n->count_--;
+        if(n->count_ <= 37) {
+            BST_STAT(allocations, 1);
+            BST_STAT(frees, 1);
+            RadixNode48* shrunk = new RadixNode48;
+            shrunk->prefixLen_ = n->prefixLen_;
+            std::memcpy(shrunk->prefix_, n->prefix_, sizeof(n->prefix_));
+            for(int b = 0; b < 256; b++) {
+                if(n->children_[b] != NULL) {
+                    shrunk->children_[shrunk->count_] = n->children_[b];
+                    shrunk->index_[b] = static_cast<uint8_t>(shrunk->count_ + 1);
+                    shrunk->count_++;
+                }
+            }
+            *ref = shrunk;
+            delete n;
+        }
+        return;
+    }
+    }
+}
+
+//HELPER: clearNode
+/*
+    frees node and everything below it (the depth is bounded by the key
+    width, so recursion is fine)
+*/
+template<class Key, class Value>
+void OrderedRadixMap<Key, Value>::clearNode(RadixNode* node)
+{
+    BST_STAT(frees, 1);
+    if(node->type_ == RadixNode::LEAF) {
+        delete static_cast<RadixLeaf<Key, Value>*>(node);
+        return;
+    }
+    RadixInnerNode* inner = static_cast<RadixInnerNode*>(node);
+    for(int pos = nextPos(inner, -1); pos >= 0; pos = nextPos(inner, pos)) {
+        clearNode(*childAt(inner, pos));
+    }
+    switch(node->type_) {
+    case RadixNode::NODE4:
+        delete static_cast<RadixNode4*>(node);
+        break;
+    case RadixNode::NODE16:
+        delete static_cast<RadixNode16*>(node);
+        break;
+    case RadixNode::NODE48:
+        delete static_cast<RadixNode48*>(node);
+        break;
+    default:
+        delete static_cast<RadixNode256*>(node);
+        break;
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the OrderedRadixMap class.
+  -----------------------------------------------
+*/
+
+#endif
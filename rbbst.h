@@ -0,0 +1,505 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include "bst.h"
+
+/**
+* A node for a red-black tree: a plain Node plus its color. The color
+* takes the byte AVLNode uses for its balance, so both node types are the
+* same size. It cannot go into a spare bit of the parent pointer because
+* Node::setParent() and nodeSwap() write parent_ directly.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    enum Color { RED = 0, BLACK = 1 };
+
+    // Constructor/destructor. New nodes are red.
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent);
+    virtual ~RBNode();
+
+    // Getter/setter for the node's color.
+    Color getColor() const;
+    void setColor(Color color);
+
+    // Getters for parent, left, and right, returning RBNodes (see AVLNode).
+    virtual RBNode<Key, Value>* getParent() const override;
+    virtual RBNode<Key, Value>* getLeft() const override;
+    virtual RBNode<Key, Value>* getRight() const override;
+
+protected:
+    uint8_t color_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base class constructor
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value> *parent) :
+    Node<Key, Value>(key, value, parent), color_(RED)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+/**
+* A getter for the color of a RBNode.
+*/
+template<class Key, class Value>
+typename RBNode<Key, Value>::Color RBNode<Key, Value>::getColor() const
+{
+    return static_cast<Color>(color_);
+}
+
+/**
+* A setter for the color of a RBNode.
+*/
+template<class Key, class Value>
+void RBNode<Key, Value>::setColor(Color color)
+{
+    color_ = static_cast<uint8_t>(color);
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a RBNode.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+/**
+* A red-black tree. Its height is at most 2 log2(n + 1), a little looser
+* than an AVL tree, but an insert needs at most 2 rotations and a remove at
+* most 3, with the remaining fix-up work being O(1) amortized recoloring.
+* That makes it cheaper than AVLTree on write-heavy workloads, where
+* AVLTree::removeFix() can rotate at every level.
+*
+* Removing a node with two children swaps it with its predecessor first,
+* like BinarySearchTree and AVLTree.
+*/
+template <class Key, class Value>
+class RBTree : public BinarySearchTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    virtual void insert (const std::pair<const Key, Value> &new_item) override;
+    virtual void remove(const Key& key) override;
+    bool isValidRB() const;
+
+protected:
+    virtual void nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2);
+
+    void rotateLeft(RBNode<Key,Value>* node);
+    void rotateRight(RBNode<Key,Value>* node);
+    void insertFix(RBNode<Key,Value>* node);
+    void removeFix(RBNode<Key,Value>* node);
+
+    static bool isBlack(RBNode<Key,Value>* node);
+    int blackHeight(RBNode<Key,Value>* node) const;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the RBTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Inserts the item as a red leaf (overwriting the value of an existing key)
+* and restores the red-black properties.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
+{
+    BST_LATENCY_SCOPE(LAT_INSERT);
+    RBNode<Key, Value>* parent = NULL;
+    RBNode<Key, Value>* temp = static_cast<RBNode<Key, Value>*>(this->root_);
+    bool left = false;
+
+    KeyPrefixCursor<Key> cursor(new_item.first);
+
+    //find the key or the leaf position for it
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        int order = cursor.order(temp);
+        if(order == 0 && new_item.first == temp->getKey()) {
+            temp->setValue(new_item.second);
+            return;
+        }
+        parent = temp;
+        if(order < 0 || (order == 0 && (BST_STAT(comparisons, 1), new_item.first < temp->getKey()))) {
+            left = true;
+            temp = temp->getLeft();
+        }
+        else {
+            left = false;
+            temp = temp->getRight();
+        }
+    }
+
+    RBNode<Key, Value>* node = new RBNode<Key, Value>(new_item.first, new_item.second, parent);
+    if(parent == NULL) {
+        this->root_ = node;
+    }
+    else if(left) {
+        parent->setLeft(node);
+    }
+    else {
+        parent->setRight(node);
+    }
+    this->nodeAdded(node, cursor.pack());
+    insertFix(node);
+}
+
+/**
+* Removes the key if present and restores the red-black properties.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::remove(const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    RBNode<Key, Value>* node = static_cast<RBNode<Key, Value>*>(this->internalFind(key));
+    if(node == NULL) {
+        return;
+    }
+
+    //two children --> swap with predecessor so node has at most one child
+    if(node->getLeft() != NULL && node->getRight() != NULL) {
+        RBNode<Key, Value>* pred = static_cast<RBNode<Key, Value>*>(this->predecessor(node));
+        nodeSwap(node, pred);
+    }
+
+    RBNode<Key, Value>* child = node->getLeft() != NULL ? node->getLeft() : node->getRight();
+
+    //a black leaf leaves a black-height deficit; fix it up while node still
+    //stands in for the empty subtree, then unlink it
+    if(child == NULL && isBlack(node)) {
+        removeFix(node);
+    }
+
+    RBNode<Key, Value>* parent = node->getParent();
+    if(child != NULL) {
+        //node is black with a single red child, which takes its place
+        child->setParent(parent);
+        child->setColor(RBNode<Key, Value>::BLACK);
+    }
+    if(parent == NULL) {
+        this->root_ = child;
+    }
+    else if(parent->getLeft() == node) {
+        parent->setLeft(child);
+    }
+    else {
+        parent->setRight(child);
+    }
+    this->freeNode(node);
+}
+
+/**
+* Checks the red-black properties: a black root, no red node with a red
+* child, and the same number of black nodes on every root-to-leaf path.
+*/
+template<class Key, class Value>
+bool RBTree<Key, Value>::isValidRB() const
+{
+    RBNode<Key, Value>* root = static_cast<RBNode<Key, Value>*>(this->root_);
+    if(root != NULL && !isBlack(root)) {
+        return false;
+    }
+    return blackHeight(root) >= 0;
+}
+
+/**
+* Swaps the positions of two nodes; colors belong to positions, so they
+* are swapped back.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    typename RBNode<Key, Value>::Color tempC = n1->getColor();
+    n1->setColor(n2->getColor());
+    n2->setColor(tempC);
+}
+
+//HELPER: rotateLeft
+/*
+    node's right child takes node's place and node becomes its left child
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::rotateLeft(RBNode<Key,Value>* node)
+{
+    RBNode<Key, Value>* parent = node->getParent();
+    RBNode<Key, Value>* rightChild = node->getRight();
+    RBNode<Key, Value>* inner = rightChild->getLeft();
+
+    node->setRight(inner);
+    if(inner != NULL) {
+        inner->setParent(node);
+    }
+    rightChild->setLeft(node);
+    node->setParent(rightChild);
+    rightChild->setParent(parent);
+
+    if(parent == NULL) {
+        this->root_ = rightChild;
+    }
+    else if(parent->getLeft() == node) {
+        parent->setLeft(rightChild);
+    }
+    else {
+        parent->setRight(rightChild);
+    }
+}
+
+//HELPER: rotateRight
+/*
+    mirror image of rotateLeft
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::rotateRight(RBNode<Key,Value>* node)
+{
+    RBNode<Key, Value>* parent = node->getParent();
+    RBNode<Key, Value>* leftChild = node->getLeft();
+    RBNode<Key, Value>* inner = leftChild->getRight();
+
+    node->setLeft(inner);
+    if(inner != NULL) {
+        inner->setParent(node);
+    }
+    leftChild->setRight(node);
+    node->setParent(leftChild);
+    leftChild->setParent(parent);
+
+    if(parent == NULL) {
+        this->root_ = leftChild;
+    }
+    else if(parent->getLeft() == node) {
+        parent->setLeft(leftChild);
+    }
+    else {
+        parent->setRight(leftChild);
+    }
+}
+
+//HELPER: insertFix
+/*
+    node is red; while its parent is red too, either push blackness down
+    from the grandparent (red uncle) and continue two levels up, or end
+    with one or two rotations (black uncle)
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::insertFix(RBNode<Key,Value>* node)
+{
+    while(node->getParent() != NULL && !isBlack(node->getParent())) {
+        BST_STAT(rebalanceSteps, 1);
+        RBNode<Key, Value>* parent = node->getParent();
+        //a red parent is never the root, so the grandparent exists
+        RBNode<Key, Value>* grand = parent->getParent();
+        bool parentIsLeft = (parent == grand->getLeft());
+        RBNode<Key, Value>* uncle = parentIsLeft ? grand->getRight() : grand->getLeft();
+
+        //red uncle: recolor
+        if(!isBlack(uncle)) {
+            parent->setColor(RBNode<Key, Value>::BLACK);
+            uncle->setColor(RBNode<Key, Value>::BLACK);
+            grand->setColor(RBNode<Key, Value>::RED);
+            node = grand;
+            continue;
+        }
+
+        //black uncle, zig-zag: rotate node above parent first
+        if(parentIsLeft && node == parent->getRight()) {
+            BST_STAT(doubleRotations, 1);
+            rotateLeft(parent);
+            parent = node;
+        }
+        else if(!parentIsLeft && node == parent->getLeft()) {
+            BST_STAT(doubleRotations, 1);
+            rotateRight(parent);
+            parent = node;
+        }
+        else {
+            BST_STAT(singleRotations, 1);
+        }
+
+        //black uncle, zig-zig: rotate parent above grandparent
+        parent->setColor(RBNode<Key, Value>::BLACK);
+        grand->setColor(RBNode<Key, Value>::RED);
+        if(parentIsLeft) {
+            rotateRight(grand);
+        }
+        else {
+            rotateLeft(grand);
+        }
+        break;
+    }
+    static_cast<RBNode<Key, Value>*>(this->root_)->setColor(RBNode<Key, Value>::BLACK);
+}
+
+//HELPER: removeFix
+/*
+    node's subtree is one black node short. Recolor the sibling and move
+    the deficit up while the sibling's children are black, otherwise end
+    with at most three rotations
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::removeFix(RBNode<Key,Value>* node)
+{
+    while(node != this->root_ && isBlack(node)) {
+        BST_STAT(rebalanceSteps, 1);
+        RBNode<Key, Value>* parent = node->getParent();
+        bool isLeft = (node == parent->getLeft());
+        //node's side has black height >= 1, so the sibling exists
+        RBNode<Key, Value>* sibling = isLeft ? parent->getRight() : parent->getLeft();
+
+        //red sibling: rotate it up so node gets a black sibling
+        if(!isBlack(sibling)) {
+            BST_STAT(singleRotations, 1);
+            sibling->setColor(RBNode<Key, Value>::BLACK);
+            parent->setColor(RBNode<Key, Value>::RED);
+            if(isLeft) {
+                rotateLeft(parent);
+                sibling = parent->getRight();
+            }
+            else {
+                rotateRight(parent);
+                sibling = parent->getLeft();
+            }
+        }
+
+        RBNode<Key, Value>* nearNephew = isLeft ? sibling->getLeft() : sibling->getRight();
+        RBNode<Key, Value>* farNephew = isLeft ? sibling->getRight() : sibling->getLeft();
+
+        //both nephews black: recolor and move the deficit up
+        if(isBlack(nearNephew) && isBlack(farNephew)) {
+            sibling->setColor(RBNode<Key, Value>::RED);
+            node = parent;
+            continue;
+        }
+
+        //only the near nephew is red: rotate it above the sibling
+        if(isBlack(farNephew)) {
+            BST_STAT(doubleRotations, 1);
+            nearNephew->setColor(RBNode<Key, Value>::BLACK);
+            sibling->setColor(RBNode<Key, Value>::RED);
+            if(isLeft) {
+                rotateRight(sibling);
+            }
+            else {
+                rotateLeft(sibling);
+            }
+            farNephew = sibling;
+            sibling = nearNephew;
+        }
+        else {
+            BST_STAT(singleRotations, 1);
+        }
+
+        //far nephew red: rotate the sibling above the parent and stop
+        sibling->setColor(parent->getColor());
+        parent->setColor(RBNode<Key, Value>::BLACK);
+        farNephew->setColor(RBNode<Key, Value>::BLACK);
+        if(isLeft) {
+            rotateLeft(parent);
+        }
+        else {
+            rotateRight(parent);
+        }
+        return;
+    }
+    node->setColor(RBNode<Key, Value>::BLACK);
+}
+
+//HELPER: isBlack
+/*
+    empty subtrees count as black
+*/
+template<class Key, class Value>
+bool RBTree<Key, Value>::isBlack(RBNode<Key,Value>* node)
+{
+    return node == NULL || node->getColor() == RBNode<Key, Value>::BLACK;
+}
+
+//HELPER: blackHeight
+/*
+    black height of the subtree, or -1 if a red-black property or the
+    parent links are broken inside it
+*/
+template<class Key, class Value>
+int RBTree<Key, Value>::blackHeight(RBNode<Key,Value>* node) const
+{
+    if(node == NULL) {
+        return 0;
+    }
+    RBNode<Key, Value>* left = node->getLeft();
+    RBNode<Key, Value>* right = node->getRight();
+    if((left != NULL && left->getParent() != node) || (right != NULL && right->getParent() != node)) {
+        return -1;
+    }
+    if(!isBlack(node) && (!isBlack(left) || !isBlack(right))) {
+        return -1;
+    }
+    int leftHeight = blackHeight(left);
+    int rightHeight = blackHeight(right);
+    if(leftHeight < 0 || leftHeight != rightHeight) {
+        return -1;
+    }
+    return leftHeight + (isBlack(node) ? 1 : 0);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RBTree class.
+  -----------------------------------------------
+*/
+
+#endif
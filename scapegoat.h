@@ -0,0 +1,296 @@
+#ifndef SCAPEGOAT_H
+#define SCAPEGOAT_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstddef>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "bst.h"
+
+/**
+* A scapegoat tree: a self-balancing BinarySearchTree that keeps no
+* per-node balance information, so it uses plain Nodes. The tree only
+* tracks its size and the largest size it has had since the last full
+* rebuild.
+*
+* An insert that lands deeper than log_{1/alpha}(size) walks back up to the
+* first ancestor whose child subtree holds more than alpha of its nodes
+* (the scapegoat) and rebuilds that subtree into a perfectly balanced one
+* in linear time. Once removals shrink the tree below alpha * maxSize the
+* whole tree is rebuilt. Lookups are O(log n) worst case and updates
+* O(log n) amortized.
+*
+* alpha trades lookup depth for rebuild work: values close to 0.5 keep the
+* tree nearly perfect, values close to 1 rebuild rarely.
+*/
+template <class Key, class Value>
+class ScapegoatTree : public BinarySearchTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    explicit ScapegoatTree(double alpha = 2.0 / 3.0);
+
+    virtual void insert (const std::pair<const Key, Value> &new_item) override;
+    virtual void remove(const Key& key) override;
+    size_t size() const;
+
+protected:
+    size_t subtreeSize(Node<Key, Value>* node) const;
+    void rebuild(Node<Key, Value>* node, size_t count);
+    Node<Key, Value>* buildBalanced(std::vector<Node<Key, Value>*>& nodes, size_t lo, size_t hi, Node<Key, Value>* parent);
+
+    double alpha_;
+    double logInvAlpha_;
+    size_t size_;
+    size_t maxSize_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the ScapegoatTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Constructs an empty tree with the given balance factor, which must lie
+* in (0.5, 1).
+*/
+template<class Key, class Value>
+ScapegoatTree<Key, Value>::ScapegoatTree(double alpha) :
+    alpha_(alpha), logInvAlpha_(0), size_(0), maxSize_(0)
+{
+    if(!(alpha > 0.5 && alpha < 1.0)) {
+        throw std::invalid_argument("Scapegoat alpha must be in (0.5, 1)");
+    }
+    logInvAlpha_ = std::log(1.0 / alpha);
+}
+
+/**
+* Returns the number of items in the tree.
+*/
+template<class Key, class Value>
+size_t ScapegoatTree<Key, Value>::size() const
+{
+    return this->root_ == NULL ? 0 : size_;
+}
+
+/**
+* Inserts the item (overwriting the value of an existing key); if the new
+* leaf is too deep, rebuilds the subtree rooted at its scapegoat.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
+{
+    BST_LATENCY_SCOPE(LAT_INSERT);
+    //the counters are stale if the tree was emptied by clear()
+    if(this->root_ == NULL) {
+        size_ = 0;
+        maxSize_ = 0;
+    }
+
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* temp = this->root_;
+    bool left = false;
+    size_t depth = 0;
+
+    KeyPrefixCursor<Key> cursor(new_item.first);
+
+    //find the key or the leaf position for it
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        int order = cursor.order(temp);
+        if(order == 0 && new_item.first == temp->getKey()) {
+            temp->setValue(new_item.second);
+            return;
+        }
+        parent = temp;
+        depth++;
+        if(order < 0 || (order == 0 && (BST_STAT(comparisons, 1), new_item.first < temp->getKey()))) {
+            left = true;
+            temp = temp->getLeft();
+        }
+        else {
+            left = false;
+            temp = temp->getRight();
+        }
+    }
+
+    Node<Key, Value>* node = new Node<Key, Value>(new_item.first, new_item.second, parent);
+    if(parent == NULL) {
+        this->root_ = node;
+    }
+    else if(left) {
+        parent->setLeft(node);
+    }
+    else {
+        parent->setRight(node);
+    }
+    this->nodeAdded(node, cursor.pack());
+    size_++;
+    if(size_ > maxSize_) {
+        maxSize_ = size_;
+    }
+
+    //still within the height bound
+    if(static_cast<double>(depth) <= std::log(static_cast<double>(size_)) / logInvAlpha_) {
+        return;
+    }
+
+    //climb until a child subtree holds more than alpha of its parent's;
+    //a node that deep guarantees one exists
+    Node<Key, Value>* child = node;
+    size_t childSize = 1;
+    while(child->getParent() != NULL) {
+        BST_STAT(rebalanceSteps, 1);
+        Node<Key, Value>* up = child->getParent();
+        Node<Key, Value>* sibling = (up->getLeft() == child) ? up->getRight() : up->getLeft();
+        size_t upSize = childSize + 1 + subtreeSize(sibling);
+        if(static_cast<double>(childSize) > alpha_ * static_cast<double>(upSize)) {
+            rebuild(up, upSize);
+            return;
+        }
+        child = up;
+        childSize = upSize;
+    }
+}
+
+/**
+* Removes the key if present (a node with two children is swapped with its
+* predecessor first); rebuilds the whole tree once it has shrunk below
+* alpha * maxSize.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::remove(const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == NULL) {
+        return;
+    }
+
+    //two children --> swap with predecessor so node has at most one child
+    if(node->getLeft() != NULL && node->getRight() != NULL) {
+        this->nodeSwap(node, this->predecessor(node));
+    }
+
+    Node<Key, Value>* child = node->getLeft() != NULL ? node->getLeft() : node->getRight();
+    Node<Key, Value>* parent = node->getParent();
+    if(child != NULL) {
+        child->setParent(parent);
+    }
+    if(parent == NULL) {
+        this->root_ = child;
+    }
+    else if(parent->getLeft() == node) {
+        parent->setLeft(child);
+    }
+    else {
+        parent->setRight(child);
+    }
+    this->freeNode(node);
+    size_--;
+
+    if(static_cast<double>(size_) < alpha_ * static_cast<double>(maxSize_)) {
+        if(this->root_ != NULL) {
+            rebuild(this->root_, size_);
+        }
+        maxSize_ = size_;
+    }
+}
+
+//HELPER: subtreeSize
+/*
+    counts the nodes under node (iteratively, in-order via successor)
+*/
+template<class Key, class Value>
+size_t ScapegoatTree<Key, Value>::subtreeSize(Node<Key, Value>* node) const
+{
+    if(node == NULL) {
+        return 0;
+    }
+    //stop at the first node past the subtree: node's successor once its
+    //right spine is exhausted
+    Node<Key, Value>* last = node;
+    while(last->getRight() != NULL) {
+        last = last->getRight();
+    }
+    Node<Key, Value>* temp = node;
+    while(temp->getLeft() != NULL) {
+        temp = temp->getLeft();
+    }
+    size_t count = 1;
+    while(temp != last) {
+        temp = this->successor(temp);
+        count++;
+    }
+    return count;
+}
+
+//HELPER: rebuild
+/*
+    relinks the count nodes under node into a perfectly balanced subtree
+    hung from node's old parent
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::rebuild(Node<Key, Value>* node, size_t count)
+{
+    Node<Key, Value>* parent = node->getParent();
+    bool isLeft = (parent != NULL && parent->getLeft() == node);
+
+    //collect the nodes in order
+    std::vector<Node<Key, Value>*> nodes;
+    nodes.reserve(count);
+    Node<Key, Value>* temp = node;
+    while(temp->getLeft() != NULL) {
+        temp = temp->getLeft();
+    }
+    for(size_t i = 0; i < count; i++) {
+        nodes.push_back(temp);
+        if(i + 1 < count) {
+            temp = this->successor(temp);
+        }
+    }
+
+    Node<Key, Value>* root = buildBalanced(nodes, 0, count, parent);
+    if(parent == NULL) {
+        this->root_ = root;
+    }
+    else if(isLeft) {
+        parent->setLeft(root);
+    }
+    else {
+        parent->setRight(root);
+    }
+}
+
+//HELPER: buildBalanced
+/*
+    links nodes[lo, hi) into a balanced subtree under parent and returns its
+    root (NULL for an empty range)
+*/
+template<class Key, class Value>
+Node<Key, Value>* ScapegoatTree<Key, Value>::buildBalanced(std::vector<Node<Key, Value>*>& nodes, size_t lo, size_t hi, Node<Key, Value>* parent)
+{
+    if(lo >= hi) {
+        return NULL;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    Node<Key, Value>* root = nodes[mid];
+    root->setParent(parent);
+    root->setLeft(buildBalanced(nodes, lo, mid, root));
+    root->setRight(buildBalanced(nodes, mid + 1, hi, root));
+    return root;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ScapegoatTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,459 @@
+#ifndef SHARDEDAVL_H
+#define SHARDEDAVL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+// Shards with fewer items than this are never rebalanced, however skewed.
+#define SHARD_REBALANCE_MIN 1024
+
+// An insert checks its shard for skew only when the shard's count reaches
+// a multiple of this, since the check reads every shard's count.
+#define SHARD_SKEW_CHECK 64
+
+// Most items one boundary move hands over. Both shards stay locked while
+// the split point is walked to, so this bounds how long writers wait.
+#define SHARD_MIGRATE_MAX 4096
+
+/**
+* An ordered key/value table split by key range into shards, each an
+* AVLTree behind its own mutex, so that writers working on different
+* ranges run in parallel instead of queueing on one lock.
+*
+* The shard boundaries are a vector of split points: shard i holds the
+* keys with bounds[i - 1] <= key < bounds[i]. They are published as an
+* immutable Layout through a shared_ptr read with std::atomic_load, so
+* finding a key's shard takes no lock; an operation then locks that shard
+* and checks that the layout has not been replaced in the meantime.
+*
+* Each shard keeps its own item count, so writers to different shards
+* never touch a shared counter; size() adds them up. When an insert leaves
+* a shard holding more than skew times the average shard size (checked
+* every SHARD_SKEW_CHECK items), its items over the average are spilled
+* toward the side of the row with more room: the boundary with the
+* neighbour on that side moves so the shard keeps the average (moving at
+* most SHARD_MIGRATE_MAX items), and while the neighbour is left above the
+* average its own excess moves on the same way. Data inserted at one end
+* thus spreads over all shards, and a shard is only rebalanced again once
+* it has grown back to skew times the average. The items move with
+* AVLTree::split and join, which relink whole subtrees in O(log n); only
+* the new split point is found by walking from the end of the shard the
+* items leave, over the items that move.
+*
+* for_each() visits the items in key order, shard after shard, while
+* holding off rebalancing so no item is seen twice or skipped. The
+* visitor must not call back into the table.
+*
+* All public members are thread safe.
+*/
+template <typename Key, typename Value>
+class ShardedAVLTree
+{
+public:
+    explicit ShardedAVLTree(const std::vector<Key>& splitPoints, double skew = 2.0);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool lookup(const Key& key, Value& value) const;
+
+    template<typename Visitor>
+    void for_each(Visitor visit) const;
+    template<typename Visitor>
+    void for_each(const Key& lo, const Key& hi, Visitor visit) const;
+
+    size_t size() const;
+    size_t shards() const;
+    size_t rebalances() const;
+
+private:
+    ShardedAVLTree(const ShardedAVLTree&);
+    ShardedAVLTree& operator=(const ShardedAVLTree&);
+
+    // An AVLTree that can also find keys by their rank from either end.
+    class ShardTree : public AVLTree<Key, Value>
+    {
+    public:
+        Key keyFromFront(size_t rank) const;
+        Key keyFromBack(size_t rank) const;
+    };
+
+    struct Shard
+    {
+        Shard() : size(0) {}
+
+        std::mutex mutex;
+        ShardTree tree;
+        // Written under mutex, read without it to spot skew.
+        std::atomic<size_t> size;
+    };
+
+    // Never modified once published; a rebalance publishes a new one.
+    struct Layout
+    {
+        std::vector<Key> bounds;
+    };
+
+    size_t lockShard(const Key& key, std::unique_lock<std::mutex>& lock) const;
+    bool skewed(size_t shard) const;
+    void rebalance(size_t shard);
+    bool migrate(size_t from, size_t to, size_t keep);
+
+    std::vector<std::unique_ptr<Shard> > shards_;
+    std::shared_ptr<const Layout> layout_;
+    // Held while moving items between shards, and by for_each().
+    mutable std::mutex rebalanceMutex_;
+    double skew_;
+    std::atomic<size_t> rebalances_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the ShardedAVLTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Creates splitPoints.size() + 1 empty shards divided at the given keys,
+* which must be strictly increasing; they only need to be a rough guess,
+* as rebalancing moves them to follow the data. skew must be above 1.
+*/
+template<typename Key, typename Value>
+ShardedAVLTree<Key, Value>::ShardedAVLTree(const std::vector<Key>& splitPoints, double skew) :
+    skew_(skew), rebalances_(0)
+{
+    if(!(skew > 1.0)) {
+        throw std::invalid_argument("Shard skew must be above 1");
+    }
+    for(size_t i = 1; i < splitPoints.size(); i++) {
+        if(!(splitPoints[i - 1] < splitPoints[i])) {
+            throw std::invalid_argument("Shard split points must be strictly increasing");
+        }
+    }
+    for(size_t i = 0; i <= splitPoints.size(); i++) {
+        shards_.push_back(std::unique_ptr<Shard>(new Shard));
+    }
+    std::shared_ptr<Layout> layout(new Layout);
+    layout->bounds = splitPoints;
+    layout_ = layout;
+}
+
+/**
+* Inserts the item (overwriting the value of an existing key), then
+* rebalances if the shard it went into has grown too large.
+*/
+template<typename Key, typename Value>
+void ShardedAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    size_t index;
+    size_t count;
+    {
+        std::unique_lock<std::mutex> lock;
+        index = lockShard(keyValuePair.first, lock);
+        Shard& shard = *shards_[index];
+
+        //one descent finds the key or, through a hinted insert, its slot
+        typename AVLTree<Key, Value>::iterator it = shard.tree.lower_bound(keyValuePair.first);
+        if(it != shard.tree.end() && !(keyValuePair.first < it->first)) {
+            it->second = keyValuePair.second;
+            return;
+        }
+        shard.tree.insert(it, keyValuePair);
+        count = ++shard.size;
+    }
+    if(count % SHARD_SKEW_CHECK == 0 && skewed(index)) {
+        rebalance(index);
+    }
+}
+
+/**
+* Removes the key if present.
+*/
+template<typename Key, typename Value>
+void ShardedAVLTree<Key, Value>::remove(const Key& key)
+{
+    std::unique_lock<std::mutex> lock;
+    Shard& shard = *shards_[lockShard(key, lock)];
+    typename AVLTree<Key, Value>::iterator it = shard.tree.find(key);
+    if(it == shard.tree.end()) {
+        return;
+    }
+    shard.tree.erase(it);
+    shard.size--;
+}
+
+/**
+* Copies the key's value into value and returns true, or returns false if
+* the key is missing.
+*/
+template<typename Key, typename Value>
+bool ShardedAVLTree<Key, Value>::lookup(const Key& key, Value& value) const
+{
+    std::unique_lock<std::mutex> lock;
+    const Shard& shard = *shards_[lockShard(key, lock)];
+    typename AVLTree<Key, Value>::iterator it = shard.tree.find(key);
+    if(it == shard.tree.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+/**
+* Calls visit(item) for every item, in key order. Each shard is locked
+* while it is visited, so writers to other shards carry on.
+*/
+template<typename Key, typename Value>
+template<typename Visitor>
+void ShardedAVLTree<Key, Value>::for_each(Visitor visit) const
+{
+    std::lock_guard<std::mutex> guard(rebalanceMutex_);
+    for(size_t i = 0; i < shards_.size(); i++) {
+        std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+        const AVLTree<Key, Value>& tree = shards_[i]->tree;
+        for(typename AVLTree<Key, Value>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            visit(*it);
+        }
+    }
+}
+
+/**
+* Calls visit(item) for every item with lo <= key < hi, in key order,
+* locking only the shards the range covers.
+*/
+template<typename Key, typename Value>
+template<typename Visitor>
+void ShardedAVLTree<Key, Value>::for_each(const Key& lo, const Key& hi, Visitor visit) const
+{
+    std::lock_guard<std::mutex> guard(rebalanceMutex_);
+    //only a rebalance replaces the layout
+    std::shared_ptr<const Layout> layout = std::atomic_load(&layout_);
+    const std::vector<Key>& bounds = layout->bounds;
+    size_t i = std::upper_bound(bounds.begin(), bounds.end(), lo) - bounds.begin();
+    for(; i < shards_.size() && (i == 0 || bounds[i - 1] < hi); i++) {
+        std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+        const AVLTree<Key, Value>& tree = shards_[i]->tree;
+        for(typename AVLTree<Key, Value>::iterator it = tree.lower_bound(lo); it != tree.end() && it->first < hi; ++it) {
+            visit(*it);
+        }
+    }
+}
+
+/**
+* Returns the number of items, adding up the shard counts one by one:
+* while writers are running it is only an estimate.
+*/
+template<typename Key, typename Value>
+size_t ShardedAVLTree<Key, Value>::size() const
+{
+    size_t total = 0;
+    for(size_t i = 0; i < shards_.size(); i++) {
+        total += shards_[i]->size;
+    }
+    return total;
+}
+
+/**
+* Returns the number of shards.
+*/
+template<typename Key, typename Value>
+size_t ShardedAVLTree<Key, Value>::shards() const
+{
+    return shards_.size();
+}
+
+/**
+* Returns how many times a shard boundary has been moved.
+*/
+template<typename Key, typename Value>
+size_t ShardedAVLTree<Key, Value>::rebalances() const
+{
+    return rebalances_;
+}
+
+//HELPER: lockShard
+/*
+    locks the shard holding key and returns its index. A rebalance holds
+    the locks of both shards whose boundary it moves until the new layout
+    is out, so a layout that is still current once the lock is held is
+    the right one; otherwise try again
+*/
+template<typename Key, typename Value>
+size_t ShardedAVLTree<Key, Value>::lockShard(const Key& key, std::unique_lock<std::mutex>& lock) const
+{
+    while(true) {
+        std::shared_ptr<const Layout> layout = std::atomic_load(&layout_);
+        const std::vector<Key>& bounds = layout->bounds;
+        size_t index = std::upper_bound(bounds.begin(), bounds.end(), key) - bounds.begin();
+        std::unique_lock<std::mutex> attempt(shards_[index]->mutex);
+        if(std::atomic_load(&layout_) == layout) {
+            lock = std::move(attempt);
+            return index;
+        }
+    }
+}
+
+//HELPER: skewed
+/*
+    whether shard holds more than skew times the average; small shards are
+    ruled out before the other shards' counts are read
+*/
+template<typename Key, typename Value>
+bool ShardedAVLTree<Key, Value>::skewed(size_t shard) const
+{
+    size_t count = shards_[shard]->size;
+    return count >= SHARD_REBALANCE_MIN &&
+        static_cast<double>(count) > skew_ * static_cast<double>(size()) / static_cast<double>(shards_.size());
+}
+
+//HELPER: rebalance
+/*
+    spills shard's items over the average along the row, toward the side
+    with more room below the average, until a shard takes them without
+    going over. Skipped if another rebalance (or a for_each) is running:
+    the next skew check on a skewed shard retries, as it does when
+    SHARD_MIGRATE_MAX left the shard skewed
+*/
+template<typename Key, typename Value>
+void ShardedAVLTree<Key, Value>::rebalance(size_t shard)
+{
+    std::unique_lock<std::mutex> guard(rebalanceMutex_, std::try_to_lock);
+    if(!guard.owns_lock() || shards_.size() < 2) {
+        return;
+    }
+
+    //with more shards than items there is no average to spill down to
+    size_t average = size() / shards_.size();
+    if(average == 0) {
+        return;
+    }
+    //room to the left minus room to the right
+    double room = 0;
+    for(size_t i = 0; i < shards_.size(); i++) {
+        double below = static_cast<double>(average) - static_cast<double>(shards_[i]->size);
+        if(i < shard) {
+            room += below;
+        }
+        else if(i > shard) {
+            room -= below;
+        }
+    }
+    bool down = shard + 1 == shards_.size() || (shard > 0 && room > 0);
+    while(down ? shard > 0 : shard + 1 < shards_.size()) {
+        size_t next = down ? shard - 1 : shard + 1;
+        if(!migrate(shard, next, average) || shards_[next]->size <= average) {
+            break;
+        }
+        shard = next;
+    }
+}
+
+//HELPER: migrate
+/*
+    moves the boundary between the neighbouring shards from and to so that
+    from keeps keep items, handing at most SHARD_MIGRATE_MAX over: split
+    off the part that moves and join it to the other shard, then publish
+    the new layout before unlocking. Returns false if there was nothing to
+    move
+*/
+template<typename Key, typename Value>
+bool ShardedAVLTree<Key, Value>::migrate(size_t from, size_t to, size_t keep)
+{
+    size_t lower = std::min(from, to);
+    Shard& a = *shards_[lower];
+    Shard& b = *shards_[lower + 1];
+    std::lock_guard<std::mutex> lockA(a.mutex);
+    std::lock_guard<std::mutex> lockB(b.mutex);
+
+    size_t size = shards_[from]->size;
+    if(size <= keep) {
+        return false;
+    }
+
+    //the first key that belongs in the upper shard, found by walking
+    //only the items that move; a downward move leaves at least that key
+    //behind to serve as the boundary
+    bool upward = from == lower;
+    size_t count = std::min<size_t>(size - keep, SHARD_MIGRATE_MAX);
+    if(!upward) {
+        count = std::min(count, size - 1);
+        if(count == 0) {
+            return false;
+        }
+    }
+    Key boundary = upward ? a.tree.keyFromBack(count - 1) : b.tree.keyFromFront(count);
+    ShardTree moved;
+    if(upward) {
+        a.tree.split(boundary, moved);
+        b.tree.join(moved);
+        a.size -= count;
+        b.size += count;
+    }
+    else {
+        b.tree.split(boundary, moved);
+        a.tree.join(b.tree);
+        b.tree.join(moved);
+        a.size += count;
+        b.size -= count;
+    }
+
+    std::shared_ptr<Layout> layout(new Layout(*std::atomic_load(&layout_)));
+    layout->bounds[lower] = boundary;
+    std::atomic_store(&layout_, std::shared_ptr<const Layout>(layout));
+    rebalances_++;
+    return true;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ShardedAVLTree class.
+  -----------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the ShardedAVLTree::ShardTree class.
+  -----------------------------------------------
+*/
+
+/**
+* The key of the item with rank items before it (rank < size), in
+* O(rank).
+*/
+template<typename Key, typename Value>
+Key ShardedAVLTree<Key, Value>::ShardTree::keyFromFront(size_t rank) const
+{
+    typename AVLTree<Key, Value>::iterator it = this->begin();
+    for(size_t i = 0; i < rank; i++) {
+        ++it;
+    }
+    return it->first;
+}
+
+/**
+* The key of the item with rank items after it (rank < size), in
+* O(rank), walking back from the cached largest node.
+*/
+template<typename Key, typename Value>
+Key ShardedAVLTree<Key, Value>::ShardTree::keyFromBack(size_t rank) const
+{
+    Node<Key, Value>* node = this->rightmost_;
+    for(size_t i = 0; i < rank; i++) {
+        node = BinarySearchTree<Key, Value>::predecessor(node);
+    }
+    return node->getKey();
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ShardedAVLTree::ShardTree class.
+  -----------------------------------------------
+*/
+
+#endif
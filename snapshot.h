@@ -0,0 +1,230 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+// Size of the staging buffer used by SnapshotWriter and SnapshotReader.
+#define SNAPSHOT_BUFFER_SIZE (1 << 20)
+
+/**
+* Buffered byte sink used when writing a tree snapshot. Bytes are staged in a
+* large buffer and handed to the stream in big chunks, so serializers can
+* write field by field without paying for a stream call each time.
+* A writer can also append straight to a byte vector, which is how single
+* records (e.g. log entries) are encoded.
+*/
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(std::ostream& out);
+    explicit SnapshotWriter(std::vector<char>& sink);
+    ~SnapshotWriter();
+
+    void put(const void* data, size_t len);
+    void flush();
+
+private:
+    std::ostream* out_;
+    std::vector<char>* sink_;
+    std::vector<char> buf_;
+    size_t used_;
+};
+
+/**
+* Buffered byte source used when reading a tree snapshot, or a reader over
+* bytes already in memory. Throws std::runtime_error if the input ends
+* before the requested bytes are read.
+*/
+class SnapshotReader
+{
+public:
+    explicit SnapshotReader(std::istream& in);
+    SnapshotReader(const char* data, size_t len);
+
+    void get(void* data, size_t len);
+
+private:
+    void refill();
+
+    std::istream* in_;
+    std::vector<char> buf_;
+    const char* data_;
+    size_t pos_;
+    size_t end_;
+};
+
+/**
+* Default serializer for snapshot keys and values. Trivially copyable types
+* are written as raw bytes; other types need a specialization of this
+* template (see the std::string one below) or a custom serializer passed
+* to AVLTree::save/load with the same static write/read interface.
+*/
+template <typename T>
+struct SnapshotSerializer
+{
+    static void write(SnapshotWriter& out, const T& item)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+            "SnapshotSerializer needs a specialization for this type");
+        out.put(&item, sizeof(T));
+    }
+    static void read(SnapshotReader& in, T& item)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+            "SnapshotSerializer needs a specialization for this type");
+        in.get(&item, sizeof(T));
+    }
+};
+
+/**
+* Strings are written as a 64-bit length followed by their bytes. Reading
+* grows the string with the bytes actually there, so a corrupt length runs
+* into the end of the input (std::runtime_error) instead of allocating it.
+*/
+template <>
+struct SnapshotSerializer<std::string>
+{
+    static void write(SnapshotWriter& out, const std::string& item)
+    {
+        uint64_t len = item.size();
+        out.put(&len, sizeof(len));
+        out.put(item.data(), item.size());
+    }
+    static void read(SnapshotReader& in, std::string& item)
+    {
+        uint64_t len;
+        in.get(&len, sizeof(len));
+        item.clear();
+        char chunk[4096];
+        while(len > 0) {
+            size_t n = len < sizeof(chunk) ? static_cast<size_t>(len) : sizeof(chunk);
+            in.get(chunk, n);
+            item.append(chunk, n);
+            len -= n;
+        }
+    }
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the SnapshotWriter class.
+  -----------------------------------------------
+*/
+
+inline SnapshotWriter::SnapshotWriter(std::ostream& out) :
+    out_(&out), sink_(NULL), buf_(SNAPSHOT_BUFFER_SIZE), used_(0)
+{
+
+}
+
+inline SnapshotWriter::SnapshotWriter(std::vector<char>& sink) :
+    out_(NULL), sink_(&sink), used_(0)
+{
+
+}
+
+/**
+* Anything still staged is pushed out on destruction; call flush() directly
+* to find out about write errors.
+*/
+inline SnapshotWriter::~SnapshotWriter()
+{
+    if(used_ > 0) {
+        out_->write(&buf_[0], used_);
+    }
+}
+
+inline void SnapshotWriter::put(const void* data, size_t len)
+{
+    const char* src = static_cast<const char*>(data);
+
+    //memory sinks have no staging buffer
+    if(sink_ != NULL) {
+        sink_->insert(sink_->end(), src, src + len);
+        return;
+    }
+
+    //large writes go straight through once the staged bytes are out
+    if(len >= buf_.size()) {
+        flush();
+        out_->write(src, len);
+        return;
+    }
+    if(used_ + len > buf_.size()) {
+        flush();
+    }
+    std::memcpy(&buf_[used_], src, len);
+    used_ += len;
+}
+
+inline void SnapshotWriter::flush()
+{
+    if(sink_ != NULL) {
+        return;
+    }
+    if(used_ > 0) {
+        out_->write(&buf_[0], used_);
+        used_ = 0;
+    }
+    if(!*out_) {
+        throw std::runtime_error("Snapshot write failed");
+    }
+}
+
+/*
+  -----------------------------------------------
+  Begin implementations for the SnapshotReader class.
+  -----------------------------------------------
+*/
+
+inline SnapshotReader::SnapshotReader(std::istream& in) :
+    in_(&in), buf_(SNAPSHOT_BUFFER_SIZE), data_(&buf_[0]), pos_(0), end_(0)
+{
+
+}
+
+inline SnapshotReader::SnapshotReader(const char* data, size_t len) :
+    in_(NULL), data_(data), pos_(0), end_(len)
+{
+
+}
+
+inline void SnapshotReader::get(void* data, size_t len)
+{
+    char* dst = static_cast<char*>(data);
+    while(len > 0) {
+        if(pos_ == end_) {
+            refill();
+        }
+        size_t n = end_ - pos_;
+        if(n > len) {
+            n = len;
+        }
+        std::memcpy(dst, data_ + pos_, n);
+        pos_ += n;
+        dst += n;
+        len -= n;
+    }
+}
+
+inline void SnapshotReader::refill()
+{
+    if(in_ == NULL) {
+        throw std::runtime_error("Snapshot truncated");
+    }
+    in_->read(&buf_[0], buf_.size());
+    pos_ = 0;
+    end_ = static_cast<size_t>(in_->gcount());
+    if(end_ == 0) {
+        throw std::runtime_error("Snapshot truncated");
+    }
+}
+
+#endif
@@ -0,0 +1,364 @@
+#ifndef SPLAY_H
+#define SPLAY_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <stdexcept>
+#include "bst.h"
+
+/**
+* A self-adjusting binary search tree. Every access (find, operator[],
+* insert, remove) rotates the node it touched up to the root, so keys that
+* are read often stay near the top and cost only a few comparisons.
+*
+* Splaying rewrites pointers on every read. With a splay period of k only
+* every k-th access splays, which keeps hot keys near the root on skewed
+* workloads while cutting the pointer writes by a factor of k. Removal
+* always splays, since it has to restructure the tree anyway.
+*
+* The tree uses plain Nodes, so iterators are those of BinarySearchTree.
+* Note that find() and operator[] modify the shape of the tree; the const
+* overloads inherited from BinarySearchTree do not splay.
+*/
+template <class Key, class Value>
+class SplayTree : public BinarySearchTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    explicit SplayTree(unsigned int splayPeriod = 1);
+
+    virtual void insert (const std::pair<const Key, Value> &new_item) override;
+    virtual void remove(const Key& key) override;
+
+    using BinarySearchTree<Key, Value>::find;
+    iterator find(const Key& key);
+    using BinarySearchTree<Key, Value>::operator[];
+    Value& operator[](const Key& key);
+
+    void setSplayPeriod(unsigned int splayPeriod);
+    unsigned int getSplayPeriod() const;
+
+protected:
+    Node<Key, Value>* lookup(const Key& key, Node<Key, Value>*& last) const;
+    Node<Key, Value>* descend(const Key& key, Node<Key, Value>*& last) const;
+    void touch(Node<Key, Value>* node);
+    void splay(Node<Key, Value>* node, Node<Key, Value>* stop);
+    void rotateUp(Node<Key, Value>* node);
+
+    unsigned int splayPeriod_;
+    unsigned int accessCount_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the SplayTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Constructs an empty tree that splays on every splayPeriod-th access
+* (every access by default).
+*/
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(unsigned int splayPeriod) :
+    splayPeriod_(1), accessCount_(0)
+{
+    setSplayPeriod(splayPeriod);
+}
+
+/**
+* Sets how many accesses pass between splays. A period of 1 is a classic
+* splay tree; 0 is rejected.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::setSplayPeriod(unsigned int splayPeriod)
+{
+    if(splayPeriod == 0) {
+        throw std::invalid_argument("Splay period must be at least 1");
+    }
+    splayPeriod_ = splayPeriod;
+    accessCount_ = 0;
+}
+
+template<class Key, class Value>
+unsigned int SplayTree<Key, Value>::getSplayPeriod() const
+{
+    return splayPeriod_;
+}
+
+/**
+* Inserts the item (overwriting the value of an existing key) and splays
+* the node that holds it.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    BST_LATENCY_SCOPE(LAT_INSERT);
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* node = descend(new_item.first, parent);
+
+    //key already present --> overwrite
+    if(node != NULL) {
+        node->setValue(new_item.second);
+        touch(node);
+        return;
+    }
+
+    node = new Node<Key, Value>(new_item.first, new_item.second, parent);
+    if(parent == NULL) {
+        this->root_ = node;
+    }
+    else if(new_item.first < parent->getKey()) {
+        parent->setLeft(node);
+    }
+    else {
+        parent->setRight(node);
+    }
+    this->nodeAdded(node);
+    touch(node);
+}
+
+/**
+* Removes the key if present: its node is splayed to the root, then the
+* largest node of the left subtree is splayed up under it and takes its
+* place, so the right subtree can hang off it directly.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::remove(const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    Node<Key, Value>* last = NULL;
+    Node<Key, Value>* node = descend(key, last);
+    if(node == NULL) {
+        touch(last);
+        return;
+    }
+
+    splay(node, NULL);
+    Node<Key, Value>* left = node->getLeft();
+    Node<Key, Value>* right = node->getRight();
+
+    if(left == NULL) {
+        this->root_ = right;
+        if(right != NULL) {
+            right->setParent(NULL);
+        }
+    }
+    else {
+        Node<Key, Value>* max = left;
+        while(max->getRight() != NULL) {
+            max = max->getRight();
+        }
+        //max becomes node's left child, with no right child of its own
+        splay(max, node);
+        max->setRight(right);
+        if(right != NULL) {
+            right->setParent(max);
+        }
+        max->setParent(NULL);
+        this->root_ = max;
+    }
+    this->freeNode(node);
+}
+
+/**
+* Returns an iterator to the item with the given key (or end()) and
+* splays the node found, or on a miss the last node visited.
+*/
+template<class Key, class Value>
+typename SplayTree<Key, Value>::iterator SplayTree<Key, Value>::find(const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_FIND);
+    Node<Key, Value>* last = NULL;
+    Node<Key, Value>* node = lookup(key, last);
+    touch(node != NULL ? node : last);
+    return this->makeIterator(node);
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key, splaying its node.
+*/
+template<class Key, class Value>
+Value& SplayTree<Key, Value>::operator[](const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_SUBSCRIPT);
+    Node<Key, Value>* last = NULL;
+    Node<Key, Value>* node = lookup(key, last);
+    if(node == NULL) {
+        touch(last);
+        throw std::out_of_range("Invalid key");
+    }
+    touch(node);
+    return node->getValue();
+}
+
+//HELPER: lookup
+/*
+    filteredFind for the splaying overloads: the Bloom filter, then the
+    lookup cache, then descend(). Returns the node holding key, or NULL
+    with last set to the last node visited (NULL if the filter answered)
+*/
+template<class Key, class Value>
+Node<Key, Value>* SplayTree<Key, Value>::lookup(const Key& key, Node<Key, Value>*& last) const
+{
+    last = NULL;
+    if(this->bloom_ != NULL && !this->bloom_->mayContain(key)) {
+        return NULL;
+    }
+
+    //splaying only moves nodes, so cached pointers stay valid
+    Node<Key, Value>* node;
+    if(this->lookupCache_.empty()) {
+        node = descend(key, last);
+    }
+    else {
+        size_t slot = this->lookupCacheSlot(key);
+        node = this->lookupCache_[slot];
+        if(node != NULL && node->getKey() == key) {
+            this->lookupCacheStats_.hits++;
+            return node;
+        }
+        this->lookupCacheStats_.misses++;
+        node = descend(key, last);
+        if(node != NULL) {
+            this->lookupCache_[slot] = node;
+        }
+    }
+
+    if(node == NULL && this->bloom_ != NULL) {
+        this->bloom_->recordFalsePositive();
+    }
+    return node;
+}
+
+//HELPER: descend
+/*
+    returns the node holding key, or NULL; last is set to the last node
+    visited (the would-be parent on a miss, NULL for an empty tree)
+*/
+template<class Key, class Value>
+Node<Key, Value>* SplayTree<Key, Value>::descend(const Key& key, Node<Key, Value>*& last) const
+{
+    Node<Key, Value>* temp = this->root_;
+    KeyPrefixCursor<Key> cursor(key);
+    last = NULL;
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        last = temp;
+        int order = cursor.order(temp);
+        if(order == 0 && key == temp->getKey()) {
+            return temp;
+        }
+        else if(order < 0 || (order == 0 && (BST_STAT(comparisons, 1), key < temp->getKey()))) {
+            temp = temp->getLeft();
+        }
+        else {
+            temp = temp->getRight();
+        }
+    }
+    return NULL;
+}
+
+//HELPER: touch
+/*
+    counts an access to node and splays it to the root once every
+    splayPeriod_ accesses
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::touch(Node<Key, Value>* node)
+{
+    if(node == NULL) {
+        return;
+    }
+    accessCount_++;
+    if(accessCount_ >= splayPeriod_) {
+        accessCount_ = 0;
+        splay(node, NULL);
+    }
+}
+
+//HELPER: splay
+/*
+    rotates node up until its parent is stop (NULL splays to the root),
+    using the zig-zig / zig-zag steps that give the amortized bounds
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::splay(Node<Key, Value>* node, Node<Key, Value>* stop)
+{
+    while(node->getParent() != stop) {
+        BST_STAT(rebalanceSteps, 1);
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grand = parent->getParent();
+
+        //zig: parent is the last step
+        if(grand == stop) {
+            BST_STAT(singleRotations, 1);
+            rotateUp(node);
+        }
+        //zig-zig: rotate the parent first
+        else if((node == parent->getLeft()) == (parent == grand->getLeft())) {
+            BST_STAT(doubleRotations, 1);
+            rotateUp(parent);
+            rotateUp(node);
+        }
+        //zig-zag
+        else {
+            BST_STAT(doubleRotations, 1);
+            rotateUp(node);
+            rotateUp(node);
+        }
+    }
+}
+
+//HELPER: rotateUp
+/*
+    rotates node above its parent, fixing the grandparent's (or root's)
+    link
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::rotateUp(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    Node<Key, Value>* grand = parent->getParent();
+
+    if(node == parent->getLeft()) {
+        Node<Key, Value>* inner = node->getRight();
+        parent->setLeft(inner);
+        if(inner != NULL) {
+            inner->setParent(parent);
+        }
+        node->setRight(parent);
+    }
+    else {
+        Node<Key, Value>* inner = node->getLeft();
+        parent->setRight(inner);
+        if(inner != NULL) {
+            inner->setParent(parent);
+        }
+        node->setLeft(parent);
+    }
+    parent->setParent(node);
+    node->setParent(grand);
+
+    if(grand == NULL) {
+        this->root_ = node;
+    }
+    else if(grand->getLeft() == parent) {
+        grand->setLeft(node);
+    }
+    else {
+        grand->setRight(node);
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the SplayTree class.
+  -----------------------------------------------
+*/
+
+#endif
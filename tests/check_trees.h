@@ -0,0 +1,247 @@
+//
+// Checkers for the trees, in the style of hw4_tests' check_bst.h and
+// check_avl.h: each returns a testing::AssertionResult that says where the
+// first problem is. Tests run every structure against a std::map (or
+// std::multimap) model and call these after each batch of changes.
+//
+
+#ifndef TREE_TESTS_CHECK_TREES_H
+#define TREE_TESTS_CHECK_TREES_H
+
+#include "publicified_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Verifies the links of the tree under root: the root has no parent,
+   every child points back at its parent, and an in-order walk sees the
+   keys strictly increasing (or never decreasing, with duplicates set).
+   Walks with an explicit stack, since splay trees can be as deep as they
+   are big.
+*/
+template<typename Key, typename Value>
+testing::AssertionResult checkLinks(Node<Key, Value>* root, bool duplicates = false)
+{
+	if(root == nullptr)
+	{
+		return testing::AssertionSuccess();
+	}
+	if(root->getParent() != nullptr)
+	{
+		return testing::AssertionFailure() << "The root " << root->getKey() << " has a parent";
+	}
+
+	std::vector<Node<Key, Value>*> stack;
+	Node<Key, Value>* prev = nullptr;
+	Node<Key, Value>* curr = root;
+	while(curr != nullptr || !stack.empty())
+	{
+		while(curr != nullptr)
+		{
+			for(int side = 0; side < 2; side++)
+			{
+				Node<Key, Value>* child = side == 0 ? curr->getLeft() : curr->getRight();
+				if(child != nullptr && child->getParent() != curr)
+				{
+					return testing::AssertionFailure() << "A child of " << curr->getKey() << " does not have its parent set correctly";
+				}
+			}
+			stack.push_back(curr);
+			curr = curr->getLeft();
+		}
+		curr = stack.back();
+		stack.pop_back();
+		if(prev != nullptr && (duplicates ? curr->getKey() < prev->getKey() : !(prev->getKey() < curr->getKey())))
+		{
+			return testing::AssertionFailure() << "Key " << curr->getKey() << " comes after " << prev->getKey() << " in order";
+		}
+		prev = curr;
+		curr = curr->getRight();
+	}
+	return testing::AssertionSuccess();
+}
+
+// recursively checks the stored balances and returns the subtree height,
+// or -1 after setting result to a failure
+template<typename Key, typename Value>
+int checkAVLHeights(AVLNode<Key, Value>* node, testing::AssertionResult& result)
+{
+	if(node == nullptr)
+	{
+		return 0;
+	}
+	int left = checkAVLHeights(node->getLeft(), result);
+	if(left < 0)
+	{
+		return -1;
+	}
+	int right = checkAVLHeights(node->getRight(), result);
+	if(right < 0)
+	{
+		return -1;
+	}
+	if(std::abs(right - left) > 1)
+	{
+		result = testing::AssertionFailure() << "AVL balance error: subtree rooted at " << node->getKey() << " is out of balance! Left child has height "
+			<< left << ", and right child has height " << right << ".";
+		return -1;
+	}
+	if(node->getBalance() != right - left)
+	{
+		result = testing::AssertionFailure() << "Node " << node->getKey() << " stores balance " << int(node->getBalance())
+			<< ", should have been " << (right - left);
+		return -1;
+	}
+	return 1 + std::max(left, right);
+}
+
+/* Verifies an AVLTree (or any subclass): links and order, heights and
+   stored balances, and the cached end nodes.
+*/
+template<typename Key, typename Value>
+testing::AssertionResult checkAVL(AVLTree<Key, Value>& tree, bool duplicates = false)
+{
+	testing::AssertionResult links = checkLinks(tree.root_, duplicates);
+	if(!links)
+	{
+		return links;
+	}
+	testing::AssertionResult result = testing::AssertionSuccess();
+	AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(tree.root_);
+	if(checkAVLHeights(root, result) < 0)
+	{
+		return result;
+	}
+	if(root != nullptr)
+	{
+		Node<Key, Value>* min = root;
+		Node<Key, Value>* max = root;
+		while(min->getLeft() != nullptr)
+		{
+			min = min->getLeft();
+		}
+		while(max->getRight() != nullptr)
+		{
+			max = max->getRight();
+		}
+		if(tree.leftmost_ != min || tree.rightmost_ != max)
+		{
+			return testing::AssertionFailure() << "Cached end nodes are stale";
+		}
+	}
+	return testing::AssertionSuccess();
+}
+
+/* Recomputes the aggregate of every subtree from scratch and compares it
+   with the one stored in the node. Returns the subtree's aggregate.
+*/
+template<typename Key, typename Value, typename Monoid>
+typename Monoid::aggregate_type checkStoredAggregates(AggregateAVLNode<Key, Value, Monoid>* node, testing::AssertionResult& result)
+{
+	if(node == nullptr)
+	{
+		return Monoid::identity();
+	}
+	typename Monoid::aggregate_type expected = Monoid::combine(Monoid::combine(
+		checkStoredAggregates(node->getLeft(), result), Monoid::lift(node->getKey(), node->getValue())),
+		checkStoredAggregates(node->getRight(), result));
+	if(result && !(expected == node->getAggregate()))
+	{
+		result = testing::AssertionFailure() << "Node " << node->getKey() << " stores aggregate "
+			<< node->getAggregate() << " but its subtree gives " << expected;
+	}
+	return expected;
+}
+
+/* Verifies an AggregateAVLTree (or any subclass): checkAVL, and every
+   node's stored aggregate matches its subtree.
+*/
+template<typename Key, typename Value, typename Monoid>
+testing::AssertionResult checkAggregates(AggregateAVLTree<Key, Value, Monoid>& tree)
+{
+	testing::AssertionResult result = checkAVL(tree);
+	if(!result)
+	{
+		return result;
+	}
+	checkStoredAggregates(static_cast<AggregateAVLNode<Key, Value, Monoid>*>(tree.root_), result);
+	return result;
+}
+
+/* Verifies that iterating tree gives exactly the items of model, in order,
+   and that find() locates each of them.
+*/
+template<typename Tree, typename Map>
+testing::AssertionResult checkContents(Tree& tree, const Map& model)
+{
+	typename Map::const_iterator expected = model.begin();
+	for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++expected)
+	{
+		if(expected == model.end())
+		{
+			return testing::AssertionFailure() << "Unexpected extra key " << it->first;
+		}
+		if(!(it->first == expected->first) || !(it->second == expected->second))
+		{
+			return testing::AssertionFailure() << "Found key " << it->first << " where " << expected->first << " was expected";
+		}
+	}
+	if(expected != model.end())
+	{
+		return testing::AssertionFailure() << "Key " << expected->first << " is missing";
+	}
+	for(expected = model.begin(); expected != model.end(); ++expected)
+	{
+		//in a multimap, find() gives the oldest item with the key
+		typename Tree::iterator it = tree.find(expected->first);
+		if(it == tree.end() || !(it->second == model.lower_bound(expected->first)->second))
+		{
+			return testing::AssertionFailure() << "find() does not return key " << expected->first;
+		}
+	}
+	return testing::AssertionSuccess();
+}
+
+/* A fresh directory under /tmp, removed with everything in it when the
+   test ends.
+*/
+class TempDir
+{
+public:
+	TempDir()
+	{
+		char pattern[] = "/tmp/tree-tests-XXXXXX";
+		if(mkdtemp(pattern) == nullptr)
+		{
+			throw std::runtime_error("Cannot create a temporary directory");
+		}
+		path_ = pattern;
+	}
+
+	~TempDir()
+	{
+		std::string command = "rm -rf '" + path_ + "'";
+		if(std::system(command.c_str()) != 0)
+		{
+			std::cerr << "Cannot remove " << path_ << std::endl;
+		}
+	}
+
+	const std::string& path() const
+	{
+		return path_;
+	}
+
+private:
+	TempDir(const TempDir&);
+	TempDir& operator=(const TempDir&);
+
+	std::string path_;
+};
+
+#endif //TREE_TESTS_CHECK_TREES_H
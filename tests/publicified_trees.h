@@ -0,0 +1,70 @@
+//
+// Wrapper around the tree headers that makes all private/protected members
+// public, as hw4_tests' publicified_bst.h and publicified_avlbst.h do, so
+// the checkers can walk the nodes directly.
+//
+// The standard headers the trees use are included first: their include
+// guards then keep them out of reach of the redefinitions below.
+//
+
+#ifndef TREE_TESTS_PUBLICIFIED_TREES_H
+#define TREE_TESTS_PUBLICIFIED_TREES_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <emmintrin.h>
+#include <errno.h>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <istream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#define private public
+#define protected public
+#include <bst.h>
+#include <avlbst.h>
+#include <compactavl.h>
+#include <splay.h>
+#include <rbbst.h>
+#include <scapegoat.h>
+#include <treap.h>
+#include <radixmap.h>
+#include <aggregateavl.h>
+#include <intervaltree.h>
+#include <multiavl.h>
+#include <ttlmap.h>
+#include <shardedavl.h>
+#include <mappedtree.h>
+#include <durablestore.h>
+#undef private
+#undef protected
+
+#endif //TREE_TESTS_PUBLICIFIED_TREES_H
@@ -0,0 +1,101 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+// the aggregate over [lo, hi] by iterating the model
+template<typename Monoid>
+typename Monoid::aggregate_type bruteForce(const std::map<int, long>& model, int lo, int hi)
+{
+	typename Monoid::aggregate_type total = Monoid::identity();
+	for(std::map<int, long>::const_iterator it = model.lower_bound(lo); it != model.end() && it->first <= hi; ++it)
+	{
+		total = Monoid::combine(total, Monoid::lift(it->first, it->second));
+	}
+	return total;
+}
+
+template<typename Monoid>
+void runAggregateModel(unsigned seed)
+{
+	std::mt19937 rng(seed);
+	AggregateAVLTree<int, long, Monoid> tree;
+	std::map<int, long> model;
+	for(int round = 0; round < 10; round++)
+	{
+		for(int i = 0; i < 2000; i++)
+		{
+			int key = static_cast<int>(rng() % 3000);
+			long value = static_cast<long>(rng() % 2001) - 1000;
+			switch(rng() % 4)
+			{
+			case 0:
+				tree.remove(key);
+				model.erase(key);
+				break;
+			case 1:
+			{
+				typename AggregateAVLTree<int, long, Monoid>::iterator it = tree.find(key);
+				if(it != tree.end())
+				{
+					tree.setValue(it, value);
+					model[key] = value;
+				}
+				break;
+			}
+			default:
+				tree.insert(std::make_pair(key, value));
+				model[key] = value;
+				break;
+			}
+		}
+		ASSERT_TRUE(checkAggregates(tree));
+		ASSERT_TRUE(checkContents(tree, model));
+		ASSERT_EQ(bruteForce<Monoid>(model, 0, 3000), tree.aggregate());
+		for(int i = 0; i < 500; i++)
+		{
+			int lo = static_cast<int>(rng() % 3200) - 100;
+			int hi = lo + static_cast<int>(rng() % 800);
+			ASSERT_EQ(bruteForce<Monoid>(model, lo, hi), tree.aggregate(lo, hi)) << lo << ".." << hi;
+		}
+	}
+	// an empty range and an empty tree give the identity
+	EXPECT_EQ(Monoid::identity(), tree.aggregate(10, 5));
+	tree.clear();
+	EXPECT_EQ(Monoid::identity(), tree.aggregate());
+	EXPECT_EQ(Monoid::identity(), tree.aggregate(0, 3000));
+}
+
+TEST(AggregateTree, RangeAggregatesMatchBruteForce)
+{
+	runAggregateModel<SumMonoid<long> >(430);
+	runAggregateModel<MinMonoid<long> >(431);
+	runAggregateModel<MaxMonoid<long> >(432);
+}
+
+TEST(AggregateTree, SequentialInsertsAndRangeErase)
+{
+	AggregateAVLTree<int, long, SumMonoid<long> > tree;
+	std::map<int, long> model;
+	// ascending inserts rotate at every level
+	for(int i = 0; i < 1000; i++)
+	{
+		tree.insert(std::make_pair(i, long(i)));
+		model[i] = i;
+	}
+	ASSERT_TRUE(checkAggregates(tree));
+	EXPECT_EQ(999L * 1000 / 2, tree.aggregate());
+	EXPECT_EQ(bruteForce<SumMonoid<long> >(model, 250, 749), tree.aggregate(250, 749));
+
+	tree.erase(tree.find(100), tree.find(900));
+	model.erase(model.find(100), model.find(900));
+	ASSERT_TRUE(checkAggregates(tree));
+	ASSERT_TRUE(checkContents(tree, model));
+	EXPECT_EQ(bruteForce<SumMonoid<long> >(model, 0, 999), tree.aggregate());
+	EXPECT_EQ(0L, tree.aggregate(100, 899));
+
+	EXPECT_EQ(5L, tree[5]);
+	EXPECT_THROW(tree.setValue(tree.end(), 1), std::out_of_range);
+}
@@ -0,0 +1,136 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+TEST(BloomFilter, NoFalseNegativesAndRateNearTarget)
+{
+	CountingBloomFilter<int> filter(10000, 0.01);
+	for(int i = 0; i < 10000; i++)
+	{
+		filter.add(i * 2);
+	}
+	for(int i = 0; i < 10000; i++)
+	{
+		ASSERT_TRUE(filter.mayContain(i * 2)) << i;
+	}
+	int passed = 0;
+	for(int i = 0; i < 100000; i++)
+	{
+		passed += filter.mayContain(1000001 + 2 * i) ? 1 : 0;
+	}
+	EXPECT_LT(passed, 100000 * 0.02);
+
+	BloomFilterStats stats = filter.stats();
+	EXPECT_DOUBLE_EQ(0.01, stats.targetFalsePositiveRate);
+	EXPECT_GT(stats.estimatedFalsePositiveRate, 0.0);
+	EXPECT_LT(stats.estimatedFalsePositiveRate, 0.02);
+	EXPECT_GT(stats.hashCount, 0);
+	EXPECT_GT(stats.memoryBytes, 0u);
+	EXPECT_THROW(CountingBloomFilter<int> bad(100, 1.5), std::invalid_argument);
+}
+
+TEST(BloomFilter, RemoveUndoesAdd)
+{
+	CountingBloomFilter<int> filter(1000, 0.01);
+	for(int i = 0; i < 1000; i++)
+	{
+		filter.add(i);
+	}
+	for(int i = 0; i < 1000; i += 2)
+	{
+		filter.remove(i);
+	}
+	int stillThere = 0;
+	for(int i = 0; i < 1000; i++)
+	{
+		if(i % 2 == 1)
+		{
+			ASSERT_TRUE(filter.mayContain(i));
+		}
+		else
+		{
+			stillThere += filter.mayContain(i) ? 1 : 0;
+		}
+	}
+	EXPECT_LT(stillThere, 25);
+
+	filter.clear();
+	EXPECT_FALSE(filter.mayContain(1));
+}
+
+TEST(BloomFilter, TreeLookupsStayExact)
+{
+	std::mt19937 rng(39);
+	AVLTree<std::string, int> tree;
+	std::map<std::string, int> model;
+	tree.enableBloomFilter(5000, 0.01);
+	for(int i = 0; i < 30000; i++)
+	{
+		std::string key = "k" + std::to_string(rng() % 8000);
+		if(rng() % 3 == 0)
+		{
+			tree.remove(key);
+			model.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, i));
+			model[key] = i;
+		}
+	}
+	EXPECT_TRUE(checkAVL(tree));
+	EXPECT_TRUE(checkContents(tree, model));
+
+	tree.bloom_->resetStats();
+	for(int i = 0; i < 20000; i++)
+	{
+		std::string key = "missing" + std::to_string(i);
+		ASSERT_TRUE(tree.find(key) == tree.end());
+		ASSERT_THROW(tree[key], std::out_of_range);
+	}
+	BloomFilterStats stats = tree.bloomFilterStats();
+	EXPECT_GT(stats.rejected, 30000u);
+	EXPECT_EQ(stats.passed, stats.falsePositives);
+
+	// the filter is refilled with the current keys when attached
+	AVLTree<int, int> late;
+	for(int i = 0; i < 100; i++)
+	{
+		late.insert(std::make_pair(i, i));
+	}
+	late.enableBloomFilter(1000, 0.01);
+	for(int i = 0; i < 100; i++)
+	{
+		ASSERT_TRUE(late.find(i) != late.end());
+	}
+	late.disableBloomFilter();
+	EXPECT_EQ(0u, late.bloomFilterStats().rejected);
+	EXPECT_TRUE(late.find(5) != late.end());
+}
+
+TEST(BloomFilter, SplayTreeLookupsUseTheFilter)
+{
+	SplayTree<int, int> tree;
+	std::map<int, int> model;
+	tree.enableBloomFilter(1000, 0.01);
+	for(int i = 0; i < 500; i++)
+	{
+		tree.insert(std::make_pair(2 * i, i));
+		model[2 * i] = i;
+	}
+	for(int i = 0; i < 500; i++)
+	{
+		ASSERT_TRUE(tree.find(2 * i + 1) == tree.end());
+		ASSERT_THROW(tree[2 * i + 1], std::out_of_range);
+		ASSERT_EQ(i, tree[2 * i]);
+	}
+	BloomFilterStats stats = tree.bloomFilterStats();
+	EXPECT_GT(stats.rejected, 900u);
+	EXPECT_EQ(stats.passed - 500, stats.falsePositives);
+	EXPECT_TRUE(checkLinks(tree.root_));
+	EXPECT_TRUE(checkContents(tree, model));
+}
@@ -0,0 +1,101 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+typedef CompactAVLTree<int, int> Compact;
+
+// walks from it to the end and compares with the model from expected on
+static testing::AssertionResult checkTail(Compact& tree, Compact::iterator it,
+	std::map<int, int>::const_iterator expected, const std::map<int, int>& model)
+{
+	for(; it != tree.end(); ++it, ++expected)
+	{
+		if(expected == model.end() || it->first != expected->first || it->second != expected->second)
+		{
+			return testing::AssertionFailure() << "Wrong item at key " << it->first;
+		}
+	}
+	if(expected != model.end())
+	{
+		return testing::AssertionFailure() << "Key " << expected->first << " is missing";
+	}
+	return testing::AssertionSuccess();
+}
+
+TEST(CompactAVL, RandomOperationsMatchModel)
+{
+	std::mt19937 rng(32);
+	Compact tree;
+	std::map<int, int> model;
+	for(int round = 0; round < 20; round++)
+	{
+		for(int i = 0; i < 2000; i++)
+		{
+			int key = static_cast<int>(rng() % 5000);
+			if(rng() % 3 == 0)
+			{
+				tree.remove(key);
+				model.erase(key);
+			}
+			else
+			{
+				tree.insert(std::make_pair(key, i));
+				model[key] = i;
+			}
+		}
+		ASSERT_TRUE(tree.isBalanced());
+		ASSERT_TRUE(checkContents(tree, model));
+	}
+
+	for(std::map<int, int>::iterator it = model.begin(); it != model.end(); ++it)
+	{
+		EXPECT_EQ(it->second, tree[it->first]);
+	}
+	EXPECT_THROW(tree[-1], std::out_of_range);
+
+	tree.clear();
+	EXPECT_TRUE(tree.empty());
+	EXPECT_TRUE(tree.begin() == tree.end());
+}
+
+TEST(CompactAVL, IteratesDeepTreesFromAnyPosition)
+{
+	// deep enough that iterators drop ancestors and have to find them again
+	Compact tree;
+	std::map<int, int> model;
+	std::mt19937 rng(320);
+	for(int i = 0; i < 100000; i++)
+	{
+		int key = static_cast<int>(rng() % 1000000);
+		tree.insert(std::make_pair(key, i));
+		model[key] = i;
+	}
+	ASSERT_TRUE(tree.isBalanced());
+	EXPECT_TRUE(checkTail(tree, tree.begin(), model.begin(), model));
+
+	for(int i = 0; i < 50; i++)
+	{
+		std::map<int, int>::const_iterator start = model.begin();
+		std::advance(start, rng() % model.size());
+		EXPECT_TRUE(checkTail(tree, tree.find(start->first), start, model));
+	}
+	EXPECT_TRUE(tree.find(-5) == tree.end());
+
+	// sequential keys make the left spine as long as it gets
+	Compact spine;
+	std::map<int, int> spineModel;
+	for(int i = 100000; i > 0; i--)
+	{
+		spine.insert(std::make_pair(i, -i));
+		spineModel[i] = -i;
+	}
+	EXPECT_TRUE(checkTail(spine, spine.begin(), spineModel.begin(), spineModel));
+}
+
+TEST(CompactAVL, IteratorsAreSmall)
+{
+	EXPECT_LE(sizeof(Compact::iterator), 12 * sizeof(void*));
+}
@@ -0,0 +1,291 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef DurableAVLStore<int, std::string> Store;
+
+static DurabilityOptions withPolicy(SyncPolicy sync, uint64_t checkpointEvery = 0)
+{
+	DurabilityOptions options;
+	options.sync = sync;
+	options.syncIntervalMs = 1;
+	options.checkpointEvery = checkpointEvery;
+	return options;
+}
+
+static bool fileExists(const std::string& path)
+{
+	return ::access(path.c_str(), F_OK) == 0;
+}
+
+static std::string readFile(const std::string& path)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& bytes)
+{
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// applies random updates to the store and the model
+static void randomUpdates(Store& store, std::map<int, std::string>& model, std::mt19937& rng, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		int key = static_cast<int>(rng() % 500);
+		if(rng() % 3 == 0)
+		{
+			store.remove(key);
+			model.erase(key);
+		}
+		else
+		{
+			std::string value(rng() % 20, static_cast<char>('a' + key % 26));
+			store.insert(std::make_pair(key, value));
+			model[key] = value;
+		}
+	}
+}
+
+// compares the store's tree with the model
+static testing::AssertionResult checkStore(Store& store, const std::map<int, std::string>& model)
+{
+	std::lock_guard<std::mutex> lock(store.treeMutex_);
+	testing::AssertionResult avl = checkAVL(store.tree_);
+	if(!avl)
+	{
+		return avl;
+	}
+	return checkContents(store.tree_, model);
+}
+
+TEST(DurableStore, ReopenRecoversEveryPolicy)
+{
+	SyncPolicy policies[] = { SYNC_NONE, SYNC_INTERVAL, SYNC_COMMIT };
+	for(size_t p = 0; p < 3; p++)
+	{
+		TempDir dir;
+		std::mt19937 rng(28 + p);
+		std::map<int, std::string> model;
+		uint64_t lsn;
+		{
+			Store store(dir.path() + "/db", withPolicy(policies[p]));
+			randomUpdates(store, model, rng, 3000);
+			EXPECT_TRUE(checkStore(store, model));
+			lsn = store.lastLsn();
+		}
+		{
+			Store store(dir.path() + "/db", withPolicy(policies[p]));
+			EXPECT_TRUE(checkStore(store, model)) << p;
+			EXPECT_EQ(lsn, store.lastLsn());
+
+			std::string value;
+			ASSERT_FALSE(model.empty());
+			EXPECT_TRUE(store.lookup(model.begin()->first, value));
+			EXPECT_EQ(model.begin()->second, value);
+			EXPECT_FALSE(store.lookup(-1, value));
+
+			randomUpdates(store, model, rng, 500);
+			store.checkpoint();
+			randomUpdates(store, model, rng, 500);
+		}
+		Store store(dir.path() + "/db", withPolicy(policies[p]));
+		EXPECT_TRUE(checkStore(store, model)) << p;
+	}
+}
+
+TEST(DurableStore, TornTailIsDropped)
+{
+	TempDir dir;
+	std::string db = dir.path() + "/db";
+	std::mt19937 rng(280);
+	std::map<int, std::string> model;
+	{
+		Store store(db, withPolicy(SYNC_NONE));
+		randomUpdates(store, model, rng, 1000);
+		store.sync();
+	}
+	std::string log = readFile(db + "/wal.log");
+	ASSERT_FALSE(log.empty());
+
+	// the start of another record, cut short
+	std::string torn = log;
+	torn.append(log.substr(0, 13));
+	writeFile(db + "/wal.log", torn);
+	{
+		Store store(db, withPolicy(SYNC_NONE));
+		EXPECT_TRUE(checkStore(store, model));
+		EXPECT_EQ(log.size(), readFile(db + "/wal.log").size());
+
+		// new records land after the good prefix and are found on reopen
+		randomUpdates(store, model, rng, 200);
+	}
+	{
+		Store store(db, withPolicy(SYNC_COMMIT));
+		EXPECT_TRUE(checkStore(store, model));
+	}
+
+	// a header claiming a huge record, and a payload with a bad checksum
+	log = readFile(db + "/wal.log");
+	uint32_t hugeFrame[2] = { 0xfffffff0u, 0 };
+	std::string huge = log;
+	huge.append(reinterpret_cast<const char*>(hugeFrame), sizeof(hugeFrame));
+	huge.append(64, 'x');
+	writeFile(db + "/wal.log", huge);
+	{
+		Store store(db, withPolicy(SYNC_NONE));
+		EXPECT_TRUE(checkStore(store, model));
+	}
+	std::string flipped = readFile(db + "/wal.log");
+	ASSERT_EQ(log, flipped);
+	flipped[flipped.size() - 1] ^= 0x55;
+	writeFile(db + "/wal.log", flipped);
+	Store store(db, withPolicy(SYNC_NONE));
+	EXPECT_LT(readFile(db + "/wal.log").size(), log.size());
+}
+
+TEST(DurableStore, CrashBetweenCheckpointAndLogRemoval)
+{
+	TempDir dir;
+	std::string db = dir.path() + "/db";
+	std::mt19937 rng(281);
+	std::map<int, std::string> before;
+	std::map<int, std::string> model;
+	std::string oldLog;
+	{
+		Store store(db, withPolicy(SYNC_COMMIT));
+		randomUpdates(store, before, rng, 1500);
+		oldLog = readFile(db + "/wal.log");
+
+		store.checkpoint();
+		EXPECT_TRUE(fileExists(db + "/checkpoint"));
+		EXPECT_FALSE(fileExists(db + "/wal.old.log"));
+		EXPECT_EQ(0u, readFile(db + "/wal.log").size());
+
+		model = before;
+		randomUpdates(store, model, rng, 1500);
+	}
+
+	// the new checkpoint is in place, but the log it covers was not removed
+	std::string crashed = dir.path() + "/crashed";
+	ASSERT_EQ(0, ::mkdir(crashed.c_str(), 0755));
+	writeFile(crashed + "/checkpoint", readFile(db + "/checkpoint"));
+	writeFile(crashed + "/wal.old.log", oldLog);
+	writeFile(crashed + "/wal.log", readFile(db + "/wal.log"));
+	std::map<int, std::string> atCrash = model;
+	{
+		Store store(crashed, withPolicy(SYNC_COMMIT));
+		EXPECT_TRUE(checkStore(store, model));
+
+		// the next checkpoint finishes the job
+		store.checkpoint();
+		EXPECT_FALSE(fileExists(crashed + "/wal.old.log"));
+		randomUpdates(store, model, rng, 100);
+	}
+	{
+		Store store(crashed, withPolicy(SYNC_COMMIT));
+		EXPECT_TRUE(checkStore(store, model));
+	}
+
+	// the log was rotated, but the checkpoint never written
+	std::string rotated = dir.path() + "/rotated";
+	ASSERT_EQ(0, ::mkdir(rotated.c_str(), 0755));
+	writeFile(rotated + "/wal.old.log", oldLog);
+	writeFile(rotated + "/wal.log", readFile(db + "/wal.log"));
+	{
+		Store store(rotated, withPolicy(SYNC_NONE));
+		EXPECT_TRUE(checkStore(store, atCrash));
+	}
+
+	// a corrupt old log is not a torn write: it was synced before the
+	// rotation
+	std::string bad = oldLog;
+	bad[bad.size() / 2] ^= 0x55;
+	writeFile(rotated + "/wal.old.log", bad);
+	EXPECT_THROW(Store store(rotated, withPolicy(SYNC_NONE)), std::runtime_error);
+}
+
+TEST(DurableStore, BackgroundCheckpointsUnderConcurrentWriters)
+{
+	TempDir dir;
+	std::string db = dir.path() + "/db";
+	const int threads = 4;
+	const int perThread = 1500;
+	{
+		Store store(db, withPolicy(SYNC_COMMIT, 500));
+		std::vector<std::thread> workers;
+		for(int t = 0; t < threads; t++)
+		{
+			workers.push_back(std::thread([&store, t]()
+			{
+				for(int i = 0; i < perThread; i++)
+				{
+					int key = i * threads + t;
+					store.insert(std::make_pair(key, std::to_string(key)));
+					std::string value;
+					// SYNC_COMMIT: a returned insert is visible
+					if(!store.lookup(key, value) || value != std::to_string(key))
+					{
+						ADD_FAILURE() << "Key " << key << " not visible after insert";
+						return;
+					}
+					if(i % 3 == 0)
+					{
+						store.remove(key);
+					}
+				}
+			}));
+		}
+		for(size_t i = 0; i < workers.size(); i++)
+		{
+			workers[i].join();
+		}
+		store.checkpoint();
+		EXPECT_TRUE(fileExists(db + "/checkpoint"));
+	}
+
+	std::map<int, std::string> model;
+	for(int t = 0; t < threads; t++)
+	{
+		for(int i = 0; i < perThread; i++)
+		{
+			if(i % 3 != 0)
+			{
+				model[i * threads + t] = std::to_string(i * threads + t);
+			}
+		}
+	}
+	Store store(db, withPolicy(SYNC_COMMIT));
+	EXPECT_TRUE(checkStore(store, model));
+}
+
+TEST(DurableStore, FailedLogLeavesTreeUnchanged)
+{
+	TempDir dir;
+	Store store(dir.path() + "/db", withPolicy(SYNC_COMMIT));
+	store.insert(std::make_pair(1, std::string("one")));
+
+	// writes to a read-only descriptor fail
+	int readOnly = ::open("/dev/null", O_RDONLY);
+	ASSERT_GE(readOnly, 0);
+	ASSERT_GE(::dup2(readOnly, store.logFd_), 0);
+	::close(readOnly);
+
+	EXPECT_THROW(store.insert(std::make_pair(2, std::string("two"))), std::runtime_error);
+	EXPECT_THROW(store.remove(1), std::runtime_error);
+	EXPECT_THROW(store.insert(std::make_pair(3, std::string("three"))), std::runtime_error);
+
+	std::map<int, std::string> model;
+	model[1] = "one";
+	EXPECT_TRUE(checkStore(store, model));
+}
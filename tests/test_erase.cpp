@@ -0,0 +1,190 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+// erases random items through iterators, checking each returned iterator
+// against the model's
+template<typename Tree>
+void runIteratorErase(Tree& tree, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::map<int, int> model;
+	for(int i = 0; i < 3000; i++)
+	{
+		int key = static_cast<int>(rng() % 5000);
+		tree.insert(std::make_pair(key, i));
+		model[key] = i;
+	}
+	while(!model.empty())
+	{
+		int key = static_cast<int>(rng() % 5000);
+		std::map<int, int>::iterator mit = model.lower_bound(key);
+		if(mit == model.end())
+		{
+			mit = model.begin();
+		}
+		typename Tree::iterator it = tree.find(mit->first);
+		ASSERT_TRUE(it != tree.end());
+		it = tree.erase(it);
+		mit = model.erase(mit);
+		ASSERT_EQ(mit == model.end(), it == tree.end());
+		if(mit != model.end())
+		{
+			ASSERT_EQ(mit->first, it->first);
+			// erase runs of neighbours through the returned iterator
+			for(int run = static_cast<int>(rng() % 4); run > 0 && mit != model.end(); run--)
+			{
+				it = tree.erase(it);
+				mit = model.erase(mit);
+				ASSERT_EQ(mit == model.end(), it == tree.end());
+			}
+		}
+		if(model.size() % 500 == 0)
+		{
+			ASSERT_TRUE(checkContents(tree, model));
+		}
+	}
+	EXPECT_TRUE(tree.empty());
+	EXPECT_THROW(tree.erase(tree.end()), std::out_of_range);
+}
+
+TEST(Erase, IteratorEraseMatchesModel)
+{
+	AVLTree<int, int> avl;
+	avl.setLookupCacheSize(64);
+	runIteratorErase(avl, 470);
+	EXPECT_TRUE(checkAVL(avl));
+	RBTree<int, int> rb;
+	runIteratorErase(rb, 471);
+	BinarySearchTree<int, int> bst;
+	runIteratorErase(bst, 472);
+	Treap<int, int> treap;
+	runIteratorErase(treap, 473);
+}
+
+TEST(Erase, AVLStaysBalancedWhileErasing)
+{
+	std::mt19937 rng(474);
+	AVLTree<int, int> tree;
+	std::map<int, int> model;
+	for(int i = 0; i < 2000; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+		model[i] = i;
+	}
+	for(int i = 0; i < 1500; i++)
+	{
+		std::map<int, int>::iterator mit = model.begin();
+		std::advance(mit, rng() % model.size());
+		tree.erase(tree.find(mit->first));
+		model.erase(mit);
+		ASSERT_TRUE(checkAVL(tree)) << i;
+	}
+	EXPECT_TRUE(checkContents(tree, model));
+}
+
+TEST(Erase, PopMinAndMax)
+{
+	std::mt19937 rng(475);
+	AVLTree<int, std::string> tree;
+	std::map<int, std::string> model;
+	for(int round = 0; round < 20000; round++)
+	{
+		int key = static_cast<int>(rng() % 3000);
+		switch(rng() % 4)
+		{
+		case 0:
+			if(!model.empty())
+			{
+				std::pair<int, std::string> item = tree.pop_min();
+				ASSERT_EQ(model.begin()->first, item.first);
+				ASSERT_EQ(model.begin()->second, item.second);
+				model.erase(model.begin());
+			}
+			break;
+		case 1:
+			if(!model.empty())
+			{
+				std::pair<int, std::string> item = tree.pop_max();
+				ASSERT_EQ(model.rbegin()->first, item.first);
+				ASSERT_EQ(model.rbegin()->second, item.second);
+				model.erase(model.rbegin()->first);
+			}
+			break;
+		default:
+			tree.insert(std::make_pair(key, std::to_string(round)));
+			model[key] = std::to_string(round);
+			break;
+		}
+		// begin() comes from the cached leftmost node
+		ASSERT_EQ(model.empty(), tree.begin() == tree.end());
+		if(!model.empty())
+		{
+			ASSERT_EQ(model.begin()->first, tree.begin()->first);
+		}
+	}
+	EXPECT_TRUE(checkAVL(tree));
+	EXPECT_TRUE(checkContents(tree, model));
+
+	while(!tree.empty())
+	{
+		tree.pop_max();
+	}
+	EXPECT_THROW(tree.pop_min(), std::out_of_range);
+	EXPECT_THROW(tree.pop_max(), std::out_of_range);
+	tree.insert(std::make_pair(1, std::string("one")));
+	EXPECT_EQ("one", tree.pop_min().second);
+}
+
+TEST(Erase, RangeEraseMatchesModel)
+{
+	std::mt19937 rng(476);
+	AVLTree<int, int> avl;
+	RBTree<int, int> rb;
+	std::map<int, int> model;
+	avl.setLookupCacheSize(64);
+	avl.enableBloomFilter(5000, 0.01);
+	for(int round = 0; round < 40; round++)
+	{
+		for(int i = 0; i < 400; i++)
+		{
+			int key = static_cast<int>(rng() % 20000);
+			avl.insert(std::make_pair(key, i));
+			rb.insert(std::make_pair(key, i));
+			model[key] = i;
+		}
+		int lo = static_cast<int>(rng() % 21000) - 500;
+		int hi = lo + static_cast<int>(rng() % 4000) - 500;
+		avl.erase(lo, hi);
+		rb.erase(lo, hi);
+		if(lo < hi)
+		{
+			model.erase(model.lower_bound(lo), model.lower_bound(hi));
+		}
+		ASSERT_TRUE(checkAVL(avl)) << round;
+		ASSERT_TRUE(checkContents(avl, model));
+		ASSERT_TRUE(rb.isValidRB());
+		ASSERT_TRUE(checkContents(rb, model));
+		for(int key = lo; key < hi; key += 3)
+		{
+			ASSERT_TRUE(avl.find(key) == avl.end()) << key;
+		}
+	}
+
+	// the whole tree, then the tail
+	avl.erase(avl.find(model.begin()->first), avl.end());
+	EXPECT_TRUE(avl.empty());
+	EXPECT_TRUE(checkAVL(avl));
+	for(int i = 0; i < 100; i++)
+	{
+		avl.insert(std::make_pair(i, i));
+	}
+	avl.erase(avl.find(60), avl.end());
+	avl.erase(avl.begin(), avl.begin());
+	EXPECT_TRUE(checkAVL(avl));
+	EXPECT_EQ(59, avl.pop_max().first);
+}
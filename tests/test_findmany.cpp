@@ -0,0 +1,98 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+// checks find_many against find for random keys, half of them present
+template<typename Tree>
+void checkFindMany(Tree& tree, std::mt19937& rng, int range)
+{
+	std::vector<int> keys;
+	for(int i = 0; i < 5000; i++)
+	{
+		keys.push_back(static_cast<int>(rng() % (2 * range)));
+	}
+	// duplicates and a batch smaller than the lane count
+	keys.push_back(keys[0]);
+	keys.push_back(keys[0]);
+
+	std::vector<typename Tree::iterator> out;
+	tree.find_many(keys, out);
+	ASSERT_EQ(keys.size(), out.size());
+	for(size_t i = 0; i < keys.size(); i++)
+	{
+		ASSERT_TRUE(out[i] == tree.find(keys[i])) << keys[i];
+	}
+
+	std::vector<int> few(keys.begin(), keys.begin() + 3);
+	tree.find_many(few, out);
+	ASSERT_EQ(3u, out.size());
+	for(size_t i = 0; i < few.size(); i++)
+	{
+		ASSERT_TRUE(out[i] == tree.find(few[i]));
+	}
+}
+
+TEST(FindMany, MatchesFind)
+{
+	std::mt19937 rng(42);
+	AVLTree<int, int> avl;
+	RBTree<int, int> rb;
+	BinarySearchTree<int, int> bst;
+	for(int i = 0; i < 10000; i++)
+	{
+		int key = static_cast<int>(rng() % 10000);
+		avl.insert(std::make_pair(key, i));
+		rb.insert(std::make_pair(key, i));
+		bst.insert(std::make_pair(key, i));
+	}
+	checkFindMany(avl, rng, 10000);
+	checkFindMany(rb, rng, 10000);
+	checkFindMany(bst, rng, 10000);
+
+	// with the filter and cache in front
+	avl.enableBloomFilter(10000, 0.01);
+	avl.setLookupCacheSize(256);
+	checkFindMany(avl, rng, 10000);
+	checkFindMany(avl, rng, 10000);
+	EXPECT_GT(avl.bloomFilterStats().rejected, 0u);
+	EXPECT_GT(avl.lookupCacheStats().hits, 0u);
+
+	AVLTree<int, int> empty;
+	std::vector<int> keys(10, 1);
+	std::vector<AVLTree<int, int>::iterator> out;
+	empty.find_many(keys, out);
+	ASSERT_EQ(10u, out.size());
+	EXPECT_TRUE(out[9] == empty.end());
+	empty.find_many(std::vector<int>(), out);
+	EXPECT_TRUE(out.empty());
+}
+
+#ifdef BST_LATENCY
+
+TEST(FindMany, RecordsOneBatchSampleApartFromFind)
+{
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 1000; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	std::vector<int> keys;
+	for(int i = 0; i < 500; i++)
+	{
+		keys.push_back(i * 3);
+	}
+	std::vector<AVLTree<int, int>::iterator> out;
+
+	LatencyRecorder::reset();
+	tree.find_many(keys, out);
+	tree.find_many(keys, out);
+	tree.find(5);
+	std::vector<LatencyHistogram> hists = LatencyRecorder::collect();
+	EXPECT_EQ(2u, hists[LAT_FIND_MANY].count());
+	EXPECT_EQ(1u, hists[LAT_FIND].count());
+}
+
+#endif
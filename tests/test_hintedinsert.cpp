@@ -0,0 +1,115 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+TEST(HintedInsert, AppendsAtEnd)
+{
+	AVLTree<int, int> tree;
+	std::map<int, int> model;
+	for(int i = 0; i < 5000; i++)
+	{
+		AVLTree<int, int>::iterator it = tree.insert(tree.end(), std::make_pair(i * 3, i));
+		model[i * 3] = i;
+		ASSERT_TRUE(it != tree.end());
+		ASSERT_EQ(i * 3, it->first);
+	}
+	EXPECT_TRUE(checkAVL(tree));
+	EXPECT_TRUE(checkContents(tree, model));
+
+	// end() with a key that is not past the maximum still lands right
+	tree.insert(tree.end(), std::make_pair(1, -1));
+	model[1] = -1;
+	tree.insert(tree.end(), std::make_pair(0, -2));
+	model[0] = -2;
+	EXPECT_TRUE(checkAVL(tree));
+	EXPECT_TRUE(checkContents(tree, model));
+}
+
+TEST(HintedInsert, GoodBadAndEqualHints)
+{
+	std::mt19937 rng(33);
+	AVLTree<int, int> tree;
+	std::map<int, int> model;
+	for(int i = 0; i < 1000; i++)
+	{
+		int key = static_cast<int>(rng() % 100000) * 2;
+		tree.insert(std::make_pair(key, i));
+		model[key] = i;
+	}
+
+	for(int i = 0; i < 5000; i++)
+	{
+		std::map<int, int>::iterator near = model.begin();
+		std::advance(near, rng() % model.size());
+		AVLTree<int, int>::iterator hint = tree.find(near->first);
+		int key;
+		switch(rng() % 4)
+		{
+		case 0:
+			key = near->first - 1;     // just before the hint
+			break;
+		case 1:
+			key = near->first + 1;     // just after it
+			break;
+		case 2:
+			key = near->first;         // the hint itself
+			break;
+		default:
+			key = static_cast<int>(rng() % 200000);    // anywhere
+			break;
+		}
+		AVLTree<int, int>::iterator it = tree.insert(hint, std::make_pair(key, i));
+		model[key] = i;
+		ASSERT_TRUE(it != tree.end());
+		ASSERT_EQ(key, it->first);
+		ASSERT_EQ(i, it->second);
+	}
+	EXPECT_TRUE(checkAVL(tree));
+	EXPECT_TRUE(checkContents(tree, model));
+}
+
+TEST(HintedInsert, StringKeysKeepPrefixesValid)
+{
+	// the inline prefixes packed next to the hint must keep descents right
+	AVLTree<std::string, int> tree;
+	std::map<std::string, int> model;
+	for(int i = 0; i < 3000; i++)
+	{
+		std::string key = "order/" + std::to_string(100000 + i);
+		tree.insert(tree.end(), std::make_pair(key, i));
+		model[key] = i;
+	}
+	for(int i = 0; i < 3000; i += 3)
+	{
+		std::string key = "order/" + std::to_string(100000 + i) + "a";
+		tree.insert(tree.find("order/" + std::to_string(100000 + i)), std::make_pair(key, -i));
+		model[key] = -i;
+	}
+	EXPECT_TRUE(checkAVL(tree));
+	EXPECT_TRUE(checkContents(tree, model));
+	EXPECT_TRUE(tree.find("order/100000b") == tree.end());
+}
+
+#ifdef BST_STATS
+
+TEST(HintedInsert, AppendTakesConstantComparisons)
+{
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 1000; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	tree.resetStats();
+	for(int i = 1000; i < 2000; i++)
+	{
+		tree.insert(tree.end(), std::make_pair(i, i));
+	}
+	EXPECT_LE(tree.stats().comparisons, 3u * 1000);
+	EXPECT_EQ(0u, tree.stats().nodeVisits);
+}
+
+#endif
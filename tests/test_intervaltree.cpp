@@ -0,0 +1,115 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <vector>
+
+typedef IntervalTree<int, int> Intervals;
+typedef std::map<Interval<int>, int> IntervalModel;
+
+// checks overlapping(lo, hi) against a scan of every interval in the model
+static testing::AssertionResult checkOverlaps(const Intervals& tree, const IntervalModel& model, int lo, int hi)
+{
+	std::vector<Intervals::iterator> found;
+	tree.overlapping(lo, hi, found);
+	std::vector<Interval<int> > expected;
+	for(IntervalModel::const_iterator it = model.begin(); it != model.end(); ++it)
+	{
+		if(!(it->first.end < lo) && !(hi < it->first.start))
+		{
+			expected.push_back(it->first);
+		}
+	}
+	if(found.size() != expected.size())
+	{
+		return testing::AssertionFailure() << "[" << lo << ", " << hi << "] overlaps " << expected.size()
+			<< " intervals but " << found.size() << " were reported";
+	}
+	for(size_t i = 0; i < found.size(); i++)
+	{
+		if(!(found[i]->first == expected[i]) || found[i]->second != model.at(expected[i]))
+		{
+			return testing::AssertionFailure() << "[" << lo << ", " << hi << "] reported " << found[i]->first
+				<< " where " << expected[i] << " was expected";
+		}
+	}
+	return testing::AssertionSuccess();
+}
+
+TEST(IntervalTree, OverlapsMatchBruteForce)
+{
+	std::mt19937 rng(440);
+	Intervals tree;
+	IntervalModel model;
+	for(int round = 0; round < 10; round++)
+	{
+		for(int i = 0; i < 1000; i++)
+		{
+			int start = static_cast<int>(rng() % 10000);
+			// mostly short intervals with the odd long one
+			int length = rng() % 10 == 0 ? static_cast<int>(rng() % 3000) : static_cast<int>(rng() % 50);
+			if(rng() % 4 == 0 && !model.empty())
+			{
+				IntervalModel::iterator victim = model.lower_bound(Interval<int>(start, 0));
+				if(victim == model.end())
+				{
+					victim = model.begin();
+				}
+				tree.remove(victim->first.start, victim->first.end);
+				model.erase(victim);
+			}
+			else
+			{
+				tree.insert(start, start + length, i);
+				model[Interval<int>(start, start + length)] = i;
+			}
+		}
+		ASSERT_TRUE(checkAggregates(tree));
+		ASSERT_TRUE(checkContents(tree, model));
+		for(int i = 0; i < 200; i++)
+		{
+			int lo = static_cast<int>(rng() % 10200) - 100;
+			int hi = lo + static_cast<int>(rng() % 200);
+			ASSERT_TRUE(checkOverlaps(tree, model, lo, hi));
+			ASSERT_TRUE(checkOverlaps(tree, model, lo, lo));
+		}
+	}
+}
+
+TEST(IntervalTree, EdgesAndBadIntervals)
+{
+	Intervals tree;
+	IntervalModel model;
+	tree.insert(10, 20, 1);
+	tree.insert(20, 30, 2);
+	tree.insert(5, 5, 3);
+	// same start, different end: both are kept
+	tree.insert(10, 12, 4);
+	model[Interval<int>(10, 20)] = 1;
+	model[Interval<int>(20, 30)] = 2;
+	model[Interval<int>(5, 5)] = 3;
+	model[Interval<int>(10, 12)] = 4;
+	ASSERT_TRUE(checkAggregates(tree));
+
+	// closed intervals: touching ends overlap
+	EXPECT_TRUE(checkOverlaps(tree, model, 20, 20));
+	EXPECT_TRUE(checkOverlaps(tree, model, 5, 5));
+	EXPECT_TRUE(checkOverlaps(tree, model, 31, 100));
+	std::vector<Intervals::iterator> found;
+	tree.stabbing(20, found);
+	EXPECT_EQ(2u, found.size());
+	tree.overlapping(30, 10, found);
+	EXPECT_TRUE(found.empty());
+
+	EXPECT_THROW(tree.insert(9, 8, 0), std::invalid_argument);
+	EXPECT_TRUE(checkContents(tree, model));
+
+	tree.remove(10, 20);
+	model.erase(Interval<int>(10, 20));
+	tree.remove(10, 21);
+	ASSERT_TRUE(checkAggregates(tree));
+	EXPECT_TRUE(checkOverlaps(tree, model, 13, 19));
+	EXPECT_TRUE(checkOverlaps(tree, model, 0, 100));
+}
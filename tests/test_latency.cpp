@@ -0,0 +1,120 @@
+#include "check_trees.h"
+#include <latency.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <thread>
+#include <vector>
+
+TEST(LatencyHistogram, BucketsCoverEveryValueWithinSixPercent)
+{
+	EXPECT_EQ(0, LatencyHistogram::bucketOf(0));
+	EXPECT_EQ(31, LatencyHistogram::bucketOf(31));
+	EXPECT_LT(LatencyHistogram::bucketOf(~uint64_t(0)), int(LatencyHistogram::NUM_BUCKETS));
+
+	std::mt19937_64 rng(31);
+	int prevBucket = -1;
+	for(uint64_t ns = 0; ns < 100000; ns++)
+	{
+		int bucket = LatencyHistogram::bucketOf(ns);
+		ASSERT_GE(bucket, prevBucket) << ns;
+		prevBucket = bucket;
+	}
+	for(int i = 0; i < 100000; i++)
+	{
+		uint64_t ns = rng() >> (rng() % 64);
+		uint64_t high = LatencyHistogram::bucketHigh(LatencyHistogram::bucketOf(ns));
+		ASSERT_GE(high, ns);
+		ASSERT_LE(static_cast<double>(high - ns), ns / 16.0 + 1) << ns;
+	}
+}
+
+TEST(LatencyHistogram, PercentilesAndMerge)
+{
+	LatencyHistogram low;
+	LatencyHistogram high;
+	for(uint64_t ns = 1; ns <= 1000; ns++)
+	{
+		low.record(ns);
+		high.record(ns + 1000000);
+	}
+	EXPECT_EQ(1000u, low.count());
+	EXPECT_EQ(1000u, low.max());
+	EXPECT_DOUBLE_EQ(500.5, low.mean());
+	EXPECT_NEAR(500.0, double(low.percentile(50)), 500 / 16.0);
+	EXPECT_NEAR(990.0, double(low.percentile(99)), 990 / 16.0);
+	EXPECT_EQ(1000u, low.percentile(100));
+
+	low.merge(high);
+	EXPECT_EQ(2000u, low.count());
+	EXPECT_EQ(1001000u, low.max());
+	EXPECT_LE(low.percentile(50), 1000u + 1000u / 16);
+	EXPECT_GE(low.percentile(51), 1000000u);
+
+	low.reset();
+	EXPECT_EQ(0u, low.count());
+	EXPECT_EQ(0u, low.percentile(99));
+}
+
+// The trees only record in the tree-tests-stats build (-DBST_LATENCY).
+#ifdef BST_LATENCY
+
+TEST(LatencyRecorder, TreeOperationsRecordOneSampleEach)
+{
+	LatencyRecorder::reset();
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 300; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	for(int i = 0; i < 100; i++)
+	{
+		tree.find(i * 7);
+	}
+	for(int i = 0; i < 50; i++)
+	{
+		tree.remove(i);
+	}
+	int steps = 0;
+	for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		steps++;
+	}
+	tree.clear();
+
+	std::vector<LatencyHistogram> hists = LatencyRecorder::collect();
+	ASSERT_EQ(size_t(LAT_NUM_OPS), hists.size());
+	EXPECT_EQ(300u, hists[LAT_INSERT].count());
+	EXPECT_EQ(100u, hists[LAT_FIND].count());
+	EXPECT_EQ(50u, hists[LAT_REMOVE].count());
+	EXPECT_EQ(uint64_t(steps), hists[LAT_ITERATE].count());
+	EXPECT_EQ(1u, hists[LAT_CLEAR].count());
+}
+
+TEST(LatencyRecorder, KeepsSamplesOfExitedThreads)
+{
+	LatencyRecorder::reset();
+	std::vector<std::thread> threads;
+	for(int t = 0; t < 3; t++)
+	{
+		threads.push_back(std::thread([t]()
+		{
+			AVLTree<int, int> tree;
+			for(int i = 0; i < 100 * (t + 1); i++)
+			{
+				tree.insert(std::make_pair(i, i));
+			}
+		}));
+	}
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+	EXPECT_EQ(600u, LatencyRecorder::collect()[LAT_INSERT].count());
+
+	LatencyRecorder::reset();
+	EXPECT_EQ(0u, LatencyRecorder::collect()[LAT_INSERT].count());
+}
+
+#endif
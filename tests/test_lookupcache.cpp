@@ -0,0 +1,162 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+// a key type with operator< but no std::hash
+struct PlainKey
+{
+	int v;
+	bool operator<(const PlainKey& other) const { return v < other.v; }
+	bool operator==(const PlainKey& other) const { return v == other.v; }
+};
+
+static std::ostream& operator<<(std::ostream& out, const PlainKey& key)
+{
+	return out << key.v;
+}
+
+TEST(LookupCache, RepeatedLookupsHit)
+{
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 1000; i++)
+	{
+		tree.insert(std::make_pair(i, i * 2));
+	}
+	tree.setLookupCacheSize(100);
+	EXPECT_EQ(128u, tree.lookupCache_.size());
+
+	for(int round = 0; round < 10; round++)
+	{
+		for(int i = 0; i < 20; i++)
+		{
+			ASSERT_TRUE(tree.find(i) != tree.end());
+			ASSERT_EQ(i * 2, tree[i]);
+		}
+	}
+	LookupCacheStats stats = tree.lookupCacheStats();
+	EXPECT_EQ(400u, stats.hits + stats.misses);
+	EXPECT_GE(stats.hits, 360u);
+
+	tree.resetLookupCacheStats();
+	EXPECT_EQ(0u, tree.lookupCacheStats().hits);
+
+	tree.setLookupCacheSize(0);
+	tree.find(1);
+	EXPECT_EQ(0u, tree.lookupCacheStats().hits + tree.lookupCacheStats().misses);
+}
+
+TEST(LookupCache, NeverReturnsRemovedNodes)
+{
+	// run under ASan: a stale slot would be a use after free
+	std::mt19937 rng(38);
+	AVLTree<int, int> avl;
+	RBTree<int, int> rb;
+	std::map<int, int> model;
+	avl.setLookupCacheSize(64);
+	rb.setLookupCacheSize(64);
+	for(int i = 0; i < 50000; i++)
+	{
+		int key = static_cast<int>(rng() % 300);
+		switch(rng() % 3)
+		{
+		case 0:
+			avl.remove(key);
+			rb.remove(key);
+			model.erase(key);
+			break;
+		case 1:
+			avl.insert(std::make_pair(key, i));
+			rb.insert(std::make_pair(key, i));
+			model[key] = i;
+			break;
+		default:
+		{
+			AVLTree<int, int>::iterator a = avl.find(key);
+			RBTree<int, int>::iterator r = rb.find(key);
+			if(model.count(key) == 0)
+			{
+				ASSERT_TRUE(a == avl.end());
+				ASSERT_TRUE(r == rb.end());
+			}
+			else
+			{
+				ASSERT_TRUE(a != avl.end() && a->second == model[key]);
+				ASSERT_TRUE(r != rb.end() && r->second == model[key]);
+			}
+			break;
+		}
+		}
+	}
+	EXPECT_TRUE(checkAVL(avl));
+	EXPECT_TRUE(rb.isValidRB());
+	EXPECT_TRUE(checkContents(avl, model));
+	EXPECT_TRUE(checkContents(rb, model));
+	EXPECT_GT(avl.lookupCacheStats().hits, 0u);
+
+	avl.clear();
+	EXPECT_TRUE(avl.find(model.begin()->first) == avl.end());
+}
+
+TEST(LookupCache, TreapSplitDropsMovedNodes)
+{
+	Treap<int, int> tree;
+	for(int i = 0; i < 100; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	tree.setLookupCacheSize(32);
+	for(int i = 0; i < 100; i++)
+	{
+		tree.find(i);
+	}
+	Treap<int, int> greater;
+	tree.split(50, greater);
+	for(int i = 50; i < 100; i++)
+	{
+		EXPECT_TRUE(tree.find(i) == tree.end()) << i;
+	}
+	EXPECT_TRUE(tree.find(10) != tree.end());
+}
+
+TEST(LookupCache, NeedsAHash)
+{
+	AVLTree<PlainKey, int> tree;
+	EXPECT_THROW(tree.setLookupCacheSize(16), std::invalid_argument);
+	tree.setLookupCacheSize(0);
+	PlainKey key = { 3 };
+	tree.insert(std::make_pair(key, 1));
+	EXPECT_TRUE(tree.find(key) != tree.end());
+}
+
+TEST(LookupCache, SplayTreeRepeatedLookupsHit)
+{
+	SplayTree<int, int> tree;
+	std::map<int, int> model;
+	for(int i = 0; i < 1000; i++)
+	{
+		tree.insert(std::make_pair(i, i * 2));
+		model[i] = i * 2;
+	}
+	tree.setLookupCacheSize(64);
+	for(int round = 0; round < 10; round++)
+	{
+		ASSERT_TRUE(tree.find(4) != tree.end());
+		ASSERT_EQ(8, tree[4]);
+	}
+	LookupCacheStats stats = tree.lookupCacheStats();
+	EXPECT_EQ(1u, stats.misses);
+	EXPECT_EQ(19u, stats.hits);
+
+	// nodes splayed around under the cache are still found, removed ones not
+	for(int i = 0; i < 1000; i += 3)
+	{
+		tree.remove(i);
+		model.erase(i);
+		ASSERT_TRUE(tree.find(i) == tree.end());
+	}
+	EXPECT_TRUE(checkLinks(tree.root_));
+	EXPECT_TRUE(checkContents(tree, model));
+}
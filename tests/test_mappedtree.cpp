@@ -0,0 +1,161 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+
+typedef MappedTree<int, double> Mapped;
+
+// overwrites sizeof(T) bytes of the file at offset
+template<typename T>
+void patchFile(const std::string& path, uint64_t offset, const T& item)
+{
+	std::fstream file(path.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+	file.seekp(static_cast<std::streamoff>(offset));
+	file.write(reinterpret_cast<const char*>(&item), sizeof(item));
+}
+
+// file offset of the entry with index i
+static uint64_t entryOffset(const Mapped& tree, uint64_t i)
+{
+	return tree.header_->entriesOffset + i * sizeof(Mapped::Entry);
+}
+
+TEST(MappedTree, RoundTripMatchesModel)
+{
+	TempDir dir;
+	std::string path = dir.path() + "/tree.map";
+
+	std::mt19937 rng(27);
+	AVLTree<int, double> source;
+	std::map<int, double> model;
+	for(int i = 0; i < 10000; i++)
+	{
+		int key = static_cast<int>(rng() % 100000) * 2;
+		source.insert(std::make_pair(key, key / 4.0));
+		model[key] = key / 4.0;
+	}
+	Mapped::write(path, source);
+
+	Mapped tree(path);
+	ASSERT_EQ(model.size(), tree.size());
+	EXPECT_FALSE(tree.empty());
+
+	std::map<int, double>::const_iterator expected = model.begin();
+	for(Mapped::iterator it = tree.begin(); it != tree.end(); ++it, ++expected)
+	{
+		ASSERT_EQ(expected->first, it->first);
+		ASSERT_EQ(expected->second, it->second);
+	}
+
+	for(int probe = -3; probe < 200003; probe += 7)
+	{
+		std::map<int, double>::const_iterator hit = model.find(probe);
+		Mapped::iterator found = tree.find(probe);
+		if(hit == model.end())
+		{
+			EXPECT_TRUE(found == tree.end()) << probe;
+		}
+		else
+		{
+			ASSERT_TRUE(found != tree.end()) << probe;
+			EXPECT_EQ(hit->second, found->second);
+		}
+
+		std::map<int, double>::const_iterator lb = model.lower_bound(probe);
+		Mapped::iterator mlb = tree.lower_bound(probe);
+		if(lb == model.end())
+		{
+			EXPECT_TRUE(mlb == tree.end()) << probe;
+		}
+		else
+		{
+			ASSERT_TRUE(mlb != tree.end()) << probe;
+			EXPECT_EQ(lb->first, mlb->first);
+		}
+	}
+}
+
+TEST(MappedTree, EmptyTree)
+{
+	TempDir dir;
+	std::string path = dir.path() + "/empty.map";
+	AVLTree<int, double> source;
+	Mapped::write(path, source);
+
+	Mapped tree(path);
+	EXPECT_TRUE(tree.empty());
+	EXPECT_TRUE(tree.begin() == tree.end());
+	EXPECT_TRUE(tree.find(1) == tree.end());
+	EXPECT_TRUE(tree.lower_bound(1) == tree.end());
+}
+
+TEST(MappedTree, RejectsOtherTypesAndTruncation)
+{
+	TempDir dir;
+	std::string path = dir.path() + "/tree.map";
+	std::map<int, double> items;
+	for(int i = 0; i < 100; i++)
+	{
+		items[i] = i;
+	}
+	Mapped::write(path, items.begin(), items.end());
+
+	// same sizes, different types
+	typedef MappedTree<float, int64_t> Other;
+	EXPECT_THROW(Other other(path), std::runtime_error);
+	EXPECT_THROW(Mapped missing(dir.path() + "/missing.map"), std::runtime_error);
+
+	ASSERT_EQ(0, ::truncate(path.c_str(), 64 + 50 * sizeof(Mapped::Entry)));
+	EXPECT_THROW(Mapped truncated(path), std::runtime_error);
+}
+
+TEST(MappedTree, CorruptOffsetsThrowInsteadOfCrashing)
+{
+	TempDir dir;
+	std::string path = dir.path() + "/tree.map";
+	std::map<int, double> items;
+	for(int i = 0; i < 1000; i++)
+	{
+		items[i] = i;
+	}
+	Mapped::write(path, items.begin(), items.end());
+
+	uint64_t rootOffset;
+	uint64_t leftAt;
+	{
+		Mapped tree(path);
+		rootOffset = tree.header_->rootOffset;
+		leftAt = rootOffset + offsetof(Mapped::Entry, left);
+	}
+
+	// past the end of the file, off an entry boundary, and back at the root
+	uint64_t bad[] = { uint64_t(1) << 40, rootOffset + 1, rootOffset };
+	for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+	{
+		patchFile(path, leftAt, bad[i]);
+		Mapped tree(path);
+		EXPECT_THROW(tree.find(3), std::runtime_error) << i;
+		EXPECT_THROW(tree.lower_bound(3), std::runtime_error) << i;
+		// the other half of the tree is still intact
+		ASSERT_TRUE(tree.find(900) != tree.end());
+		EXPECT_EQ(900.0, tree.find(900)->second);
+	}
+
+	// a right child pointing into the left half
+	{
+		Mapped tree(path);
+		uint64_t rightAt = rootOffset + offsetof(Mapped::Entry, right);
+		patchFile(path, rightAt, entryOffset(tree, 10));
+	}
+	Mapped tree(path);
+	EXPECT_THROW(tree.find(900), std::runtime_error);
+
+	// a root offset outside the entries is caught on open
+	uint64_t headerRoot = offsetof(Mapped::Header, rootOffset);
+	patchFile(path, headerRoot, uint64_t(8));
+	EXPECT_THROW(Mapped reopened(path), std::runtime_error);
+}
@@ -0,0 +1,177 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+typedef AVLMultiTree<int, int> MultiTree;
+typedef std::multimap<int, int> MultiModel;
+
+// the tree iterators have no iterator_traits, so no std::advance
+static MultiTree::iterator stepped(MultiTree::iterator it, size_t steps)
+{
+	for(; steps > 0; steps--)
+	{
+		++it;
+	}
+	return it;
+}
+
+// count(), find() and equal_range() for key agree with the model
+static testing::AssertionResult checkKey(const MultiTree& tree, const MultiModel& model, int key)
+{
+	if(tree.count(key) != model.count(key))
+	{
+		return testing::AssertionFailure() << "count(" << key << ") is " << tree.count(key)
+			<< " instead of " << model.count(key);
+	}
+	std::pair<MultiTree::iterator, MultiTree::iterator> range = tree.equal_range(key);
+	std::pair<MultiModel::const_iterator, MultiModel::const_iterator> expected = model.equal_range(key);
+	if(range.first != tree.find(key) && expected.first != expected.second)
+	{
+		return testing::AssertionFailure() << "find(" << key << ") is not the start of its equal range";
+	}
+	for(; expected.first != expected.second; ++expected.first, ++range.first)
+	{
+		if(range.first == range.second || range.first->second != expected.first->second)
+		{
+			return testing::AssertionFailure() << "equal_range(" << key << ") differs from the model";
+		}
+	}
+	if(range.first != range.second)
+	{
+		return testing::AssertionFailure() << "equal_range(" << key << ") is too long";
+	}
+	return testing::AssertionSuccess();
+}
+
+TEST(MultiTree, RandomOperationsMatchMultimap)
+{
+	std::mt19937 rng(480);
+	MultiTree tree;
+	MultiModel model;
+	tree.setLookupCacheSize(64);
+	for(int round = 0; round < 20; round++)
+	{
+		for(int i = 0; i < 1000; i++)
+		{
+			// few distinct keys, so runs of duplicates are long
+			int key = static_cast<int>(rng() % 200);
+			switch(rng() % 8)
+			{
+			case 0:
+				ASSERT_EQ(model.erase(key), tree.erase(key));
+				break;
+			case 1:
+			{
+				// one item from the middle of a run
+				MultiModel::iterator mit = model.find(key);
+				if(mit != model.end())
+				{
+					size_t skip = rng() % model.count(key);
+					std::advance(mit, skip);
+					tree.erase(stepped(tree.find(key), skip));
+					model.erase(mit);
+				}
+				break;
+			}
+			case 2:
+			{
+				MultiTree::node_type handle = tree.extract(key);
+				MultiModel::iterator mit = model.find(key);
+				ASSERT_EQ(mit != model.end(), bool(handle));
+				if(handle)
+				{
+					// the oldest one comes out, and goes back in as the newest
+					ASSERT_EQ(model.lower_bound(key)->second, handle.mapped());
+					model.erase(model.lower_bound(key));
+					model.insert(std::make_pair(key, handle.mapped()));
+					tree.insert(std::move(handle));
+				}
+				break;
+			}
+			case 3:
+				tree.insert(tree.find(key), std::make_pair(key, round * 1000 + i));
+				model.insert(std::make_pair(key, round * 1000 + i));
+				break;
+			default:
+				tree.insert(std::make_pair(key, round * 1000 + i));
+				model.insert(std::make_pair(key, round * 1000 + i));
+				break;
+			}
+		}
+		ASSERT_TRUE(checkAVL(tree, true));
+		ASSERT_TRUE(checkContents(tree, model));
+		for(int key = -1; key <= 200; key++)
+		{
+			ASSERT_TRUE(checkKey(tree, model, key));
+		}
+	}
+}
+
+TEST(MultiTree, RangeEraseSplitsRuns)
+{
+	std::mt19937 rng(481);
+	for(int round = 0; round < 200; round++)
+	{
+		MultiTree tree;
+		MultiModel model;
+		for(int i = 0; i < 300; i++)
+		{
+			int key = static_cast<int>(rng() % 20);
+			tree.insert(std::make_pair(key, i));
+			model.insert(std::make_pair(key, i));
+		}
+		// arbitrary positions, usually inside runs of equal keys
+		size_t from = rng() % (model.size() + 1);
+		size_t to = from + rng() % (model.size() - from + 1);
+		MultiModel::iterator mfirst = model.begin();
+		MultiModel::iterator mlast = model.begin();
+		std::advance(mfirst, from);
+		std::advance(mlast, to);
+		tree.erase(stepped(tree.begin(), from), stepped(tree.begin(), to));
+		model.erase(mfirst, mlast);
+		ASSERT_TRUE(checkAVL(tree, true)) << round;
+		ASSERT_TRUE(checkContents(tree, model)) << round;
+	}
+}
+
+TEST(MultiTree, LongRunsAndMerge)
+{
+	MultiTree tree;
+	MultiModel model;
+	// longer than MULTI_ERASE_UNLINK_MAX, so erase(key) cuts the run out
+	for(int i = 0; i < 100; i++)
+	{
+		for(int key = 0; key < 3; key++)
+		{
+			tree.insert(std::make_pair(key, i));
+			model.insert(std::make_pair(key, i));
+		}
+	}
+	EXPECT_EQ(100u, tree.erase(1));
+	model.erase(1);
+	EXPECT_TRUE(checkAVL(tree, true));
+	EXPECT_TRUE(checkContents(tree, model));
+	EXPECT_EQ(0u, tree.erase(1));
+	tree.remove(0);
+	model.erase(0);
+	EXPECT_TRUE(checkContents(tree, model));
+
+	// merge moves every node, duplicates included, after the existing ones
+	MultiTree other;
+	for(int i = 0; i < 10; i++)
+	{
+		other.insert(std::make_pair(2, -i));
+		other.insert(std::make_pair(5, i));
+		model.insert(std::make_pair(2, -i));
+		model.insert(std::make_pair(5, i));
+	}
+	tree.merge(other);
+	EXPECT_TRUE(other.empty());
+	EXPECT_TRUE(checkAVL(tree, true));
+	EXPECT_TRUE(checkContents(tree, model));
+	EXPECT_TRUE(checkKey(tree, model, 2));
+	EXPECT_TRUE(checkKey(tree, model, 5));
+}
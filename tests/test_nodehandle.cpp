@@ -0,0 +1,194 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+TEST(NodeHandle, ExtractAndReinsertKeepTheNode)
+{
+	AVLTree<int, std::string> tree;
+	for(int i = 0; i < 100; i++)
+	{
+		tree.insert(std::make_pair(i, std::to_string(i)));
+	}
+	AVLTree<int, std::string>::iterator it = tree.find(42);
+	const std::string* address = &it->second;
+
+	AVLTree<int, std::string>::node_type handle = tree.extract(42);
+	ASSERT_FALSE(handle.empty());
+	ASSERT_TRUE(bool(handle));
+	EXPECT_EQ(42, handle.key());
+	EXPECT_EQ("42", handle.mapped());
+	EXPECT_TRUE(tree.find(42) == tree.end());
+	EXPECT_TRUE(checkAVL(tree));
+
+	// the value can change while the node is out, and the node comes back
+	handle.mapped() = "forty-two";
+	AVLTree<int, std::string> other;
+	AVLTree<int, std::string>::iterator moved = other.insert(std::move(handle));
+	EXPECT_TRUE(handle.empty());
+	ASSERT_TRUE(moved != other.end());
+	EXPECT_EQ(address, &moved->second);
+	EXPECT_EQ("forty-two", other[42]);
+	EXPECT_TRUE(checkAVL(other));
+
+	// an empty handle, and missing keys
+	EXPECT_TRUE(tree.extract(1000).empty());
+	EXPECT_TRUE(tree.extract(tree.end()).empty());
+	EXPECT_TRUE(tree.insert(AVLTree<int, std::string>::node_type()) == tree.end());
+
+	// a key that is already there stays in the handle
+	handle = tree.extract(tree.find(7));
+	tree.insert(std::make_pair(7, std::string("new")));
+	AVLTree<int, std::string>::iterator existing = tree.insert(std::move(handle));
+	EXPECT_FALSE(handle.empty());
+	EXPECT_EQ("new", existing->second);
+	EXPECT_EQ("7", handle.mapped());
+	// and is freed with it (ASan reports a leak otherwise)
+}
+
+TEST(NodeHandle, RandomExtractsMatchModel)
+{
+	std::mt19937 rng(460);
+	AVLTree<int, int> a;
+	AVLTree<int, int> b;
+	std::map<int, int> modelA;
+	std::map<int, int> modelB;
+	a.setLookupCacheSize(64);
+	b.enableBloomFilter(2000, 0.01);
+	for(int i = 0; i < 20000; i++)
+	{
+		int key = static_cast<int>(rng() % 2000);
+		switch(rng() % 3)
+		{
+		case 0:
+			a.insert(std::make_pair(key, i));
+			modelA[key] = i;
+			break;
+		case 1:
+		{
+			// a to b
+			AVLTree<int, int>::node_type handle = a.extract(key);
+			if(handle)
+			{
+				int value = modelA[key];
+				modelA.erase(key);
+				if(modelB.insert(std::make_pair(key, value)).second)
+				{
+					ASSERT_TRUE(b.insert(std::move(handle)) != b.end());
+					ASSERT_TRUE(handle.empty());
+				}
+				else
+				{
+					b.insert(std::move(handle));
+					ASSERT_FALSE(handle.empty());
+				}
+			}
+			break;
+		}
+		default:
+		{
+			AVLTree<int, int>::iterator it = b.find(key);
+			AVLTree<int, int>::node_type handle = b.extract(it);
+			ASSERT_EQ(modelB.count(key) != 0, bool(handle));
+			if(handle)
+			{
+				modelA[key] = modelB[key];
+				modelB.erase(key);
+				a.extract(key);
+				a.insert(std::move(handle));
+			}
+			break;
+		}
+		}
+	}
+	EXPECT_TRUE(checkAVL(a));
+	EXPECT_TRUE(checkAVL(b));
+	EXPECT_TRUE(checkContents(a, modelA));
+	EXPECT_TRUE(checkContents(b, modelB));
+	for(int key = 0; key < 2000; key++)
+	{
+		ASSERT_EQ(modelA.count(key) != 0, a.find(key) != a.end()) << key;
+		ASSERT_EQ(modelB.count(key) != 0, b.find(key) != b.end()) << key;
+	}
+}
+
+TEST(NodeHandle, MergeMovesOnlyNewKeys)
+{
+	std::mt19937 rng(461);
+	AVLTree<int, int> a;
+	AVLTree<int, int> b;
+	std::map<int, int> modelA;
+	std::map<int, int> modelB;
+	for(int i = 0; i < 3000; i++)
+	{
+		int key = static_cast<int>(rng() % 5000);
+		if(rng() % 2 == 0)
+		{
+			a.insert(std::make_pair(key, i));
+			modelA[key] = i;
+		}
+		else
+		{
+			b.insert(std::make_pair(key, i));
+			modelB[key] = i;
+		}
+	}
+	a.merge(b);
+	std::map<int, int> leftover;
+	for(std::map<int, int>::iterator it = modelB.begin(); it != modelB.end(); ++it)
+	{
+		if(!modelA.insert(*it).second)
+		{
+			leftover.insert(*it);
+		}
+	}
+	EXPECT_TRUE(checkAVL(a));
+	EXPECT_TRUE(checkAVL(b));
+	EXPECT_TRUE(checkContents(a, modelA));
+	EXPECT_TRUE(checkContents(b, leftover));
+
+	a.merge(a);
+	EXPECT_TRUE(checkContents(a, modelA));
+
+	// nodes of another tree type have another layout
+	AggregateAVLTree<int, int, SumMonoid<int> > sums;
+	sums.insert(std::make_pair(1, 1));
+	EXPECT_THROW(a.merge(sums), std::invalid_argument);
+	AVLTree<int, int>::node_type foreign = sums.extract(1);
+	EXPECT_THROW(a.insert(std::move(foreign)), std::invalid_argument);
+	EXPECT_FALSE(foreign.empty());
+}
+
+TEST(NodeHandle, SplitAndJoin)
+{
+	AVLTree<int, int> tree;
+	std::map<int, int> model;
+	for(int i = 0; i < 1000; i++)
+	{
+		tree.insert(std::make_pair(i * 2, i));
+		model[i * 2] = i;
+	}
+	AVLTree<int, int> greater;
+	tree.split(777, greater);
+	std::map<int, int> modelGreater(model.lower_bound(777), model.end());
+	model.erase(model.lower_bound(777), model.end());
+	EXPECT_TRUE(checkAVL(tree));
+	EXPECT_TRUE(checkAVL(greater));
+	EXPECT_TRUE(checkContents(tree, model));
+	EXPECT_TRUE(checkContents(greater, modelGreater));
+	EXPECT_THROW(tree.split(5, greater), std::invalid_argument);
+
+	// join works in either order
+	greater.join(tree);
+	model.insert(modelGreater.begin(), modelGreater.end());
+	EXPECT_TRUE(tree.empty());
+	EXPECT_TRUE(checkAVL(greater));
+	EXPECT_TRUE(checkContents(greater, model));
+
+	AVLTree<int, int> overlapping;
+	overlapping.insert(std::make_pair(500, 0));
+	EXPECT_THROW(greater.join(overlapping), std::invalid_argument);
+}
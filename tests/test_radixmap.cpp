@@ -0,0 +1,166 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+/* Walks an OrderedRadixMap: every inner node holds at least two and at
+   most its capacity of children, the stored counts match, and the number
+   of leaves is size(). Counts the nodes of each type into types.
+*/
+template<typename Key, typename Value>
+testing::AssertionResult checkRadix(OrderedRadixMap<Key, Value>& map, size_t types[5])
+{
+	for(int i = 0; i < 5; i++)
+	{
+		types[i] = 0;
+	}
+	std::vector<RadixNode*> stack;
+	if(map.root_ != nullptr)
+	{
+		stack.push_back(map.root_);
+	}
+	while(!stack.empty())
+	{
+		RadixNode* node = stack.back();
+		stack.pop_back();
+		types[node->type_]++;
+		if(node->type_ == RadixNode::LEAF)
+		{
+			continue;
+		}
+		RadixInnerNode* inner = static_cast<RadixInnerNode*>(node);
+		static const int capacity[] = { 0, 4, 16, 48, 256 };
+		int children = 0;
+		for(int pos = 0; pos < 256; pos++)
+		{
+			bool used = false;
+			switch(node->type_)
+			{
+			case RadixNode::NODE4:
+			case RadixNode::NODE16:
+				used = pos < inner->count_;
+				break;
+			case RadixNode::NODE48:
+				used = static_cast<RadixNode48*>(node)->index_[pos] != 0;
+				break;
+			default:
+				used = static_cast<RadixNode256*>(node)->children_[pos] != nullptr;
+				break;
+			}
+			if(used)
+			{
+				children++;
+				stack.push_back(*OrderedRadixMap<Key, Value>::childAt(inner, pos));
+			}
+		}
+		if(children != inner->count_)
+		{
+			return testing::AssertionFailure() << "Node stores count " << inner->count_ << " but has " << children << " children";
+		}
+		if(children < 2 || children > capacity[node->type_])
+		{
+			return testing::AssertionFailure() << "Node of type " << int(node->type_) << " has " << children << " children";
+		}
+	}
+	if(types[RadixNode::LEAF] != map.size())
+	{
+		return testing::AssertionFailure() << types[RadixNode::LEAF] << " leaves for size " << map.size();
+	}
+	return testing::AssertionSuccess();
+}
+
+template<typename Key>
+void runRadixModel(unsigned seed, uint64_t range, int64_t offset)
+{
+	std::mt19937_64 rng(seed);
+	OrderedRadixMap<Key, int> map;
+	std::map<Key, int> model;
+	size_t types[5];
+	for(int round = 0; round < 10; round++)
+	{
+		for(int i = 0; i < 3000; i++)
+		{
+			Key key = static_cast<Key>(static_cast<int64_t>(rng() % range) + offset);
+			if(rng() % 3 == 0)
+			{
+				map.remove(key);
+				model.erase(key);
+			}
+			else
+			{
+				map.insert(std::make_pair(key, i));
+				model[key] = i;
+			}
+		}
+		ASSERT_EQ(model.size(), map.size());
+		ASSERT_TRUE(checkRadix(map, types));
+		ASSERT_TRUE(checkContents(map, model));
+	}
+	for(int i = 0; i < 2000; i++)
+	{
+		Key key = static_cast<Key>(static_cast<int64_t>(rng() % range) + offset);
+		typename std::map<Key, int>::iterator lb = model.lower_bound(key);
+		typename OrderedRadixMap<Key, int>::iterator mlb = map.lower_bound(key);
+		ASSERT_EQ(lb == model.end(), mlb == map.end());
+		if(lb != model.end())
+		{
+			ASSERT_EQ(lb->first, mlb->first);
+		}
+	}
+}
+
+TEST(RadixMap, RandomOperationsMatchModel)
+{
+	runRadixModel<int64_t>(41, uint64_t(1) << 40, -(int64_t(1) << 39));
+	runRadixModel<int32_t>(42, 5000, -2500);
+	runRadixModel<uint16_t>(43, 60000, 0);
+	runRadixModel<int8_t>(44, 256, -128);
+}
+
+TEST(RadixMap, NodesGrowAndShrink)
+{
+	OrderedRadixMap<uint32_t, int> map;
+	std::map<uint32_t, int> model;
+	size_t types[5];
+	// 256 siblings under one parent go through every node size
+	for(uint32_t i = 0; i < 256; i++)
+	{
+		map.insert(std::make_pair(0x1200 + i, int(i)));
+		model[0x1200 + i] = int(i);
+		ASSERT_TRUE(checkRadix(map, types)) << i;
+		if(i == 3)
+		{
+			EXPECT_EQ(1u, types[RadixNode::NODE4]);
+		}
+		if(i == 15)
+		{
+			EXPECT_EQ(1u, types[RadixNode::NODE16]);
+		}
+		if(i == 47)
+		{
+			EXPECT_EQ(1u, types[RadixNode::NODE48]);
+		}
+	}
+	EXPECT_EQ(1u, types[RadixNode::NODE256]);
+	EXPECT_TRUE(checkContents(map, model));
+
+	for(uint32_t i = 255; i > 0; i--)
+	{
+		map.remove(0x1200 + i);
+		model.erase(0x1200 + i);
+		ASSERT_TRUE(checkRadix(map, types)) << i;
+	}
+	// a single key is just its leaf
+	EXPECT_EQ(1u, types[RadixNode::LEAF]);
+	EXPECT_EQ(0u, types[RadixNode::NODE4] + types[RadixNode::NODE16] + types[RadixNode::NODE48] + types[RadixNode::NODE256]);
+	EXPECT_TRUE(checkContents(map, model));
+
+	EXPECT_EQ(0, map[0x1200]);
+	EXPECT_THROW(map[7], std::out_of_range);
+	map.clear();
+	EXPECT_TRUE(map.empty());
+	EXPECT_EQ(0u, map.size());
+	EXPECT_TRUE(map.begin() == map.end());
+}
@@ -0,0 +1,98 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <map>
+#include <random>
+
+// height of the subtree, counting nodes
+template<typename Key, typename Value>
+int heightOf(Node<Key, Value>* node)
+{
+	if(node == nullptr)
+	{
+		return 0;
+	}
+	return 1 + std::max(heightOf(node->getLeft()), heightOf(node->getRight()));
+}
+
+TEST(RBTree, RandomOperationsKeepInvariants)
+{
+	std::mt19937 rng(35);
+	RBTree<int, int> tree;
+	std::map<int, int> model;
+	for(int round = 0; round < 30; round++)
+	{
+		for(int i = 0; i < 1000; i++)
+		{
+			int key = static_cast<int>(rng() % 4000);
+			if(rng() % 5 < 2)
+			{
+				tree.remove(key);
+				model.erase(key);
+			}
+			else
+			{
+				tree.insert(std::make_pair(key, i));
+				model[key] = i;
+			}
+		}
+		ASSERT_TRUE(tree.isValidRB()) << round;
+		ASSERT_TRUE(checkLinks(tree.root_));
+		ASSERT_TRUE(checkContents(tree, model));
+		ASSERT_LE(heightOf(tree.root_), 2 * std::log2(model.size() + 1.0));
+	}
+
+	while(!model.empty())
+	{
+		tree.remove(model.begin()->first);
+		model.erase(model.begin());
+		ASSERT_TRUE(tree.isValidRB());
+	}
+	EXPECT_TRUE(tree.empty());
+}
+
+TEST(RBTree, SortedInsertsStayShallow)
+{
+	RBTree<int, int> up;
+	RBTree<int, int> down;
+	for(int i = 0; i < 1 << 14; i++)
+	{
+		up.insert(std::make_pair(i, i));
+		down.insert(std::make_pair(-i, i));
+	}
+	EXPECT_TRUE(up.isValidRB());
+	EXPECT_TRUE(down.isValidRB());
+	EXPECT_TRUE(checkLinks(up.root_));
+	EXPECT_TRUE(checkLinks(down.root_));
+	EXPECT_LE(heightOf(up.root_), 28);
+	EXPECT_LE(heightOf(down.root_), 28);
+}
+
+TEST(RBTree, ValidityCheckCatchesBrokenTrees)
+{
+	RBTree<int, int> tree;
+	for(int i = 0; i < 100; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	ASSERT_TRUE(tree.isValidRB());
+
+	RBNode<int, int>* root = static_cast<RBNode<int, int>*>(tree.root_);
+	root->setColor(RBNode<int, int>::RED);
+	EXPECT_FALSE(tree.isValidRB());
+	root->setColor(RBNode<int, int>::BLACK);
+
+	// the leftmost path loses or gains a black node
+	RBNode<int, int>* node = root;
+	while(node->getLeft() != nullptr)
+	{
+		node = node->getLeft();
+	}
+	RBNode<int, int>::Color old = node->getColor();
+	node->setColor(old == RBNode<int, int>::RED ? RBNode<int, int>::BLACK : RBNode<int, int>::RED);
+	EXPECT_FALSE(tree.isValidRB());
+	node->setColor(old);
+	EXPECT_TRUE(tree.isValidRB());
+}
@@ -0,0 +1,93 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <map>
+#include <random>
+
+// height of the subtree, counting nodes
+template<typename Key, typename Value>
+int scapegoatHeight(Node<Key, Value>* node)
+{
+	if(node == nullptr)
+	{
+		return 0;
+	}
+	return 1 + std::max(scapegoatHeight(node->getLeft()), scapegoatHeight(node->getRight()));
+}
+
+// the depth bound the tree maintains, in nodes
+static int heightBound(const ScapegoatTree<int, int>& tree)
+{
+	return static_cast<int>(std::log(static_cast<double>(tree.maxSize_) + 1) / tree.logInvAlpha_) + 2;
+}
+
+TEST(Scapegoat, RandomOperationsMatchModel)
+{
+	double alphas[] = { 0.55, 2.0 / 3.0, 0.9 };
+	for(size_t a = 0; a < 3; a++)
+	{
+		std::mt19937 rng(36 + a);
+		ScapegoatTree<int, int> tree(alphas[a]);
+		std::map<int, int> model;
+		for(int round = 0; round < 20; round++)
+		{
+			for(int i = 0; i < 1000; i++)
+			{
+				int key = static_cast<int>(rng() % 3000);
+				if(rng() % 3 == 0)
+				{
+					tree.remove(key);
+					model.erase(key);
+				}
+				else
+				{
+					tree.insert(std::make_pair(key, i));
+					model[key] = i;
+				}
+			}
+			ASSERT_EQ(model.size(), tree.size());
+			ASSERT_TRUE(checkLinks(tree.root_));
+			ASSERT_TRUE(checkContents(tree, model));
+			ASSERT_LE(scapegoatHeight(tree.root_), heightBound(tree)) << alphas[a];
+		}
+	}
+}
+
+TEST(Scapegoat, SortedInsertsAndMassRemoval)
+{
+	ScapegoatTree<int, int> tree;
+	std::map<int, int> model;
+	for(int i = 0; i < 20000; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+		model[i] = i;
+	}
+	EXPECT_LE(scapegoatHeight(tree.root_), heightBound(tree));
+	EXPECT_TRUE(checkLinks(tree.root_));
+
+	// shrinking below alpha * maxSize rebuilds the whole tree
+	for(int i = 0; i < 19000; i++)
+	{
+		tree.remove(i);
+		model.erase(i);
+	}
+	EXPECT_EQ(1000u, tree.size());
+	EXPECT_LE(tree.maxSize_, 1500u);
+	EXPECT_LE(scapegoatHeight(tree.root_), heightBound(tree));
+	EXPECT_TRUE(checkLinks(tree.root_));
+	EXPECT_TRUE(checkContents(tree, model));
+
+	tree.clear();
+	EXPECT_EQ(0u, tree.size());
+	tree.insert(std::make_pair(1, 1));
+	EXPECT_EQ(1u, tree.size());
+}
+
+TEST(Scapegoat, RejectsBadAlpha)
+{
+	typedef ScapegoatTree<int, int> Tree;
+	EXPECT_THROW(Tree half(0.5), std::invalid_argument);
+	EXPECT_THROW(Tree one(1.0), std::invalid_argument);
+}
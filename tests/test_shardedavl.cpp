@@ -0,0 +1,260 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+typedef ShardedAVLTree<int, int> Sharded;
+
+/* Verifies every shard: a valid AVL tree holding only keys inside its
+   bounds, with a stored count that matches. Only call it while no other
+   thread uses the table.
+*/
+static testing::AssertionResult checkShards(Sharded& table)
+{
+	const std::vector<int>& bounds = table.layout_->bounds;
+	if(bounds.size() + 1 != table.shards())
+	{
+		return testing::AssertionFailure() << bounds.size() << " bounds for " << table.shards() << " shards";
+	}
+	for(size_t i = 0; i < table.shards(); i++)
+	{
+		if(i > 0 && i < bounds.size() && !(bounds[i - 1] < bounds[i]))
+		{
+			return testing::AssertionFailure() << "Bounds " << i - 1 << " and " << i << " are out of order";
+		}
+		AVLTree<int, int>& tree = table.shards_[i]->tree;
+		testing::AssertionResult result = checkAVL(tree);
+		if(!result)
+		{
+			return result << " (shard " << i << ")";
+		}
+		size_t n = 0;
+		for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it, n++)
+		{
+			if((i > 0 && it->first < bounds[i - 1]) || (i < bounds.size() && !(it->first < bounds[i])))
+			{
+				return testing::AssertionFailure() << "Key " << it->first << " is outside shard " << i;
+			}
+		}
+		if(n != table.shards_[i]->size)
+		{
+			return testing::AssertionFailure() << "Shard " << i << " counts " << table.shards_[i]->size << " items but holds " << n;
+		}
+	}
+	return testing::AssertionSuccess();
+}
+
+// collects what for_each visits
+struct Collect
+{
+	std::vector<std::pair<int, int> >* items;
+	void operator()(const std::pair<const int, int>& item) const { items->push_back(item); }
+};
+
+static testing::AssertionResult checkTableContents(const Sharded& table, const std::map<int, int>& model)
+{
+	std::vector<std::pair<int, int> > items;
+	Collect collect = { &items };
+	table.for_each(collect);
+	if(std::vector<std::pair<int, int> >(model.begin(), model.end()) != items)
+	{
+		return testing::AssertionFailure() << "for_each visits " << items.size() << " items, not the model's " << model.size();
+	}
+	if(table.size() != model.size())
+	{
+		return testing::AssertionFailure() << "size() is " << table.size() << " for " << model.size() << " items";
+	}
+	return testing::AssertionSuccess();
+}
+
+static std::vector<int> evenSplits(int shards, int range)
+{
+	std::vector<int> splits;
+	for(int i = 1; i < shards; i++)
+	{
+		splits.push_back(range / shards * i);
+	}
+	return splits;
+}
+
+TEST(ShardedTree, RandomOperationsMatchModel)
+{
+	std::mt19937 rng(500);
+	Sharded table(evenSplits(8, 100000));
+	std::map<int, int> model;
+	for(int i = 0; i < 60000; i++)
+	{
+		// most keys land in the first shard, so it keeps getting skewed
+		int key = rng() % 4 == 0 ? static_cast<int>(rng() % 100000) : static_cast<int>(rng() % 10000);
+		switch(rng() % 4)
+		{
+		case 0:
+			table.remove(key);
+			model.erase(key);
+			break;
+		case 1:
+		{
+			int value = -1;
+			ASSERT_EQ(model.count(key) != 0, table.lookup(key, value));
+			if(model.count(key) != 0)
+			{
+				ASSERT_EQ(model[key], value);
+			}
+			break;
+		}
+		default:
+			table.insert(std::make_pair(key, i));
+			model[key] = i;
+			break;
+		}
+	}
+	EXPECT_GT(table.rebalances(), 0u);
+	ASSERT_TRUE(checkShards(table));
+	ASSERT_TRUE(checkTableContents(table, model));
+
+	// ranges, across shard bounds and inside one shard
+	for(int i = 0; i < 200; i++)
+	{
+		int lo = static_cast<int>(rng() % 110000) - 5000;
+		int hi = lo + static_cast<int>(rng() % 30000);
+		std::vector<std::pair<int, int> > items;
+		Collect collect = { &items };
+		table.for_each(lo, hi, collect);
+		std::vector<std::pair<int, int> > expected(model.lower_bound(lo), model.lower_bound(hi));
+		ASSERT_TRUE(expected == items) << lo << ".." << hi;
+	}
+}
+
+TEST(ShardedTree, AppendsSpreadOverAllShards)
+{
+	Sharded table(evenSplits(16, 16000));
+	std::map<int, int> model;
+	// every key is past the last split point
+	for(int i = 0; i < 100000; i++)
+	{
+		table.insert(std::make_pair(20000 + i, i));
+		model[20000 + i] = i;
+	}
+	EXPECT_GT(table.rebalances(), 0u);
+	ASSERT_TRUE(checkShards(table));
+	ASSERT_TRUE(checkTableContents(table, model));
+	// no shard is left holding more than skew times the average
+	for(size_t i = 0; i < table.shards(); i++)
+	{
+		EXPECT_LE(table.shards_[i]->size, 2 * model.size() / table.shards() + SHARD_SKEW_CHECK) << i;
+	}
+}
+
+TEST(ShardedTree, MoreShardsThanItems)
+{
+	Sharded table(evenSplits(2048, 2048 * 8));
+	std::map<int, int> model;
+	// the last shard takes them all while the average is still zero
+	for(int i = 0; i < 1024; i++)
+	{
+		table.insert(std::make_pair(2048 * 8 + i, i));
+		model[2048 * 8 + i] = i;
+	}
+	ASSERT_TRUE(checkShards(table));
+	ASSERT_TRUE(checkTableContents(table, model));
+}
+
+TEST(ShardedTree, ConcurrentWritersMatchModel)
+{
+	const int threads = 8;
+	Sharded table(evenSplits(16, 1 << 20));
+	std::vector<std::map<int, int> > models(threads);
+	std::vector<std::thread> workers;
+	for(int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread([&table, &models, t]() {
+			std::mt19937 rng(510 + t);
+			std::map<int, int>& model = models[t];
+			for(int i = 0; i < 30000; i++)
+			{
+				// each thread owns the keys equal to t mod threads; half of
+				// them increase, which keeps the last shard skewed
+				int key = (i % 2 == 0 ? (1 << 20) + i : static_cast<int>(rng() % (1 << 20))) / threads * threads + t;
+				switch(rng() % 5)
+				{
+				case 0:
+					table.remove(key);
+					model.erase(key);
+					break;
+				case 1:
+				{
+					int value = -1;
+					bool found = table.lookup(key, value);
+					if(found != (model.count(key) != 0) || (found && value != model[key]))
+					{
+						ADD_FAILURE() << "lookup(" << key << ") disagrees with the model";
+						return;
+					}
+					break;
+				}
+				default:
+					table.insert(std::make_pair(key, i));
+					model[key] = i;
+					break;
+				}
+			}
+		}));
+	}
+	// a reader walking the table meanwhile always sees increasing keys. It
+	// pauses between walks: a walk holds off rebalancing, and rebalances
+	// that find it running are skipped
+	workers.push_back(std::thread([&table]() {
+		for(int round = 0; round < 10; round++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			std::vector<std::pair<int, int> > items;
+			Collect collect = { &items };
+			table.for_each(collect);
+			for(size_t i = 1; i < items.size(); i++)
+			{
+				if(!(items[i - 1].first < items[i].first))
+				{
+					ADD_FAILURE() << "for_each went from " << items[i - 1].first << " to " << items[i].first;
+					return;
+				}
+			}
+		}
+	}));
+	for(size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	std::map<int, int> model;
+	for(int t = 0; t < threads; t++)
+	{
+		model.insert(models[t].begin(), models[t].end());
+	}
+	EXPECT_GT(table.rebalances(), 0u);
+	ASSERT_TRUE(checkShards(table));
+	ASSERT_TRUE(checkTableContents(table, model));
+}
+
+TEST(ShardedTree, BadSplitPoints)
+{
+	std::vector<int> splits;
+	splits.push_back(5);
+	splits.push_back(5);
+	EXPECT_THROW(Sharded table(splits), std::invalid_argument);
+	EXPECT_THROW(Sharded table(evenSplits(4, 100), 1.0), std::invalid_argument);
+
+	// one shard never rebalances
+	Sharded single((std::vector<int>()));
+	for(int i = 0; i < 5000; i++)
+	{
+		single.insert(std::make_pair(i, i));
+	}
+	EXPECT_EQ(1u, single.shards());
+	EXPECT_EQ(0u, single.rebalances());
+	EXPECT_EQ(5000u, single.size());
+}
@@ -0,0 +1,285 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// pre-order keys and balances, to compare tree shapes
+template<typename Key, typename Value>
+void shapeOf(AVLNode<Key, Value>* node, std::vector<std::pair<Key, int> >& out)
+{
+	if(node == nullptr)
+	{
+		return;
+	}
+	out.push_back(std::make_pair(node->getKey(), int(node->getBalance())));
+	shapeOf(node->getLeft(), out);
+	shapeOf(node->getRight(), out);
+}
+
+template<typename Key, typename Value>
+std::vector<std::pair<Key, int> > shapeOf(AVLTree<Key, Value>& tree)
+{
+	std::vector<std::pair<Key, int> > out;
+	shapeOf(static_cast<AVLNode<Key, Value>*>(tree.root_), out);
+	return out;
+}
+
+static std::string stringKey(unsigned i)
+{
+	return "user/" + std::to_string(i % 97) + "/item-" + std::to_string(i);
+}
+
+TEST(Snapshot, EmptyRoundTrip)
+{
+	AVLTree<int, int> tree;
+	std::stringstream buf;
+	tree.save(buf);
+
+	AVLTree<int, int> loaded;
+	loaded.insert(std::make_pair(1, 1));
+	loaded.load(buf);
+	EXPECT_TRUE(loaded.empty());
+	EXPECT_TRUE(checkAVL(loaded));
+}
+
+TEST(Snapshot, IntRoundTripKeepsShape)
+{
+	std::mt19937 rng(26);
+	AVLTree<int, double> tree;
+	std::map<int, double> model;
+	for(int i = 0; i < 20000; i++)
+	{
+		int key = static_cast<int>(rng() % 50000);
+		if(rng() % 4 == 0)
+		{
+			tree.remove(key);
+			model.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, key * 0.5));
+			model[key] = key * 0.5;
+		}
+	}
+
+	std::stringstream buf;
+	tree.save(buf);
+	AVLTree<int, double> loaded;
+	loaded.load(buf);
+
+	EXPECT_TRUE(checkAVL(loaded));
+	EXPECT_TRUE(checkContents(loaded, model));
+	EXPECT_TRUE(shapeOf(tree) == shapeOf(loaded));
+
+	// the loaded tree keeps working like any other
+	for(int i = 0; i < 2000; i++)
+	{
+		int key = static_cast<int>(rng() % 50000);
+		loaded.insert(std::make_pair(key, 1.0));
+		model[key] = 1.0;
+		key = static_cast<int>(rng() % 50000);
+		loaded.remove(key);
+		model.erase(key);
+	}
+	EXPECT_TRUE(checkAVL(loaded));
+	EXPECT_TRUE(checkContents(loaded, model));
+}
+
+TEST(Snapshot, StringRoundTripThroughFile)
+{
+	TempDir dir;
+	std::string path = dir.path() + "/tree.snap";
+
+	AVLTree<std::string, std::string> tree;
+	std::map<std::string, std::string> model;
+	for(unsigned i = 0; i < 5000; i++)
+	{
+		std::string key = stringKey(i * 7919u);
+		tree.insert(std::make_pair(key, std::string(i % 40, 'v')));
+		model[key] = std::string(i % 40, 'v');
+	}
+	tree.save(path);
+
+	// the cache and filter must pick up the loaded keys, and lose the old one
+	AVLTree<std::string, std::string> loaded;
+	loaded.setLookupCacheSize(256);
+	loaded.enableBloomFilter(10000, 0.01);
+	loaded.insert(std::make_pair(std::string("stale"), std::string("x")));
+	loaded.find("stale");
+	loaded.load(path);
+
+	EXPECT_TRUE(checkAVL(loaded));
+	EXPECT_TRUE(checkContents(loaded, model));
+	EXPECT_TRUE(loaded.find("stale") == loaded.end());
+	EXPECT_TRUE(loaded.find("user/1/missing") == loaded.end());
+}
+
+TEST(Snapshot, StringKeysSearchableAfterLoad)
+{
+	// descents lean on the inline prefixes packed while loading
+	AVLTree<std::string, int> tree;
+	for(unsigned i = 0; i < 3000; i++)
+	{
+		tree.insert(std::make_pair(stringKey(i * 104729u), int(i)));
+	}
+	std::stringstream buf;
+	tree.save(buf);
+	AVLTree<std::string, int> loaded;
+	loaded.load(buf);
+
+	std::map<std::string, int> model;
+	for(AVLTree<std::string, int>::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		model[it->first] = it->second;
+	}
+	for(unsigned i = 0; i < 3000; i++)
+	{
+		EXPECT_TRUE(loaded.find(stringKey(i * 104729u + 1)) == loaded.end());
+	}
+	EXPECT_TRUE(checkContents(loaded, model));
+}
+
+TEST(Snapshot, BadHeaderLeavesTreeUnchanged)
+{
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 100; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	std::stringstream good;
+	tree.save(good);
+	std::string bytes = good.str();
+
+	AVLTree<int, int> target;
+	target.insert(std::make_pair(-1, -1));
+	std::map<int, int> model;
+	model[-1] = -1;
+
+	std::string badMagic = bytes;
+	badMagic[0] = 'X';
+	std::stringstream in1(badMagic);
+	EXPECT_THROW(target.load(in1), std::runtime_error);
+
+	// a tree with another value size
+	AVLTree<int, double> other;
+	other.insert(std::make_pair(1, 1.0));
+	std::stringstream in2;
+	other.save(in2);
+	EXPECT_THROW(target.load(in2), std::runtime_error);
+
+	EXPECT_TRUE(checkAVL(target));
+	EXPECT_TRUE(checkContents(target, model));
+}
+
+TEST(Snapshot, TruncatedSnapshotLeavesTreeAndFilterUnchanged)
+{
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 1000; i++)
+	{
+		tree.insert(std::make_pair(2 * i, i));
+	}
+	std::stringstream good;
+	tree.save(good);
+	std::string bytes = good.str();
+
+	AVLTree<int, int> target;
+	target.enableBloomFilter(4000, 0.01);
+	std::map<int, int> model;
+	for(int i = 0; i < 10; i++)
+	{
+		target.insert(std::make_pair(-1 - i, i));
+		model[-1 - i] = i;
+	}
+
+	for(size_t cut = 1; cut < bytes.size(); cut += bytes.size() / 17)
+	{
+		std::stringstream in(bytes.substr(0, cut));
+		EXPECT_THROW(target.load(in), std::runtime_error);
+	}
+	EXPECT_TRUE(checkAVL(target));
+	EXPECT_TRUE(checkContents(target, model));
+
+	// the keys of the failed loads never reached the live filter
+	int passed = 0;
+	for(int i = 0; i < 1000; i++)
+	{
+		passed += target.bloom_->mayContain(2 * i) ? 1 : 0;
+	}
+	EXPECT_LT(passed, 100);
+}
+
+TEST(Snapshot, CorruptStringLengthThrowsRuntimeError)
+{
+	AVLTree<std::string, int> tree;
+	tree.insert(std::make_pair(std::string("alpha"), 1));
+	tree.insert(std::make_pair(std::string("beta"), 2));
+	std::stringstream good;
+	tree.save(good);
+	std::string bytes = good.str();
+
+	// header: magic, three words, root flag; then the root's tag byte and
+	// its key length
+	size_t lengthAt = 8 + 3 * sizeof(uint32_t) + 1 + 1;
+	uint64_t huge = ~static_cast<uint64_t>(0) >> 2;
+	bytes.replace(lengthAt, sizeof(huge), reinterpret_cast<const char*>(&huge), sizeof(huge));
+
+	AVLTree<std::string, int> target;
+	target.insert(std::make_pair(std::string("kept"), 3));
+	std::stringstream in(bytes);
+	EXPECT_THROW(target.load(in), std::runtime_error);
+	EXPECT_EQ(3, target["kept"]);
+}
+
+// a snapshot of a left-leaning chain of n nodes, keys n-1 down to 0, with
+// every tag above the leaf claiming the given balance
+static std::string chainSnapshot(int n, int balance)
+{
+	std::string bytes("AVLSNAP", 8);
+	uint32_t header[3] = { 1, sizeof(int), sizeof(int) };
+	bytes.append(reinterpret_cast<const char*>(header), sizeof(header));
+	bytes.push_back(1);
+	for(int i = n - 1; i >= 0; i--)
+	{
+		int stored = (i > 0) ? balance : 0;
+		bytes.push_back(static_cast<char>(((stored + 1) << 2) | (i > 0 ? 1 : 0)));
+		bytes.append(reinterpret_cast<const char*>(&i), sizeof(i));
+		bytes.append(reinterpret_cast<const char*>(&i), sizeof(i));
+	}
+	return bytes;
+}
+
+TEST(Snapshot, ChainSnapshotsThrowRuntimeError)
+{
+	// a clean chain of two is a valid tree
+	AVLTree<int, int> small;
+	std::stringstream ok(chainSnapshot(2, -1));
+	small.load(ok);
+	EXPECT_TRUE(checkAVL(small));
+	EXPECT_EQ(0, small[0]);
+	EXPECT_EQ(1, small[1]);
+
+	AVLTree<int, int> target;
+	target.insert(std::make_pair(-1, -1));
+	std::map<int, int> model;
+	model[-1] = -1;
+
+	// far deeper than any real AVL tree: rejected before the stack runs out
+	std::stringstream deep(chainSnapshot(2000000, -1));
+	EXPECT_THROW(target.load(deep), std::runtime_error);
+
+	// shallow enough, but the stored balances do not match the heights
+	std::stringstream zeros(chainSnapshot(1000, 0));
+	EXPECT_THROW(target.load(zeros), std::runtime_error);
+	std::stringstream leaning(chainSnapshot(1000, -1));
+	EXPECT_THROW(target.load(leaning), std::runtime_error);
+	std::stringstream three(chainSnapshot(3, -1));
+	EXPECT_THROW(target.load(three), std::runtime_error);
+
+	EXPECT_TRUE(checkAVL(target));
+	EXPECT_TRUE(checkContents(target, model));
+}
@@ -0,0 +1,98 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+// random inserts, removes and lookups against a std::map
+static void runAgainstModel(SplayTree<int, int>& tree, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::map<int, int> model;
+	for(int round = 0; round < 10; round++)
+	{
+		for(int i = 0; i < 2000; i++)
+		{
+			int key = static_cast<int>(rng() % 3000);
+			switch(rng() % 4)
+			{
+			case 0:
+				tree.remove(key);
+				model.erase(key);
+				break;
+			case 1:
+			{
+				SplayTree<int, int>::iterator it = tree.find(key);
+				if(model.count(key) == 0)
+				{
+					ASSERT_TRUE(it == tree.end()) << key;
+				}
+				else
+				{
+					ASSERT_TRUE(it != tree.end()) << key;
+					ASSERT_EQ(model[key], it->second);
+				}
+				break;
+			}
+			default:
+				tree.insert(std::make_pair(key, i));
+				model[key] = i;
+				break;
+			}
+		}
+		ASSERT_TRUE(checkLinks(tree.root_));
+		ASSERT_TRUE(checkContents(tree, model));
+	}
+}
+
+TEST(Splay, RandomOperationsMatchModel)
+{
+	SplayTree<int, int> every;
+	runAgainstModel(every, 34);
+	SplayTree<int, int> periodic(7);
+	runAgainstModel(periodic, 340);
+}
+
+TEST(Splay, AccessesMoveKeysToTheRoot)
+{
+	SplayTree<int, int> tree;
+	for(int i = 0; i < 1000; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+		ASSERT_EQ(i, tree.root_->getKey());
+	}
+	ASSERT_TRUE(tree.find(17) != tree.end());
+	EXPECT_EQ(17, tree.root_->getKey());
+	EXPECT_EQ(500, tree[500]);
+	EXPECT_EQ(500, tree.root_->getKey());
+	EXPECT_THROW(tree[5000], std::out_of_range);
+	EXPECT_TRUE(checkLinks(tree.root_));
+
+	// the const overloads leave the shape alone
+	int root = tree.root_->getKey();
+	const SplayTree<int, int>& view = tree;
+	EXPECT_EQ(3, view[3]);
+	EXPECT_EQ(root, tree.root_->getKey());
+}
+
+TEST(Splay, PeriodicSplaying)
+{
+	typedef SplayTree<int, int> Splay;
+	EXPECT_THROW(Splay bad(0), std::invalid_argument);
+
+	Splay tree(3);
+	EXPECT_EQ(3u, tree.getSplayPeriod());
+	for(int i = 0; i < 100; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	// one access in three splays, so a key read three times gets to the top
+	for(int i = 0; i < 3; i++)
+	{
+		ASSERT_TRUE(tree.find(42) != tree.end());
+	}
+	EXPECT_EQ(42, tree.root_->getKey());
+	EXPECT_THROW(tree.setSplayPeriod(0), std::invalid_argument);
+	EXPECT_TRUE(checkLinks(tree.root_));
+}
@@ -0,0 +1,104 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// The counters only exist in the tree-tests-stats build (-DBST_STATS).
+#ifdef BST_STATS
+
+TEST(Stats, CountsAllocationsAndFrees)
+{
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 100; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	tree.insert(std::make_pair(5, 0));
+	EXPECT_EQ(100u, tree.stats().allocations);
+	EXPECT_EQ(0u, tree.stats().frees);
+
+	for(int i = 0; i < 10; i++)
+	{
+		tree.remove(i);
+	}
+	EXPECT_EQ(10u, tree.stats().frees);
+	tree.clear();
+	EXPECT_EQ(100u, tree.stats().frees);
+}
+
+TEST(Stats, CountsDescentVisits)
+{
+	// ascending keys make a BinarySearchTree a list down the right side
+	BinarySearchTree<int, int> list;
+	for(int i = 1; i <= 50; i++)
+	{
+		list.insert(std::make_pair(i, i));
+	}
+	list.resetStats();
+	EXPECT_EQ(0u, list.stats().nodeVisits);
+
+	ASSERT_TRUE(list.find(50) != list.end());
+	EXPECT_EQ(50u, list.stats().nodeVisits);
+	EXPECT_GE(list.stats().comparisons, 50u);
+	EXPECT_EQ(0u, list.stats().singleRotations + list.stats().doubleRotations);
+
+	// the same keys in an AVL tree take at most about log2(50) visits
+	AVLTree<int, int> avl;
+	for(int i = 1; i <= 50; i++)
+	{
+		avl.insert(std::make_pair(i, i));
+	}
+	avl.resetStats();
+	ASSERT_TRUE(avl.find(50) != avl.end());
+	EXPECT_LE(avl.stats().nodeVisits, 8u);
+}
+
+TEST(Stats, CountsRotations)
+{
+	std::vector<int> keys;
+	for(int i = 0; i < 2000; i++)
+	{
+		keys.push_back(i);
+	}
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(30));
+
+	AVLTree<int, int> avl;
+	RBTree<int, int> rb;
+	for(size_t i = 0; i < keys.size(); i++)
+	{
+		avl.insert(std::make_pair(keys[i], 0));
+		rb.insert(std::make_pair(keys[i], 0));
+	}
+	TreeStats stats = avl.stats();
+	EXPECT_GT(stats.singleRotations, 0u);
+	EXPECT_GT(stats.doubleRotations, 0u);
+	EXPECT_GT(stats.rebalanceSteps, 0u);
+	EXPECT_GT(rb.stats().singleRotations + rb.stats().doubleRotations, 0u);
+	EXPECT_TRUE(checkAVL(avl));
+	EXPECT_TRUE(rb.isValidRB());
+
+	avl.resetStats();
+	stats = avl.stats();
+	EXPECT_EQ(0u, stats.comparisons + stats.nodeVisits + stats.singleRotations +
+		stats.doubleRotations + stats.rebalanceSteps + stats.allocations + stats.frees);
+}
+
+#else
+
+TEST(Stats, ZeroWithoutBstStats)
+{
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 100; i++)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	tree.find(7);
+	TreeStats stats = tree.stats();
+	EXPECT_EQ(0u, stats.comparisons + stats.nodeVisits + stats.singleRotations +
+		stats.allocations + stats.frees);
+}
+
+#endif
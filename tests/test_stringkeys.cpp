@@ -0,0 +1,116 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+// keys that stress the prefix windows: shared prefixes of every length
+// (including past the 255 bytes an offset can record), embedded NULs,
+// and keys that are prefixes of one another
+static std::string trickyKey(std::mt19937& rng)
+{
+	static const std::string prefixes[] = {
+		"", "a", "user/", "user/0000000", std::string(300, 'p'), std::string("nul\0nul", 7)
+	};
+	std::string key = prefixes[rng() % 6];
+	int extra = static_cast<int>(rng() % 12);
+	for(int i = 0; i < extra; i++)
+	{
+		// a small alphabet with NUL and 0xFF makes ties and carries common
+		static const char alphabet[] = { '\0', 'a', 'b', '\xff' };
+		key += alphabet[rng() % 4];
+	}
+	return key;
+}
+
+template<typename Tree>
+void runStringModel(Tree& tree, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::map<std::string, int> model;
+	for(int i = 0; i < 20000; i++)
+	{
+		std::string key = trickyKey(rng);
+		if(rng() % 4 == 0)
+		{
+			tree.remove(key);
+			model.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, i));
+			model[key] = i;
+		}
+	}
+	ASSERT_TRUE(checkLinks(tree.root_));
+	ASSERT_TRUE(checkContents(tree, model));
+	for(int i = 0; i < 5000; i++)
+	{
+		std::string key = trickyKey(rng);
+		ASSERT_EQ(model.count(key) != 0, tree.find(key) != tree.end());
+
+		std::map<std::string, int>::iterator lb = model.lower_bound(key);
+		typename Tree::iterator tlb = tree.lower_bound(key);
+		ASSERT_EQ(lb == model.end(), tlb == tree.end());
+		if(lb != model.end())
+		{
+			ASSERT_EQ(lb->first, tlb->first);
+		}
+	}
+}
+
+TEST(StringKeys, PrefixComparisonMatchesStringCompare)
+{
+	std::mt19937 rng(40);
+	for(int i = 0; i < 100000; i++)
+	{
+		std::string a = trickyKey(rng);
+		std::string b = trickyKey(rng);
+		size_t lcp;
+		int order = KeyPrefixTraits<std::string>::compareFrom(a, b, 0, lcp);
+		int expected = a.compare(b);
+		ASSERT_EQ(expected < 0 ? -1 : (expected > 0 ? 1 : 0), order);
+		ASSERT_LE(lcp, std::min(a.size(), b.size()));
+		ASSERT_EQ(a.substr(0, lcp), b.substr(0, lcp));
+	}
+}
+
+TEST(StringKeys, AllTreesMatchModel)
+{
+	BinarySearchTree<std::string, int> bst;
+	runStringModel(bst, 400);
+	AVLTree<std::string, int> avl;
+	runStringModel(avl, 401);
+	EXPECT_TRUE(checkAVL(avl));
+	RBTree<std::string, int> rb;
+	runStringModel(rb, 402);
+	EXPECT_TRUE(rb.isValidRB());
+	Treap<std::string, int> treap;
+	runStringModel(treap, 403);
+	ScapegoatTree<std::string, int> scapegoat;
+	runStringModel(scapegoat, 404);
+}
+
+TEST(StringKeys, FindManyMatchesFind)
+{
+	std::mt19937 rng(405);
+	AVLTree<std::string, int> tree;
+	for(int i = 0; i < 5000; i++)
+	{
+		tree.insert(std::make_pair(trickyKey(rng), i));
+	}
+	std::vector<std::string> keys;
+	for(int i = 0; i < 3000; i++)
+	{
+		keys.push_back(trickyKey(rng));
+	}
+	std::vector<AVLTree<std::string, int>::iterator> out;
+	tree.find_many(keys, out);
+	ASSERT_EQ(keys.size(), out.size());
+	for(size_t i = 0; i < keys.size(); i++)
+	{
+		ASSERT_TRUE(out[i] == tree.find(keys[i])) << i;
+	}
+}
@@ -0,0 +1,196 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <vector>
+
+/* Verifies a treap: links and key order, and no node with a higher
+   priority than its parent.
+*/
+template<typename Key, typename Value>
+testing::AssertionResult checkTreap(Treap<Key, Value>& tree)
+{
+	testing::AssertionResult links = checkLinks(tree.root_);
+	if(!links)
+	{
+		return links;
+	}
+	std::vector<TreapNode<Key, Value>*> stack;
+	if(tree.root_ != nullptr)
+	{
+		stack.push_back(static_cast<TreapNode<Key, Value>*>(tree.root_));
+	}
+	while(!stack.empty())
+	{
+		TreapNode<Key, Value>* node = stack.back();
+		stack.pop_back();
+		TreapNode<Key, Value>* children[2] = { node->getLeft(), node->getRight() };
+		for(int i = 0; i < 2; i++)
+		{
+			if(children[i] == nullptr)
+			{
+				continue;
+			}
+			if(children[i]->getPriority() > node->getPriority())
+			{
+				return testing::AssertionFailure() << "Node " << children[i]->getKey() << " outranks its parent " << node->getKey();
+			}
+			stack.push_back(children[i]);
+		}
+	}
+	return testing::AssertionSuccess();
+}
+
+// pre-order keys, to compare shapes
+static void shapeOf(Node<int, int>* node, std::vector<int>& out)
+{
+	if(node != nullptr)
+	{
+		out.push_back(node->getKey());
+		shapeOf(node->getLeft(), out);
+		shapeOf(node->getRight(), out);
+	}
+}
+
+TEST(Treap, RandomOperationsKeepHeapOrder)
+{
+	std::mt19937 rng(37);
+	Treap<int, int> tree;
+	std::map<int, int> model;
+	for(int round = 0; round < 20; round++)
+	{
+		for(int i = 0; i < 1000; i++)
+		{
+			int key = static_cast<int>(rng() % 3000);
+			if(rng() % 3 == 0)
+			{
+				tree.remove(key);
+				model.erase(key);
+			}
+			else
+			{
+				tree.insert(std::make_pair(key, i));
+				model[key] = i;
+			}
+		}
+		ASSERT_TRUE(checkTreap(tree));
+		ASSERT_TRUE(checkContents(tree, model));
+	}
+}
+
+TEST(Treap, SameSeedSameShape)
+{
+	Treap<int, int> a(12345);
+	Treap<int, int> b(12345);
+	Treap<int, int> c(54321);
+	for(int i = 0; i < 500; i++)
+	{
+		a.insert(std::make_pair(i, i));
+		b.insert(std::make_pair(i, i));
+		c.insert(std::make_pair(i, i));
+	}
+	std::vector<int> shapeA, shapeB, shapeC;
+	shapeOf(a.root_, shapeA);
+	shapeOf(b.root_, shapeB);
+	shapeOf(c.root_, shapeC);
+	EXPECT_TRUE(shapeA == shapeB);
+	EXPECT_FALSE(shapeA == shapeC);
+	EXPECT_TRUE(checkTreap(c));
+}
+
+TEST(Treap, SplitAndMerge)
+{
+	std::mt19937 rng(370);
+	Treap<int, int> tree;
+	std::map<int, int> model;
+	for(int i = 0; i < 5000; i++)
+	{
+		int key = static_cast<int>(rng() % 20000);
+		tree.insert(std::make_pair(key, i));
+		model[key] = i;
+	}
+
+	for(int cut = -10; cut <= 20010; cut += 2503)
+	{
+		Treap<int, int> greater;
+		tree.split(cut, greater);
+		std::map<int, int> low(model.begin(), model.lower_bound(cut));
+		std::map<int, int> high(model.lower_bound(cut), model.end());
+		ASSERT_TRUE(checkTreap(tree));
+		ASSERT_TRUE(checkTreap(greater));
+		ASSERT_TRUE(checkContents(tree, low));
+		ASSERT_TRUE(checkContents(greater, high));
+
+		// keys out of order are refused and leave both treaps alone
+		if(!low.empty() && !high.empty())
+		{
+			EXPECT_THROW(greater.merge(tree), std::invalid_argument);
+			EXPECT_TRUE(checkContents(greater, high));
+		}
+		tree.merge(greater);
+		EXPECT_TRUE(greater.empty());
+		ASSERT_TRUE(checkTreap(tree));
+		ASSERT_TRUE(checkContents(tree, model));
+	}
+
+	Treap<int, int> full;
+	full.insert(std::make_pair(1, 1));
+	EXPECT_THROW(tree.split(5, full), std::invalid_argument);
+	EXPECT_THROW(tree.split(5, tree), std::invalid_argument);
+}
+
+TEST(Treap, EraseRange)
+{
+	std::mt19937 rng(371);
+	Treap<int, int> tree;
+	std::map<int, int> model;
+	for(int i = 0; i < 5000; i++)
+	{
+		int key = static_cast<int>(rng() % 20000);
+		tree.insert(std::make_pair(key, i));
+		model[key] = i;
+	}
+	// erased nodes must leave the cache and the filter too
+	tree.setLookupCacheSize(256);
+	tree.enableBloomFilter(5000, 0.01);
+	for(int i = 0; i < 50; i++)
+	{
+		int lo = static_cast<int>(rng() % 21000) - 500;
+		int hi = lo + static_cast<int>(rng() % 800) - 100;
+		for(int key = lo; key < hi; key += 7)
+		{
+			tree.find(key);
+		}
+		tree.erase(lo, hi);
+		if(lo < hi)
+		{
+			model.erase(model.lower_bound(lo), model.lower_bound(hi));
+		}
+		ASSERT_TRUE(checkTreap(tree));
+		ASSERT_TRUE(checkContents(tree, model));
+		for(int key = lo; key < hi; key++)
+		{
+			ASSERT_TRUE(tree.find(key) == tree.end()) << key;
+		}
+	}
+
+	// iterator ranges, including one running to end()
+	Treap<int, int>::iterator first = tree.begin();
+	++first;
+	Treap<int, int>::iterator last = tree.find(model.rbegin()->first);
+	std::map<int, int>::iterator mfirst = model.begin();
+	++mfirst;
+	tree.erase(first, last);
+	model.erase(mfirst, model.find(model.rbegin()->first));
+	ASSERT_TRUE(checkTreap(tree));
+	ASSERT_TRUE(checkContents(tree, model));
+	tree.erase(tree.begin(), tree.begin());
+	tree.erase(tree.find(model.rbegin()->first), tree.end());
+	model.erase(model.rbegin()->first);
+	ASSERT_TRUE(checkContents(tree, model));
+	tree.erase(tree.begin(), tree.end());
+	EXPECT_TRUE(tree.empty());
+	EXPECT_TRUE(checkTreap(tree));
+}
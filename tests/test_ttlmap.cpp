@@ -0,0 +1,183 @@
+#include "check_trees.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef TTLMap<int, std::string> Table;
+// key -> (value, expiry)
+typedef std::map<int, std::pair<std::string, uint64_t> > TableModel;
+
+/* Verifies both trees of a TTLMap, and that the expiration index holds
+   exactly one (expiry, key) entry per item with the item's expiry.
+*/
+static testing::AssertionResult checkTable(Table& table)
+{
+	testing::AssertionResult result = checkAVL(table.entries_);
+	if(!result)
+	{
+		return result;
+	}
+	result = checkAVL(table.index_);
+	if(!result)
+	{
+		return result;
+	}
+	size_t n = 0;
+	for(Table::iterator it = table.entries_.begin(); it != table.entries_.end(); ++it, n++)
+	{
+		if(table.index_.find(Table::IndexKey(it->second.expiry, it->first)) == table.index_.end())
+		{
+			return testing::AssertionFailure() << "Key " << it->first << " is missing from the index";
+		}
+	}
+	size_t indexed = 0;
+	for(AVLTree<Table::IndexKey, bool>::iterator it = table.index_.begin(); it != table.index_.end(); ++it)
+	{
+		indexed++;
+	}
+	if(n != table.size() || indexed != table.size())
+	{
+		return testing::AssertionFailure() << n << " entries and " << indexed << " index entries for size " << table.size();
+	}
+	return testing::AssertionSuccess();
+}
+
+// removes from the model what expire_until(now) should remove
+static size_t expireModel(TableModel& model, uint64_t now, std::vector<std::pair<int, std::string> >& expired)
+{
+	std::multimap<std::pair<uint64_t, int>, std::string> order;
+	for(TableModel::iterator it = model.begin(); it != model.end();)
+	{
+		if(it->second.second <= now)
+		{
+			order.insert(std::make_pair(std::make_pair(it->second.second, it->first), it->second.first));
+			model.erase(it++);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	for(std::multimap<std::pair<uint64_t, int>, std::string>::iterator it = order.begin(); it != order.end(); ++it)
+	{
+		expired.push_back(std::make_pair(it->first.second, it->second));
+	}
+	return order.size();
+}
+
+TEST(TTLMap, RandomOperationsMatchModel)
+{
+	std::mt19937 rng(490);
+	Table table;
+	TableModel model;
+	uint64_t now = 1000;
+	for(int round = 0; round < 50; round++)
+	{
+		for(int i = 0; i < 400; i++)
+		{
+			int key = static_cast<int>(rng() % 1000);
+			switch(rng() % 6)
+			{
+			case 0:
+				table.remove(key);
+				model.erase(key);
+				break;
+			case 1:
+			case 2:
+			{
+				std::string* value = table.find(key, now);
+				TableModel::iterator it = model.find(key);
+				if(it != model.end() && it->second.second <= now)
+				{
+					// expired but not swept: find drops it
+					model.erase(it);
+					it = model.end();
+				}
+				ASSERT_EQ(it != model.end(), value != NULL) << key;
+				if(value != NULL)
+				{
+					ASSERT_EQ(it->second.first, *value);
+				}
+				break;
+			}
+			default:
+			{
+				uint64_t expiry = now + rng() % 500;
+				std::string value = std::to_string(round * 1000 + i);
+				table.insert(std::make_pair(key, value), expiry);
+				model[key] = std::make_pair(value, expiry);
+				break;
+			}
+			}
+			now += rng() % 3;
+		}
+		ASSERT_TRUE(checkTable(table));
+		ASSERT_EQ(model.size(), table.size());
+
+		uint64_t next;
+		ASSERT_EQ(!model.empty(), table.next_expiry(next));
+		if(!model.empty())
+		{
+			uint64_t earliest = model.begin()->second.second;
+			for(TableModel::iterator it = model.begin(); it != model.end(); ++it)
+			{
+				earliest = std::min(earliest, it->second.second);
+			}
+			ASSERT_EQ(earliest, next);
+		}
+
+		std::vector<std::pair<int, std::string> > expired;
+		std::vector<std::pair<int, std::string> > expected;
+		if(round % 2 == 0)
+		{
+			ASSERT_EQ(expireModel(model, now, expected), table.expire_until(now, expired));
+			ASSERT_TRUE(expected == expired);
+		}
+		else
+		{
+			ASSERT_EQ(expireModel(model, now, expected), table.expire_until(now));
+		}
+		ASSERT_TRUE(checkTable(table));
+		ASSERT_EQ(model.size(), table.size());
+		for(TableModel::iterator it = model.begin(); it != model.end(); ++it)
+		{
+			ASSERT_TRUE(table.find(it->first, now) != NULL);
+		}
+	}
+}
+
+TEST(TTLMap, OverwriteMovesTheExpiry)
+{
+	Table table;
+	uint64_t next;
+	EXPECT_TRUE(table.empty());
+	EXPECT_FALSE(table.next_expiry(next));
+	EXPECT_EQ(0u, table.expire_until(100));
+
+	table.insert(std::make_pair(1, std::string("a")), 10);
+	table.insert(std::make_pair(2, std::string("b")), 20);
+	table.insert(std::make_pair(1, std::string("c")), 30);
+	EXPECT_TRUE(checkTable(table));
+	EXPECT_EQ(2u, table.size());
+	ASSERT_TRUE(table.next_expiry(next));
+	EXPECT_EQ(20u, next);
+
+	// expiry is exclusive: the entry is gone at its expiry time
+	ASSERT_TRUE(table.find(2, 19) != NULL);
+	EXPECT_TRUE(table.find(2, 20) == NULL);
+	EXPECT_EQ(1u, table.size());
+	EXPECT_TRUE(checkTable(table));
+
+	std::vector<std::pair<int, std::string> > expired;
+	EXPECT_EQ(0u, table.expire_until(29, expired));
+	EXPECT_EQ(1u, table.expire_until(30, expired));
+	ASSERT_EQ(1u, expired.size());
+	EXPECT_EQ(1, expired[0].first);
+	EXPECT_EQ("c", expired[0].second);
+	EXPECT_TRUE(table.empty());
+	EXPECT_TRUE(checkTable(table));
+}
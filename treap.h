@@ -0,0 +1,482 @@
+#ifndef TREAP_H
+#define TREAP_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include "bst.h"
+
+// Seed used by Treaps that are not given one.
+#define TREAP_DEFAULT_SEED 0x9E3779B97F4A7C15ULL
+
+/**
+* A node for a treap: a plain Node plus a random heap priority.
+*/
+template <typename Key, typename Value>
+class TreapNode : public Node<Key, Value>
+{
+public:
+    TreapNode(const Key& key, const Value& value, TreapNode<Key, Value>* parent, uint32_t priority);
+    virtual ~TreapNode();
+
+    uint32_t getPriority() const;
+
+    // Getters for parent, left, and right, returning TreapNodes (see AVLNode).
+    virtual TreapNode<Key, Value>* getParent() const override;
+    virtual TreapNode<Key, Value>* getLeft() const override;
+    virtual TreapNode<Key, Value>* getRight() const override;
+
+protected:
+    uint32_t priority_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TreapNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+TreapNode<Key, Value>::TreapNode(const Key& key, const Value& value, TreapNode<Key, Value>* parent, uint32_t priority) :
+    Node<Key, Value>(key, value, parent), priority_(priority)
+{
+
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value>::~TreapNode()
+{
+
+}
+
+/**
+* A getter for the heap priority of a TreapNode.
+*/
+template<class Key, class Value>
+uint32_t TreapNode<Key, Value>::getPriority() const
+{
+    return priority_;
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value> *TreapNode<Key, Value>::getParent() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value> *TreapNode<Key, Value>::getLeft() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value> *TreapNode<Key, Value>::getRight() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TreapNode class.
+  -----------------------------------------------
+*/
+
+/**
+* A randomized search tree: ordered by key like a BST and by priority like
+* a max-heap, with priorities drawn at random, so the expected depth is
+* O(log n) whatever the insertion order.
+*
+* Besides insert/remove, a treap splits and merges in O(log n) expected
+* time, which gives cheap range deletes and cheap ways to hand a key range
+* to another tree. Priorities come from a xorshift generator seeded per
+* tree, so a given seed and operation sequence always builds the same
+* shape.
+*/
+template <class Key, class Value>
+class Treap : public BinarySearchTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    explicit Treap(uint64_t seed = TREAP_DEFAULT_SEED);
+
+    virtual void insert (const std::pair<const Key, Value> &new_item) override;
+    virtual void remove(const Key& key) override;
+    using BinarySearchTree<Key, Value>::erase;
+    virtual void erase(iterator first, iterator last) override;
+
+    void seed(uint64_t seed);
+    void split(const Key& key, Treap<Key, Value>& greater);
+    void merge(Treap<Key, Value>& greater);
+
+protected:
+    uint32_t nextPriority();
+    void rotateUp(TreapNode<Key, Value>* node);
+    static void splitNode(TreapNode<Key, Value>* node, const Key& key,
+                          TreapNode<Key, Value>*& less, TreapNode<Key, Value>*& greater);
+    static TreapNode<Key, Value>* mergeNodes(TreapNode<Key, Value>* less, TreapNode<Key, Value>* greater);
+    TreapNode<Key, Value>* maxNode() const;
+
+    uint64_t rngState_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the Treap class.
+  -----------------------------------------------
+*/
+
+/**
+* Constructs an empty treap whose priorities are drawn from the given seed.
+*/
+template<class Key, class Value>
+Treap<Key, Value>::Treap(uint64_t seed) :
+    rngState_(0)
+{
+    this->seed(seed);
+}
+
+/**
+* Restarts the priority generator; nodes inserted afterwards get the same
+* priorities as in a fresh treap with this seed.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::seed(uint64_t seed)
+{
+    //xorshift must not start from zero
+    rngState_ = (seed != 0) ? seed : TREAP_DEFAULT_SEED;
+}
+
+/**
+* Inserts the item (overwriting the value of an existing key): the new
+* node is linked as a leaf, then rotated up until its parent has a higher
+* priority.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
+{
+    BST_LATENCY_SCOPE(LAT_INSERT);
+    TreapNode<Key, Value>* parent = NULL;
+    TreapNode<Key, Value>* temp = static_cast<TreapNode<Key, Value>*>(this->root_);
+    bool left = false;
+
+    KeyPrefixCursor<Key> cursor(new_item.first);
+
+    //find the key or the leaf position for it
+    while(temp != NULL) {
+        BST_STAT(nodeVisits, 1);
+        BST_STAT(comparisons, 1);
+        int order = cursor.order(temp);
+        if(order == 0 && new_item.first == temp->getKey()) {
+            temp->setValue(new_item.second);
+            return;
+        }
+        parent = temp;
+        if(order < 0 || (order == 0 && (BST_STAT(comparisons, 1), new_item.first < temp->getKey()))) {
+            left = true;
+            temp = temp->getLeft();
+        }
+        else {
+            left = false;
+            temp = temp->getRight();
+        }
+    }
+
+    TreapNode<Key, Value>* node = new TreapNode<Key, Value>(new_item.first, new_item.second, parent, nextPriority());
+    if(parent == NULL) {
+        this->root_ = node;
+    }
+    else if(left) {
+        parent->setLeft(node);
+    }
+    else {
+        parent->setRight(node);
+    }
+    this->nodeAdded(node, cursor.pack());
+
+    while(node->getParent() != NULL && node->getPriority() > node->getParent()->getPriority()) {
+        BST_STAT(rebalanceSteps, 1);
+        rotateUp(node);
+    }
+}
+
+/**
+* Removes the key if present: its node is rotated down below its
+* higher-priority child until it is a leaf, then unlinked.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::remove(const Key& key)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    TreapNode<Key, Value>* node = static_cast<TreapNode<Key, Value>*>(this->internalFind(key));
+    if(node == NULL) {
+        return;
+    }
+
+    while(node->getLeft() != NULL || node->getRight() != NULL) {
+        BST_STAT(rebalanceSteps, 1);
+        TreapNode<Key, Value>* left = node->getLeft();
+        TreapNode<Key, Value>* right = node->getRight();
+        if(right == NULL || (left != NULL && left->getPriority() > right->getPriority())) {
+            rotateUp(left);
+        }
+        else {
+            rotateUp(right);
+        }
+    }
+
+    TreapNode<Key, Value>* parent = node->getParent();
+    if(parent == NULL) {
+        this->root_ = NULL;
+    }
+    else if(parent->getLeft() == node) {
+        parent->setLeft(NULL);
+    }
+    else {
+        parent->setRight(NULL);
+    }
+    this->freeNode(node);
+}
+
+/**
+* Moves every item with a key >= key into greater, which must be empty.
+* Runs in O(log n) expected time, plus O(n) when either treap has a
+* Bloom filter to refill.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::split(const Key& key, Treap<Key, Value>& greater)
+{
+    if(&greater == this || greater.root_ != NULL) {
+        throw std::invalid_argument("Treap::split needs an empty destination treap");
+    }
+    TreapNode<Key, Value>* less = NULL;
+    TreapNode<Key, Value>* more = NULL;
+    splitNode(static_cast<TreapNode<Key, Value>*>(this->root_), key, less, more);
+    if(less != NULL) {
+        less->setParent(NULL);
+    }
+    if(more != NULL) {
+        more->setParent(NULL);
+    }
+    this->root_ = less;
+    greater.root_ = more;
+    //nodes now owned by greater must not be served from this cache, and
+    //both filters have to be refilled (O(n))
+    this->clearLookupCache();
+    this->rebuildBloomFilter();
+    greater.rebuildBloomFilter();
+}
+
+/**
+* Moves every item of greater into this treap, leaving greater empty. All
+* keys in greater must be larger than every key in this treap; otherwise
+* std::invalid_argument is thrown and neither treap changes. Runs in
+* O(log n) expected time, plus O(n) when either treap has a Bloom filter
+* to refill.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::merge(Treap<Key, Value>& greater)
+{
+    if(&greater == this || greater.root_ == NULL) {
+        return;
+    }
+    TreapNode<Key, Value>* max = maxNode();
+    if(max != NULL && !(max->getKey() < greater.getSmallestNode()->getKey())) {
+        throw std::invalid_argument("Treap::merge needs all keys of the merged treap to be larger");
+    }
+    TreapNode<Key, Value>* root = mergeNodes(static_cast<TreapNode<Key, Value>*>(this->root_),
+                                             static_cast<TreapNode<Key, Value>*>(greater.root_));
+    root->setParent(NULL);
+    this->root_ = root;
+    greater.root_ = NULL;
+    greater.clearLookupCache();
+    this->rebuildBloomFilter();
+    greater.rebuildBloomFilter();
+}
+
+/**
+* Removes the items from first up to, but not including, last (first must
+* not come after last) in O(log n + k) expected time for k removed items:
+* the range is split out, freed in one pass, and the outer pieces merged.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::erase(iterator first, iterator last)
+{
+    BST_LATENCY_SCOPE(LAT_REMOVE);
+    Node<Key, Value>* lo = this->iteratorNode(first);
+    Node<Key, Value>* hi = this->iteratorNode(last);
+    if(lo == NULL || lo == hi) {
+        return;
+    }
+    //cut the tree into [.., lo), [lo, hi) and [hi, ..); lo and hi stay
+    //linked until the end, so their keys can serve as the split points
+    TreapNode<Key, Value>* less = NULL;
+    TreapNode<Key, Value>* rest = NULL;
+    TreapNode<Key, Value>* middle = NULL;
+    TreapNode<Key, Value>* more = NULL;
+    splitNode(static_cast<TreapNode<Key, Value>*>(this->root_), lo->getKey(), less, rest);
+    if(hi != NULL) {
+        splitNode(rest, hi->getKey(), middle, more);
+    }
+    else {
+        middle = rest;
+    }
+
+    if(middle != NULL) {
+        middle->setParent(NULL);
+        this->trickleDownDelete(middle);
+    }
+    TreapNode<Key, Value>* root = mergeNodes(less, more);
+    if(root != NULL) {
+        root->setParent(NULL);
+    }
+    this->root_ = root;
+}
+
+//HELPER: nextPriority
+/*
+    xorshift64* step; the high half of the product is the priority
+*/
+template<class Key, class Value>
+uint32_t Treap<Key, Value>::nextPriority()
+{
+    rngState_ ^= rngState_ >> 12;
+    rngState_ ^= rngState_ << 25;
+    rngState_ ^= rngState_ >> 27;
+    return static_cast<uint32_t>((rngState_ * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+//HELPER: rotateUp
+/*
+    rotates node above its parent, fixing the grandparent's (or root's)
+    link
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::rotateUp(TreapNode<Key, Value>* node)
+{
+    BST_STAT(singleRotations, 1);
+    TreapNode<Key, Value>* parent = node->getParent();
+    TreapNode<Key, Value>* grand = parent->getParent();
+
+    if(node == parent->getLeft()) {
+        TreapNode<Key, Value>* inner = node->getRight();
+        parent->setLeft(inner);
+        if(inner != NULL) {
+            inner->setParent(parent);
+        }
+        node->setRight(parent);
+    }
+    else {
+        TreapNode<Key, Value>* inner = node->getLeft();
+        parent->setRight(inner);
+        if(inner != NULL) {
+            inner->setParent(parent);
+        }
+        node->setLeft(parent);
+    }
+    parent->setParent(node);
+    node->setParent(grand);
+
+    if(grand == NULL) {
+        this->root_ = node;
+    }
+    else if(grand->getLeft() == parent) {
+        grand->setLeft(node);
+    }
+    else {
+        grand->setRight(node);
+    }
+}
+
+//HELPER: splitNode
+/*
+    splits the subtree at node into keys < key (less) and keys >= key
+    (greater); the parent links of the two returned roots are left for
+    the caller to set
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::splitNode(TreapNode<Key, Value>* node, const Key& key,
+                                  TreapNode<Key, Value>*& less, TreapNode<Key, Value>*& greater)
+{
+    if(node == NULL) {
+        less = NULL;
+        greater = NULL;
+        return;
+    }
+    if(node->getKey() < key) {
+        //node and its left subtree are less; split the right subtree
+        TreapNode<Key, Value>* inner = NULL;
+        splitNode(node->getRight(), key, inner, greater);
+        node->setRight(inner);
+        if(inner != NULL) {
+            inner->setParent(node);
+        }
+        less = node;
+    }
+    else {
+        TreapNode<Key, Value>* inner = NULL;
+        splitNode(node->getLeft(), key, less, inner);
+        node->setLeft(inner);
+        if(inner != NULL) {
+            inner->setParent(node);
+        }
+        greater = node;
+    }
+}
+
+//HELPER: mergeNodes
+/*
+    joins two subtrees whose keys are all ordered less < greater, keeping
+    the higher priority on top; the returned root's parent link is left
+    for the caller to set
+*/
+template<class Key, class Value>
+TreapNode<Key, Value>* Treap<Key, Value>::mergeNodes(TreapNode<Key, Value>* less, TreapNode<Key, Value>* greater)
+{
+    if(less == NULL) {
+        return greater;
+    }
+    if(greater == NULL) {
+        return less;
+    }
+    if(less->getPriority() > greater->getPriority()) {
+        TreapNode<Key, Value>* right = mergeNodes(less->getRight(), greater);
+        less->setRight(right);
+        right->setParent(less);
+        return less;
+    }
+    else {
+        TreapNode<Key, Value>* left = mergeNodes(less, greater->getLeft());
+        greater->setLeft(left);
+        left->setParent(greater);
+        return greater;
+    }
+}
+
+//HELPER: maxNode
+/*
+    node with the largest key, or NULL for an empty treap
+*/
+template<class Key, class Value>
+TreapNode<Key, Value>* Treap<Key, Value>::maxNode() const
+{
+    TreapNode<Key, Value>* temp = static_cast<TreapNode<Key, Value>*>(this->root_);
+    if(temp == NULL) {
+        return NULL;
+    }
+    while(temp->getRight() != NULL) {
+        temp = temp->getRight();
+    }
+    return temp;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the Treap class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef TTLMAP_H
+#define TTLMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* Key of TTLMap's expiration index: entries ordered by expiry time, then
+* by key.
+*/
+template <typename Time, typename Key>
+struct ExpiryKey
+{
+    ExpiryKey() : expiry(), id() {}
+    ExpiryKey(const Time& e, const Key& k) : expiry(e), id(k) {}
+
+    Time expiry;
+    Key id;
+};
+
+template <typename Time, typename Key>
+bool operator<(const ExpiryKey<Time, Key>& a, const ExpiryKey<Time, Key>& b)
+{
+    return a.expiry < b.expiry || (!(b.expiry < a.expiry) && a.id < b.id);
+}
+
+template <typename Time, typename Key>
+bool operator==(const ExpiryKey<Time, Key>& a, const ExpiryKey<Time, Key>& b)
+{
+    return a.expiry == b.expiry && a.id == b.id;
+}
+
+template <typename Time, typename Key>
+std::ostream& operator<<(std::ostream& out, const ExpiryKey<Time, Key>& key)
+{
+    return out << key.expiry << ':' << key.id;
+}
+
+/**
+* Value of TTLMap's primary tree: the caller's value and when it expires.
+*/
+template <typename Value, typename Time>
+struct TTLEntry
+{
+    TTLEntry() : value(), expiry() {}
+    TTLEntry(const Value& v, const Time& e) : value(v), expiry(e) {}
+
+    Value value;
+    Time expiry;
+};
+
+template <typename Value, typename Time>
+std::ostream& operator<<(std::ostream& out, const TTLEntry<Value, Time>& entry)
+{
+    return out << entry.value << '@' << entry.expiry;
+}
+
+/**
+* A key/value table whose entries expire. Each entry is given an absolute
+* expiry time when inserted and counts as expired once now >= expiry; the
+* caller supplies the clock (any Time ordered by <, e.g. milliseconds).
+*
+* Entries live in a primary AVLTree keyed by Key, and an expiration index
+* (a second AVLTree keyed by (expiry, key)) keeps them in the order they
+* expire. expire_until(now) pops expired entries off the front of the
+* index, so it touches only those: O(k log n) for k expired entries,
+* instead of a scan of the whole table. find() also checks the entry it
+* returns and drops it if it has expired but not been swept yet, so
+* expired entries are never seen however seldom expire_until() runs.
+* next_expiry() says when the next sweep is due.
+*
+* Not thread safe.
+*/
+template <typename Key, typename Value, typename Time = uint64_t>
+class TTLMap
+{
+public:
+    TTLMap();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair, const Time& expiry);
+    void remove(const Key& key);
+    Value* find(const Key& key, const Time& now);
+
+    size_t expire_until(const Time& now);
+    size_t expire_until(const Time& now, std::vector<std::pair<Key, Value> >& expired);
+    bool next_expiry(Time& expiry) const;
+
+    size_t size() const;
+    bool empty() const;
+
+private:
+    TTLMap(const TTLMap&);
+    TTLMap& operator=(const TTLMap&);
+
+    typedef ExpiryKey<Time, Key> IndexKey;
+    typedef typename AVLTree<Key, TTLEntry<Value, Time> >::iterator iterator;
+
+    size_t expireUntil(const Time& now, std::vector<std::pair<Key, Value> >* expired);
+
+    AVLTree<Key, TTLEntry<Value, Time> > entries_;
+    AVLTree<IndexKey, bool> index_;
+    size_t size_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the TTLMap class.
+  -----------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Time>
+TTLMap<Key, Value, Time>::TTLMap() :
+    size_(0)
+{
+
+}
+
+/**
+* Inserts the item to expire at expiry, or overwrites the value and expiry
+* of an existing key. One descent finds the key or, through a hinted
+* insert, its slot.
+*/
+template<typename Key, typename Value, typename Time>
+void TTLMap<Key, Value, Time>::insert(const std::pair<const Key, Value>& keyValuePair, const Time& expiry)
+{
+    const Key& key = keyValuePair.first;
+    iterator it = entries_.lower_bound(key);
+    if(it != entries_.end() && !(key < it->first)) {
+        if(!(it->second.expiry == expiry)) {
+            index_.remove(IndexKey(it->second.expiry, key));
+            index_.insert(std::make_pair(IndexKey(expiry, key), true));
+        }
+        it->second = TTLEntry<Value, Time>(keyValuePair.second, expiry);
+        return;
+    }
+    entries_.insert(it, std::make_pair(key, TTLEntry<Value, Time>(keyValuePair.second, expiry)));
+    index_.insert(std::make_pair(IndexKey(expiry, key), true));
+    size_++;
+}
+
+/**
+* Removes the key if present.
+*/
+template<typename Key, typename Value, typename Time>
+void TTLMap<Key, Value, Time>::remove(const Key& key)
+{
+    iterator it = entries_.find(key);
+    if(it == entries_.end()) {
+        return;
+    }
+    index_.remove(IndexKey(it->second.expiry, key));
+    entries_.erase(it);
+    size_--;
+}
+
+/**
+* Returns a pointer to the key's value, or NULL if the key is missing or
+* has expired by now (an expired entry is removed on the spot). The
+* pointer stays valid until the entry is removed or expires.
+*/
+template<typename Key, typename Value, typename Time>
+Value* TTLMap<Key, Value, Time>::find(const Key& key, const Time& now)
+{
+    iterator it = entries_.find(key);
+    if(it == entries_.end()) {
+        return NULL;
+    }
+    if(!(now < it->second.expiry)) {
+        index_.remove(IndexKey(it->second.expiry, key));
+        entries_.erase(it);
+        size_--;
+        return NULL;
+    }
+    return &it->second.value;
+}
+
+/**
+* Removes every entry that has expired by now and returns how many there
+* were.
+*/
+template<typename Key, typename Value, typename Time>
+size_t TTLMap<Key, Value, Time>::expire_until(const Time& now)
+{
+    return expireUntil(now, NULL);
+}
+
+/**
+* As above, also appending the removed items to expired, in expiry order.
+*/
+template<typename Key, typename Value, typename Time>
+size_t TTLMap<Key, Value, Time>::expire_until(const Time& now, std::vector<std::pair<Key, Value> >& expired)
+{
+    return expireUntil(now, &expired);
+}
+
+/**
+* Sets expiry to the earliest expiry time in the table and returns true,
+* or returns false if the table is empty.
+*/
+template<typename Key, typename Value, typename Time>
+bool TTLMap<Key, Value, Time>::next_expiry(Time& expiry) const
+{
+    if(index_.empty()) {
+        return false;
+    }
+    expiry = index_.begin()->first.expiry;
+    return true;
+}
+
+/**
+* Returns the number of entries, counting expired ones not yet removed.
+*/
+template<typename Key, typename Value, typename Time>
+size_t TTLMap<Key, Value, Time>::size() const
+{
+    return size_;
+}
+
+template<typename Key, typename Value, typename Time>
+bool TTLMap<Key, Value, Time>::empty() const
+{
+    return size_ == 0;
+}
+
+//HELPER: expireUntil
+/*
+    pops index entries while the earliest one has expired, extracting each
+    from the primary tree so its value can be moved out without another
+    search
+*/
+template<typename Key, typename Value, typename Time>
+size_t TTLMap<Key, Value, Time>::expireUntil(const Time& now, std::vector<std::pair<Key, Value> >* expired)
+{
+    size_t n = 0;
+    while(!index_.empty() && !(now < index_.begin()->first.expiry)) {
+        IndexKey next = index_.pop_min().first;
+        typename AVLTree<Key, TTLEntry<Value, Time> >::node_type entry = entries_.extract(next.id);
+        if(expired != NULL) {
+            expired->push_back(std::make_pair(next.id, std::move(entry.mapped().value)));
+        }
+        n++;
+    }
+    size_ -= n;
+    return n;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TTLMap class.
+  -----------------------------------------------
+*/
+
+#endif